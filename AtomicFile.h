@@ -0,0 +1,51 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+namespace Thunder {
+namespace Graphics {
+    // Writes the file aside and moves it in place, so a reader never sees a
+    // partial file. Creates the directory if needed, false if not stored.
+    inline bool WriteAtomic(const string& fileName, const uint8_t data[], const uint32_t size)
+    {
+        const string directory(fileName.substr(0, fileName.rfind('/') + 1));
+
+        Core::File file(fileName + ".tmp");
+
+        bool result(((directory.empty() == true) || (Core::Directory(directory.c_str()).CreatePath() == true)) && (file.Create() == true));
+
+        if (result == true) {
+            result = (file.Write(data, size) == size);
+
+            file.Close();
+
+            if ((result == false) || (file.Move(fileName) == false)) {
+                file.Destroy();
+                result = false;
+            }
+        }
+
+        return (result);
+    }
+
+} // namespace Graphics
+} // namespace Thunder
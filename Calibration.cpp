@@ -0,0 +1,336 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Calibration.h"
+
+#include "AtomicFile.h"
+#include "ProgramCache.h"
+#include "ShaderPreprocessor.h"
+#include "Tracing.h"
+
+#ifndef GL_ES_VERSION_2_0
+#include <GLES2/gl2.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+
+namespace Thunder {
+namespace Graphics {
+    namespace {
+        // Tried in this order, a lower quality is preferred over a lower resolution.
+        constexpr float Scales[] = { 1.0f, 0.75f, 0.5f };
+
+        uint64_t Monotonic() // in us
+        {
+            return (std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+    }
+
+    Calibration::Calibration()
+        : _adminLock()
+        , _fileName()
+        , _results()
+        , _changed(false)
+    {
+    }
+
+    void Calibration::Open(const string& fileName, const string& renderer, const string& version)
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_adminLock);
+
+        _fileName = fileName;
+        _changed = false;
+        _results.Clear();
+
+        Core::File file(_fileName);
+
+        if ((file.Exists() == true) && ((file.Open(true) == false) || (_results.FromFile(file) == false))) {
+            TRACE(Trace::Error, ("Could not read calibration %s", _fileName.c_str()));
+            _results.Models.Clear();
+        }
+
+        if ((_results.Renderer.Value() != renderer) || (_results.Version.Value() != version)) {
+            if (_results.Models.Length() > 0) {
+                TRACE(Trace::Information, ("Calibration of %s %s dropped, now %s %s", _results.Renderer.Value().c_str(), _results.Version.Value().c_str(), renderer.c_str(), version.c_str()));
+            }
+
+            _results.Models.Clear();
+            _results.Renderer = renderer;
+            _results.Version = version;
+        }
+    }
+
+    /* static */ string Calibration::Key(const ModelConfig& config)
+    {
+        string result(config.FragmentShader.Value());
+
+        if (result.empty() == true) {
+            if (config.FragmentShaderFile.Value().empty() == false) {
+                result = config.FragmentShaderFile.Value();
+            } else {
+                char hash[24];
+
+                snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(ProgramCache::Hash(config.FragmentShaderSource.Value())));
+                result = hash;
+            }
+        }
+
+        Core::JSON::ArrayType<Core::JSON::String>::ConstIterator index(config.Defines.Elements());
+
+        while (index.Next() == true) {
+            result += ' ';
+            result += index.Current().Value();
+        }
+
+        return (result);
+    }
+
+    const Calibration::Entry* Calibration::Find(const string& key, const ModelConfig& config, const uint32_t budget) const
+    {
+        const Entry* result(nullptr);
+
+        Core::JSON::ArrayType<Entry>::ConstIterator index(_results.Models.Elements());
+
+        while ((result == nullptr) && (index.Next() == true)) {
+            const Entry& entry(index.Current());
+
+            if ((entry.Model.Value() == key) && (entry.Width.Value() == config.Width.Value()) && (entry.Height.Value() == config.Height.Value()) && (entry.Budget.Value() == budget)) {
+                result = &entry;
+            }
+        }
+
+        return (result);
+    }
+
+    bool Calibration::Apply(ModelConfig& config, const uint32_t budget) const
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_adminLock);
+
+        const string key(Key(config));
+        const Entry* entry(Find(key, config, budget));
+
+        if (entry != nullptr) {
+            if (config.Quality.IsSet() == false) {
+                config.Quality = entry->Quality.Value();
+            }
+
+            if (config.RenderScale.IsSet() == false) {
+                config.RenderScale = entry->RenderScale.Value();
+            }
+
+            TRACE(Trace::Information, ("Calibrated %s: quality %d scale %.2f, %dus of %dus", key.c_str(), config.Quality.Value(), config.RenderScale.Value(), entry->FrameTime.Value(), budget));
+        }
+
+        return (entry != nullptr);
+    }
+
+    bool Calibration::Measure(ModelConfig& config, const uint32_t budget)
+    {
+        bool result(false);
+
+        const string key(Key(config));
+        const uint16_t width(config.Width.Value());
+        const uint16_t height(config.Height.Value());
+
+        std::vector<uint8_t> qualities;
+        std::vector<float> scales;
+
+        if (config.Quality.IsSet() == true) {
+            qualities.push_back(config.Quality.Value());
+        } else {
+            for (int8_t quality = ShaderPreprocessor::MaxQuality; quality >= 0; --quality) {
+                qualities.push_back(static_cast<uint8_t>(quality));
+            }
+        }
+
+        if (config.RenderScale.IsSet() == true) {
+            scales.push_back(config.RenderScale.Value());
+        } else {
+            scales.assign(std::begin(Scales), std::end(Scales));
+        }
+
+        if (((qualities.size() > 1) || (scales.size() > 1)) && (width > 0) && (height > 0)) {
+            const uint64_t start(Monotonic());
+
+            // The models draw into their own target, nothing reaches the surface.
+            GLuint texture(0);
+            GLuint framebuffer(0);
+
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            glGenFramebuffers(1, &framebuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+            const GLenum status(glCheckFramebufferStatus(GL_FRAMEBUFFER));
+
+            if (status == GL_FRAMEBUFFER_COMPLETE) {
+                std::map<uint8_t, Core::ProxyType<IModel>> models;
+
+                bool found(false);
+                uint8_t quality(0);
+                float scale(1.0f);
+                uint32_t cost(~0);
+
+                glDisable(GL_SCISSOR_TEST);
+                glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+                for (std::vector<float>::const_iterator candidate = scales.begin(); (found == false) && (candidate != scales.end()); ++candidate) {
+                    for (std::vector<uint8_t>::const_iterator tier = qualities.begin(); (found == false) && (tier != qualities.end()); ++tier) {
+                        std::map<uint8_t, Core::ProxyType<IModel>>::iterator index(models.find(*tier));
+
+                        // One program per quality, the render scale is changed on the built model.
+                        if (index == models.end()) {
+                            ModelConfig variant(config);
+
+                            variant.Quality = *tier;
+                            variant.RenderScale = 1.0f; // the candidate is set as a factor on it
+
+                            Core::ProxyType<IModel> model(IModel::Create(variant));
+
+                            model->Position(DimensionType(0, 0));
+                            model->Size(SizeType(width, height));
+
+                            if (model->Construct() == false) {
+                                TRACE(Trace::Error, ("Calibrating %s: quality %d does not build", key.c_str(), *tier));
+                                model.Release();
+                            }
+
+                            index = models.emplace(*tier, model).first;
+                        }
+
+                        if (index->second.IsValid() == true) {
+                            index->second->Scale(*candidate);
+
+                            const uint32_t time(Time(*(index->second)));
+
+                            TRACE(Trace::Information, ("Calibrating %s: quality %d scale %.2f %dus of %dus", key.c_str(), *tier, *candidate, time, budget));
+
+                            if ((time <= budget) || (time < cost)) {
+                                quality = *tier;
+                                scale = *candidate;
+                                cost = time;
+                                found = (time <= budget);
+                            }
+                        }
+                    }
+                }
+
+                for (std::pair<const uint8_t, Core::ProxyType<IModel>>& model : models) {
+                    if (model.second.IsValid() == true) {
+                        model.second->Destroy();
+                        model.second.Release();
+                    }
+                }
+
+                if (cost != static_cast<uint32_t>(~0)) {
+                    Core::SafeSyncType<Core::CriticalSection> scopedLock(_adminLock);
+
+                    Entry& entry(_results.Models.Add());
+
+                    entry.Model = key;
+                    entry.Width = width;
+                    entry.Height = height;
+                    entry.Budget = budget;
+                    entry.Quality = quality;
+                    entry.RenderScale = scale;
+                    entry.FrameTime = cost;
+
+                    config.Quality = quality;
+                    config.RenderScale = scale;
+
+                    _changed = true;
+                    result = true;
+
+                    TRACE(Trace::Information, ("Calibrated %s in %dms: quality %d scale %.2f, %dus of %dus%s", key.c_str(), static_cast<uint32_t>((Monotonic() - start) / 1000), quality, scale, cost, budget, (found == true) ? "" : ", over budget"));
+                }
+            } else {
+                TRACE(Trace::Error, ("Calibration target %dx%d incomplete: 0x%04X", width, height, status));
+            }
+
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteTextures(1, &texture);
+        }
+
+        return (result);
+    }
+
+    uint32_t Calibration::Time(IModel& model) const
+    {
+        std::vector<uint32_t> samples;
+        const uint64_t start(Monotonic());
+
+        for (uint8_t frame = 0; frame < (WarmupFrames + MaxFrames); ++frame) {
+            if ((frame >= (WarmupFrames + MinFrames)) && ((Monotonic() - start) >= (SampleTime * 1000ULL))) {
+                break;
+            }
+
+            const uint64_t begin(Monotonic());
+
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            model.Process(0, nullptr);
+
+            // Wait for the GPU, so the time is the complete cost of the frame.
+            glFinish();
+
+            if (frame >= WarmupFrames) {
+                samples.push_back(static_cast<uint32_t>(Monotonic() - begin));
+            }
+        }
+
+        std::nth_element(samples.begin(), samples.begin() + (samples.size() / 2), samples.end());
+
+        return (samples[samples.size() / 2]);
+    }
+
+    bool Calibration::Save()
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_adminLock);
+
+        bool result(true);
+
+        if (_changed == true) {
+            string json;
+
+            _results.ToString(json);
+
+            result = WriteAtomic(_fileName, reinterpret_cast<const uint8_t*>(json.c_str()), static_cast<uint32_t>(json.size()));
+
+            if (result == true) {
+                _changed = false;
+            } else {
+                TRACE(Trace::Error, ("Could not store calibration %s", _fileName.c_str()));
+            }
+        }
+
+        return (result);
+    }
+
+} // namespace Graphics
+} // namespace Thunder
@@ -0,0 +1,181 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include "IModel.h"
+
+namespace Thunder {
+namespace Graphics {
+    // Picks the quality and render scale of a model for this device: the model
+    // is rendered offscreen at its size for the candidates, highest render scale
+    // first and within that the highest quality, until one fits the frame budget.
+    // Results are stored per model in a file that is only valid for the
+    // GL_RENDERER string and the plugin version it was measured with, so a
+    // device is calibrated once and again after a driver or plugin update.
+    // Measured on the warm-up context while the results are looked up by others.
+    class EXTERNAL Calibration {
+    public:
+        static constexpr uint8_t WarmupFrames = 3; // not measured, first use of the program
+        static constexpr uint8_t MinFrames = 5;
+        static constexpr uint8_t MaxFrames = 30;
+        static constexpr uint16_t SampleTime = 300; // ms, per candidate once MinFrames are measured
+        static constexpr uint8_t Headroom = 80; // percent of the frame period the models may take
+
+        class Entry : public Core::JSON::Container {
+        public:
+            Entry& operator=(const Entry& RHS)
+            {
+                Model = RHS.Model;
+                Width = RHS.Width;
+                Height = RHS.Height;
+                Budget = RHS.Budget;
+                Quality = RHS.Quality;
+                RenderScale = RHS.RenderScale;
+                FrameTime = RHS.FrameTime;
+
+                return (*this);
+            }
+
+            Entry(const Entry& copy)
+                : Core::JSON::Container()
+                , Model(copy.Model)
+                , Width(copy.Width)
+                , Height(copy.Height)
+                , Budget(copy.Budget)
+                , Quality(copy.Quality)
+                , RenderScale(copy.RenderScale)
+                , FrameTime(copy.FrameTime)
+            {
+                Init();
+            }
+
+            Entry()
+                : Core::JSON::Container()
+                , Model()
+                , Width(0)
+                , Height(0)
+                , Budget(0)
+                , Quality(0)
+                , RenderScale(1.0)
+                , FrameTime(0)
+            {
+                Init();
+            }
+
+            ~Entry() override = default;
+
+        private:
+            void Init()
+            {
+                Add(_T("model"), &Model);
+                Add(_T("width"), &Width);
+                Add(_T("height"), &Height);
+                Add(_T("budget"), &Budget);
+                Add(_T("quality"), &Quality);
+                Add(_T("renderscale"), &RenderScale);
+                Add(_T("frametime"), &FrameTime);
+            }
+
+        public:
+            Core::JSON::String Model; // see Key()
+            Core::JSON::DecUInt16 Width;
+            Core::JSON::DecUInt16 Height;
+            Core::JSON::DecUInt32 Budget; // us, the frame time it had to meet
+            Core::JSON::DecUInt8 Quality;
+            Core::JSON::Float RenderScale;
+            Core::JSON::DecUInt32 FrameTime; // us, median of the selected candidate
+        };
+
+        class Results : public Core::JSON::Container {
+        public:
+            Results(const Results&) = delete;
+            Results& operator=(const Results&) = delete;
+
+            Results()
+                : Core::JSON::Container()
+                , Renderer()
+                , Version()
+                , Models()
+            {
+                Add(_T("renderer"), &Renderer);
+                Add(_T("version"), &Version);
+                Add(_T("models"), &Models);
+            }
+
+            ~Results() override = default;
+
+        public:
+            Core::JSON::String Renderer;
+            Core::JSON::String Version;
+            Core::JSON::ArrayType<Entry> Models;
+        };
+
+    public:
+        Calibration(const Calibration&) = delete;
+        Calibration& operator=(const Calibration&) = delete;
+
+        Calibration();
+        ~Calibration() = default;
+
+    public:
+        // Reads the stored results, they are dropped if measured with another
+        // renderer or plugin version.
+        void Open(const string& fileName, const string& renderer, const string& version);
+
+    public:
+        // us per frame for each of the models shown together, 0 without a frame rate.
+        static uint32_t Budget(const uint16_t fps, const uint16_t models)
+        {
+            return (((fps != 0) && (models != 0)) ? ((((1000000 / fps) * Headroom) / 100) / models) : 0);
+        }
+
+        // Names the shader and its defines, the size and budget are matched apart.
+        static string Key(const ModelConfig& config);
+
+        // Sets the stored quality and render scale, false if not calibrated
+        // for this size and budget.
+        bool Apply(ModelConfig& config, const uint32_t budget) const;
+
+        // Needs a current context. Measures the candidates, sets the selected
+        // one on the config and adds it to the results. A quality or render
+        // scale set in the config is kept, only the other one is calibrated.
+        // False if nothing was selected.
+        bool Measure(ModelConfig& config, const uint32_t budget);
+
+        // Writes the results if anything was measured.
+        bool Save();
+
+    private:
+        const Entry* Find(const string& key, const ModelConfig& config, const uint32_t budget) const;
+
+        // Median frame time in us, rendered into the bound framebuffer.
+        uint32_t Time(IModel& model) const;
+
+    private:
+        mutable Core::CriticalSection _adminLock; // _results
+        string _fileName;
+        Results _results;
+        bool _changed;
+    }; // class Calibration
+
+} // namespace Graphics
+} // namespace Thunder
@@ -0,0 +1,164 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include <atomic>
+#include <functional>
+#include <future>
+
+namespace Thunder {
+namespace Graphics {
+    // Multi-producer, single-consumer queue of commands (Vyukov's intrusive
+    // MPSC queue). Posting is a single atomic exchange, so callers never wait
+    // for the consumer. Only the consumer may call Process() and IsEmpty().
+    class CommandQueue {
+    public:
+        typedef std::function<void()> Command;
+
+    private:
+        struct Node {
+            Node()
+                : Next(nullptr)
+                , Action()
+                , Done()
+            {
+            }
+
+            std::atomic<Node*> Next;
+            Command Action;
+            std::promise<void> Done;
+        };
+
+    public:
+        CommandQueue(const CommandQueue&) = delete;
+        CommandQueue& operator=(const CommandQueue&) = delete;
+
+        CommandQueue()
+            : _head(&_stub)
+            , _tail(&_stub)
+            , _stub()
+        {
+        }
+        ~CommandQueue()
+        {
+            // Whoever still waits for these sees a broken promise.
+            Node* node;
+
+            while ((node = Pop()) != nullptr) {
+                delete node;
+            }
+        }
+
+    public:
+        // The future is ready once the consumer ran the command.
+        std::future<void> Post(Command&& command)
+        {
+            Node* node(new Node());
+
+            node->Action = std::move(command);
+
+            std::future<void> result(node->Done.get_future());
+
+            Push(node);
+
+            return (result);
+        }
+
+        // Runs all commands posted so far, in order, returns how many ran.
+        uint32_t Process()
+        {
+            uint32_t count(0);
+            Node* node;
+
+            while ((node = Pop()) != nullptr) {
+                node->Action();
+                node->Done.set_value();
+                delete node;
+                ++count;
+            }
+
+            return (count);
+        }
+
+        // Also false while a post is still being linked in, Process() may
+        // then return before running it.
+        bool IsEmpty() const
+        {
+            return ((_tail == &_stub) && (_head.load(std::memory_order_acquire) == &_stub));
+        }
+
+    private:
+        void Push(Node* node)
+        {
+            node->Next.store(nullptr, std::memory_order_relaxed);
+
+            Node* previous(_head.exchange(node, std::memory_order_acq_rel));
+
+            previous->Next.store(node, std::memory_order_release);
+        }
+
+        Node* Pop()
+        {
+            Node* tail(_tail);
+            Node* next(tail->Next.load(std::memory_order_acquire));
+
+            if (tail == &_stub) {
+                if (next == nullptr) {
+                    return (nullptr);
+                }
+
+                _tail = next;
+                tail = next;
+                next = next->Next.load(std::memory_order_acquire);
+            }
+
+            if (next != nullptr) {
+                _tail = next;
+                return (tail);
+            }
+
+            if (tail != _head.load(std::memory_order_acquire)) {
+                // A producer swapped the head but did not link it yet.
+                return (nullptr);
+            }
+
+            // Last node, put the stub behind it so it can be handed out.
+            Push(&_stub);
+
+            next = tail->Next.load(std::memory_order_acquire);
+
+            if (next != nullptr) {
+                _tail = next;
+                return (tail);
+            }
+
+            return (nullptr);
+        }
+
+    private:
+        std::atomic<Node*> _head; // producers
+        Node* _tail; // consumer
+        Node _stub;
+    }; // class CommandQueue
+
+} // namespace Graphics
+} // namespace Thunder
@@ -0,0 +1,450 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include "Tracing.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+
+#ifndef EGL_BUFFER_AGE_EXT
+#define EGL_BUFFER_AGE_EXT 0x313D
+#endif
+
+namespace Thunder {
+namespace Graphics {
+    // Partial presents. The damage of a frame is the union of the layers that
+    // changed, a few rectangles. With EGL_EXT_buffer_age (or the age query of
+    // EGL_KHR_partial_update) the back buffer still holds the frame of age
+    // swaps ago, so only the damage of the frames since needs to be repainted;
+    // EGL_KHR_partial_update also tells the driver that region up front. With
+    // EGL_KHR/EXT_swap_buffers_with_damage the compositor is told what changed.
+    // Without any of these every frame is repainted and swapped in full.
+    class Damage {
+    public:
+        static constexpr uint8_t History = 4; // older back buffers are repainted in full
+
+        // Window coordinates, origin bottom-left, as EGL expects them.
+        struct Rectangle {
+            Rectangle()
+                : X(0)
+                , Y(0)
+                , Width(0)
+                , Height(0)
+            {
+            }
+
+            Rectangle(const int32_t x, const int32_t y, const int32_t width, const int32_t height)
+                : X(x)
+                , Y(y)
+                , Width(std::max(width, 0))
+                , Height(std::max(height, 0))
+            {
+            }
+
+            bool IsEmpty() const
+            {
+                return ((Width == 0) || (Height == 0));
+            }
+
+            bool Contains(const Rectangle& other) const
+            {
+                return ((X <= other.X) && (Y <= other.Y) && ((X + Width) >= (other.X + other.Width)) && ((Y + Height) >= (other.Y + other.Height)));
+            }
+
+            bool Overlaps(const Rectangle& other) const
+            {
+                return ((IsEmpty() == false) && (other.IsEmpty() == false) && (X < (other.X + other.Width)) && (other.X < (X + Width)) && (Y < (other.Y + other.Height)) && (other.Y < (Y + Height)));
+            }
+
+            uint64_t Area() const
+            {
+                return (static_cast<uint64_t>(Width) * Height);
+            }
+
+            // Bounding box, an empty side does not count.
+            void Add(const Rectangle& other)
+            {
+                if (IsEmpty() == true) {
+                    *this = other;
+                } else if (other.IsEmpty() == false) {
+                    const int32_t right(std::max(X + Width, other.X + other.Width));
+                    const int32_t top(std::max(Y + Height, other.Y + other.Height));
+
+                    X = std::min(X, other.X);
+                    Y = std::min(Y, other.Y);
+                    Width = right - X;
+                    Height = top - Y;
+                }
+            }
+
+            Rectangle Intersection(const Rectangle& other) const
+            {
+                const int32_t x(std::max(X, other.X));
+                const int32_t y(std::max(Y, other.Y));
+
+                return (Rectangle(x, y, std::min(X + Width, other.X + other.Width) - x, std::min(Y + Height, other.Y + other.Height) - y));
+            }
+
+            int32_t X;
+            int32_t Y;
+            int32_t Width;
+            int32_t Height;
+        };
+
+        // Union of up to MaxRectangles rectangles that do not overlap. Only
+        // overlapping ones are merged into their bounding box, so two models
+        // far apart stay two small rectangles. When all are taken the new one
+        // is merged with the rectangle whose bounding box grows the least.
+        class Region {
+        public:
+            static constexpr uint8_t MaxRectangles = 4;
+
+        public:
+            Region()
+                : _rectangles()
+                , _count(0)
+            {
+            }
+
+            bool IsEmpty() const
+            {
+                return (_count == 0);
+            }
+
+            uint8_t Count() const
+            {
+                return (_count);
+            }
+
+            const Rectangle& operator[](const uint8_t index) const
+            {
+                ASSERT(index < _count);
+                return (_rectangles[index]);
+            }
+
+            uint64_t Area() const
+            {
+                uint64_t result(0);
+
+                for (uint8_t index = 0; index < _count; ++index) {
+                    result += _rectangles[index].Area();
+                }
+
+                return (result);
+            }
+
+            bool Contains(const Rectangle& other) const
+            {
+                bool result(other.IsEmpty());
+
+                for (uint8_t index = 0; (result == false) && (index < _count); ++index) {
+                    result = _rectangles[index].Contains(other);
+                }
+
+                return (result);
+            }
+
+            bool Overlaps(const Rectangle& other) const
+            {
+                bool result(false);
+
+                for (uint8_t index = 0; (result == false) && (index < _count); ++index) {
+                    result = _rectangles[index].Overlaps(other);
+                }
+
+                return (result);
+            }
+
+            void Add(const Rectangle& other)
+            {
+                if (other.IsEmpty() == false) {
+                    Rectangle merged(other);
+                    bool grown(true);
+
+                    // A merge can make the box overlap others, until none does.
+                    while (grown == true) {
+                        grown = false;
+
+                        for (uint8_t index = 0; index < _count;) {
+                            if (_rectangles[index].Overlaps(merged) == true) {
+                                merged.Add(_rectangles[index]);
+                                _rectangles[index] = _rectangles[--_count];
+                                grown = true;
+                            } else {
+                                ++index;
+                            }
+                        }
+
+                        if ((grown == false) && (_count == MaxRectangles)) {
+                            uint8_t closest(0);
+                            uint64_t growth(~0ULL);
+
+                            for (uint8_t index = 0; index < _count; ++index) {
+                                Rectangle box(_rectangles[index]);
+
+                                box.Add(merged);
+
+                                if ((box.Area() - _rectangles[index].Area()) < growth) {
+                                    growth = box.Area() - _rectangles[index].Area();
+                                    closest = index;
+                                }
+                            }
+
+                            merged.Add(_rectangles[closest]);
+                            _rectangles[closest] = _rectangles[--_count];
+                            grown = true;
+                        }
+                    }
+
+                    _rectangles[_count++] = merged;
+                }
+            }
+
+            void Add(const Region& other)
+            {
+                for (uint8_t index = 0; index < other._count; ++index) {
+                    Add(other._rectangles[index]);
+                }
+            }
+
+            Region Intersection(const Rectangle& other) const
+            {
+                Region result;
+
+                // Parts of rectangles that do not overlap do not overlap either.
+                for (uint8_t index = 0; index < _count; ++index) {
+                    const Rectangle part(_rectangles[index].Intersection(other));
+
+                    if (part.IsEmpty() == false) {
+                        result._rectangles[result._count++] = part;
+                    }
+                }
+
+                return (result);
+            }
+
+            // x, y, width, height per rectangle, as the EGL damage calls take them.
+            EGLint Rects(EGLint rects[MaxRectangles * 4]) const
+            {
+                for (uint8_t index = 0; index < _count; ++index) {
+                    rects[(index * 4) + 0] = _rectangles[index].X;
+                    rects[(index * 4) + 1] = _rectangles[index].Y;
+                    rects[(index * 4) + 2] = _rectangles[index].Width;
+                    rects[(index * 4) + 3] = _rectangles[index].Height;
+                }
+
+                return (_count);
+            }
+
+        private:
+            Rectangle _rectangles[MaxRectangles];
+            uint8_t _count;
+        };
+
+    private:
+        typedef EGLBoolean(EGLAPIENTRYP SwapBuffersWithDamage)(EGLDisplay display, EGLSurface surface, const EGLint* rects, EGLint count);
+        typedef EGLBoolean(EGLAPIENTRYP SetDamageRegion)(EGLDisplay display, EGLSurface surface, EGLint* rects, EGLint count);
+
+        static bool HasExtension(const char* extensions, const char* name)
+        {
+            return ((extensions != nullptr) && (strstr(extensions, name) != nullptr));
+        }
+
+    public:
+        Damage(const Damage&) = delete;
+        Damage& operator=(const Damage&) = delete;
+
+        Damage()
+            : _display(EGL_NO_DISPLAY)
+            , _surface(EGL_NO_SURFACE)
+            , _full()
+            , _age(false)
+            , _history()
+            , _head(0)
+            , _frame()
+            , _begun(false)
+            , _swapWithDamage(nullptr)
+            , _setDamageRegion(nullptr)
+            , _frames(0)
+            , _repainted(0)
+        {
+        }
+        ~Damage() = default;
+
+    public:
+        // Without enabling, or the extensions, every frame is full.
+        void Initialize(EGLDisplay display, EGLSurface surface, const uint32_t width, const uint32_t height, const bool enable)
+        {
+            const char* extensions(eglQueryString(display, EGL_EXTENSIONS));
+
+            _display = display;
+            _surface = surface;
+            _full = Rectangle(0, 0, static_cast<int32_t>(width), static_cast<int32_t>(height));
+
+            if (enable == true) {
+                if (HasExtension(extensions, "EGL_KHR_partial_update") == true) {
+                    _setDamageRegion = reinterpret_cast<SetDamageRegion>(eglGetProcAddress("eglSetDamageRegionKHR"));
+                }
+
+                _age = (_setDamageRegion != nullptr) || (HasExtension(extensions, "EGL_EXT_buffer_age") == true);
+
+                if (HasExtension(extensions, "EGL_KHR_swap_buffers_with_damage") == true) {
+                    _swapWithDamage = reinterpret_cast<SwapBuffersWithDamage>(eglGetProcAddress("eglSwapBuffersWithDamageKHR"));
+                } else if (HasExtension(extensions, "EGL_EXT_swap_buffers_with_damage") == true) {
+                    _swapWithDamage = reinterpret_cast<SwapBuffersWithDamage>(eglGetProcAddress("eglSwapBuffersWithDamageEXT"));
+                }
+            }
+
+            Reset();
+
+            TRACE(Trace::Information, ("Partial presents: buffer age %s, damage region %s, swap with damage %s", (_age == true) ? "yes" : "no", (_setDamageRegion != nullptr) ? "yes" : "no", (_swapWithDamage != nullptr) ? "yes" : "no"));
+        }
+
+        void Deinitialize()
+        {
+            _swapWithDamage = nullptr;
+            _setDamageRegion = nullptr;
+            _age = false;
+            _surface = EGL_NO_SURFACE;
+            _display = EGL_NO_DISPLAY;
+        }
+
+        // Only whole frames until the next full swap.
+        void Reset()
+        {
+            for (Region& entry : _history) {
+                entry = Region();
+                entry.Add(_full);
+            }
+
+            _begun = false;
+        }
+
+        const Rectangle& Full() const
+        {
+            return (_full);
+        }
+
+        // Before drawing: where the back buffer has to be repainted for it to
+        // show this frame, its damage plus that of the frames it missed.
+        Region Repaint(const Region& damage) const
+        {
+            Region result;
+
+            result.Add(_full);
+
+            if (_age == true) {
+                EGLint age(0);
+
+                if ((eglQuerySurface(_display, _surface, EGL_BUFFER_AGE_EXT, &age) == EGL_TRUE) && (age > 0) && (age <= History)) {
+                    Region missed(damage);
+
+                    for (uint8_t index = 1; index < age; ++index) {
+                        missed.Add(_history[(_head + History - index) % History]);
+                    }
+
+                    result = missed.Intersection(_full);
+                }
+            }
+
+            return (result);
+        }
+
+        // Before drawing, after Repaint(): only the repaint area is drawn, the
+        // damage is what changed on screen.
+        void Begin(const Region& repaint, const Region& damage)
+        {
+            if ((_setDamageRegion != nullptr) && (repaint.Contains(_full) == false)) {
+                EGLint rects[Region::MaxRectangles * 4];
+
+                _setDamageRegion(_display, _surface, rects, repaint.Rects(rects));
+            }
+
+            _frame = damage.Intersection(_full);
+            _begun = true;
+
+            ++_frames;
+            _repainted += repaint.Area();
+        }
+
+        // Swaps with the damage of Begin(), a swap without it is a full frame.
+        EGLBoolean Swap()
+        {
+            Region damage;
+
+            if (_begun == true) {
+                damage = _frame;
+            } else {
+                damage.Add(_full);
+            }
+
+            EGLBoolean result;
+
+            if ((_swapWithDamage != nullptr) && (damage.Contains(_full) == false)) {
+                EGLint rects[Region::MaxRectangles * 4];
+
+                result = _swapWithDamage(_display, _surface, rects, damage.Rects(rects));
+            } else {
+                result = eglSwapBuffers(_display, _surface);
+            }
+
+            _history[_head] = damage;
+            _head = (_head + 1) % History;
+            _begun = false;
+
+            return (result);
+        }
+
+        // Repainted share of the drawn frames, 1.0 without partial presents.
+        double Ratio() const
+        {
+            const uint64_t full(static_cast<uint64_t>(_full.Width) * _full.Height * _frames);
+
+            return ((full != 0) ? (static_cast<double>(_repainted) / full) : 1.0);
+        }
+
+    private:
+        EGLDisplay _display;
+        EGLSurface _surface;
+        Rectangle _full;
+        bool _age;
+
+        Region _history[History]; // damage of the last swaps
+        uint8_t _head;
+        Region _frame; // damage of the frame being drawn
+        bool _begun;
+
+        SwapBuffersWithDamage _swapWithDamage;
+        SetDamageRegion _setDamageRegion;
+
+        std::atomic<uint32_t> _frames;
+        std::atomic<uint64_t> _repainted; // pixels
+    }; // class Damage
+
+} // namespace Graphics
+} // namespace Thunder
@@ -0,0 +1,146 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Thunder {
+namespace Graphics {
+    // Closed loop render scale controller. The measured frame cost is
+    // smoothed and compared with the frame budget; the scale only changes
+    // after the cost stayed out of the [Low, High] band for a while, and is
+    // then left alone until the new cost is measured.
+    class DynamicResolution {
+    private:
+        static constexpr float High = 0.90f; // of budget, scale down above
+        static constexpr float Target = 0.75f; // of budget, aim for after scaling down
+        static constexpr float Low = 0.55f; // of budget, scale up below
+        static constexpr float Smoothing = 0.1f;
+        static constexpr float Step = 0.05f;
+        static constexpr uint16_t DownFrames = 10;
+        static constexpr uint16_t UpFrames = 60;
+        static constexpr uint16_t Settle = 30; // frames to ignore after a change
+
+    public:
+        DynamicResolution(const DynamicResolution&) = delete;
+        DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+        DynamicResolution()
+            : _enabled(false)
+            , _budget(0)
+            , _minimum(0.25f)
+            , _maximum(1.0f)
+            , _scale(1.0f)
+            , _cost(0)
+            , _over(0)
+            , _under(0)
+            , _settle(0)
+        {
+        }
+        ~DynamicResolution() = default;
+
+    public:
+        void Configure(const bool enabled, const uint16_t fps, const float minimum, const float maximum)
+        {
+            _enabled = (enabled == true) && (fps > 0);
+            _budget = (fps > 0) ? (1000000.0f / fps) : 0;
+            _minimum = std::min(std::max(minimum, 0.1f), 1.0f);
+            _maximum = std::min(std::max(maximum, _minimum), 1.0f);
+            _scale = _maximum;
+            Reset();
+        }
+
+        // Start measuring from scratch, e.g. after the models changed.
+        void Reset()
+        {
+            _cost = 0;
+            _over = 0;
+            _under = 0;
+            _settle = Settle;
+        }
+
+        bool IsEnabled() const
+        {
+            return (_enabled);
+        }
+
+        float Scale() const
+        {
+            return (_scale);
+        }
+
+        // Frame cost in us, returns true if the scale changed.
+        bool Update(const uint32_t cost)
+        {
+            bool changed(false);
+
+            if (_enabled == true) {
+                if (_settle > 0) {
+                    --_settle;
+                    _cost = static_cast<float>(cost);
+                } else {
+                    _cost += (Smoothing * (static_cast<float>(cost) - _cost));
+
+                    _over = (_cost > (High * _budget)) ? (_over + 1) : 0;
+                    _under = (_cost < (Low * _budget)) ? (_under + 1) : 0;
+
+                    float scale(_scale);
+
+                    if (_over >= DownFrames) {
+                        // Cost is roughly proportional to the pixel count, the square of the scale.
+                        scale = _scale * std::sqrt((Target * _budget) / _cost);
+                    } else if (_under >= UpFrames) {
+                        scale = _scale + Step;
+                    }
+
+                    scale = std::min(std::max(std::round(scale / Step) * Step, _minimum), _maximum);
+
+                    if (std::abs(scale - _scale) >= (Step / 2)) {
+                        TRACE(Trace::Information, ("Render scale %.2f -> %.2f, frame cost %.1fms of %.1fms", _scale, scale, _cost / 1000, _budget / 1000));
+
+                        _scale = scale;
+                        changed = true;
+                        _over = 0;
+                        _under = 0;
+                        _settle = Settle;
+                    }
+                }
+            }
+
+            return (changed);
+        }
+
+    private:
+        bool _enabled;
+        float _budget; // us
+        float _minimum;
+        float _maximum;
+        float _scale;
+        float _cost; // us, smoothed
+        uint16_t _over;
+        uint16_t _under;
+        uint16_t _settle;
+    }; // class DynamicResolution
+
+} // namespace Graphics
+} // namespace Thunder
@@ -14,6 +14,8 @@
 #include <GLES2/gl2ext.h>
 #include <esUtil.h>
 
+#include <algorithm>
+
 namespace Thunder {
 namespace Graphics {
 
@@ -222,7 +224,7 @@ namespace Graphics {
             return (eglResult == GL_TRUE);
         }
 
-        void Process() override
+        void Process(const uint8_t count, const ScissorType boxes[]) override
         {
             static uint32_t frameNumber;
             int r, g, b;
@@ -245,7 +247,6 @@ namespace Graphics {
              * Different color every frame
              */
             glClearColor(r / 256.0, g / 256.0, b / 256.0, 1.0);
-            glClear(GL_COLOR_BUFFER_BIT);
 
             /* clear the color buffer */
             // glClearColor(0.5, 0.5, 0.5, 1.0);
@@ -284,12 +285,21 @@ namespace Graphics {
             glUniformMatrix4fv(_modelviewprojectionmatrix, 1, GL_FALSE, &modelviewprojection.m[0][0]);
             glUniformMatrix3fv(_normalmatrix, 1, GL_FALSE, normal);
 
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-            glDrawArrays(GL_TRIANGLE_STRIP, 4, 4);
-            glDrawArrays(GL_TRIANGLE_STRIP, 8, 4);
-            glDrawArrays(GL_TRIANGLE_STRIP, 12, 4);
-            glDrawArrays(GL_TRIANGLE_STRIP, 16, 4);
-            glDrawArrays(GL_TRIANGLE_STRIP, 20, 4);
+            // Same frame in every box, without boxes the scissor is left alone.
+            for (uint8_t index = 0; index < std::max(count, static_cast<uint8_t>(1)); ++index) {
+                if (count != 0) {
+                    glScissor(boxes[index].X, boxes[index].Y, boxes[index].Width, boxes[index].Height);
+                }
+
+                glClear(GL_COLOR_BUFFER_BIT);
+
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                glDrawArrays(GL_TRIANGLE_STRIP, 4, 4);
+                glDrawArrays(GL_TRIANGLE_STRIP, 8, 4);
+                glDrawArrays(GL_TRIANGLE_STRIP, 12, 4);
+                glDrawArrays(GL_TRIANGLE_STRIP, 16, 4);
+                glDrawArrays(GL_TRIANGLE_STRIP, 20, 4);
+            }
 
             glDisable(GL_CULL_FACE);
 
@@ -310,6 +320,24 @@ namespace Graphics {
         {
         }
 
+        void Scale(const float scale) override
+        {
+        }
+
+        uint32_t Footprint() const override
+        {
+            return (0);
+        }
+
+        uint16_t Rate() const override
+        {
+            return (IModel::Continuous);
+        }
+
+        void Prepare() override
+        {
+        }
+
         bool IsValid() const override
         {
             return (_program != GL_FALSE);
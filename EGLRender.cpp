@@ -2,6 +2,10 @@
 
 #include "EGLRender.h"
 #include "EGLToolbox.h"
+#ifdef SCREENSAVER_HEADLESS
+#include "Headless.h"
+#endif
+#include "ProgramCache.h"
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
@@ -12,48 +16,100 @@
 #include <compositor/Client.h>
 #include <simpleworker/SimpleWorker.h>
 
+#include <chrono>
+
+ENUM_CONVERSION_BEGIN(Thunder::Graphics::FrameClock::policy)
+    { Thunder::Graphics::FrameClock::SKIP, _TXT("skip") },
+    { Thunder::Graphics::FrameClock::CATCHUP, _TXT("catchup") },
+ENUM_CONVERSION_END(Thunder::Graphics::FrameClock::policy)
+
+ENUM_CONVERSION_BEGIN(Thunder::Graphics::PresentQueue::mode)
+    { Thunder::Graphics::PresentQueue::BLOCKING, _TXT("blocking") },
+    { Thunder::Graphics::PresentQueue::PIPELINED, _TXT("pipelined") },
+ENUM_CONVERSION_END(Thunder::Graphics::PresentQueue::mode)
+
+ENUM_CONVERSION_BEGIN(Thunder::Graphics::RenderConfig::loop)
+    { Thunder::Graphics::RenderConfig::TIMER, _TXT("timer") },
+    { Thunder::Graphics::RenderConfig::COMPOSITOR, _TXT("compositor") },
+ENUM_CONVERSION_END(Thunder::Graphics::RenderConfig::loop)
+
+ENUM_CONVERSION_BEGIN(Thunder::Graphics::RenderConfig::backend)
+    { Thunder::Graphics::RenderConfig::WINDOW, _TXT("compositor") },
+    { Thunder::Graphics::RenderConfig::HEADLESS, _TXT("headless") },
+ENUM_CONVERSION_END(Thunder::Graphics::RenderConfig::backend)
+
 namespace Thunder {
 namespace Graphics {
     static constexpr uint8_t RenderUpdateIntervalSeconds = 5;
 
-    static constexpr EGLint RedBufferSize = 8;
-    static constexpr EGLint GreenBufferSize = 8;
-    static constexpr EGLint BlueBufferSize = 8;
-    static constexpr EGLint AlphaBufferSize = 8;
-    static constexpr EGLint DepthBufferSize = 0;
+    static uint64_t Monotonic() // in us
+    {
+        return (std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
 
     constexpr EGLint defaultContextAttribs[] = {
         EGL_CONTEXT_CLIENT_VERSION, 2,
         EGL_NONE
     };
 
-    constexpr EGLint defaultConfigAttribs[] = {
-        EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
-        EGL_RED_SIZE, RedBufferSize,
-        EGL_GREEN_SIZE, GreenBufferSize,
-        EGL_BLUE_SIZE, BlueBufferSize,
-        EGL_ALPHA_SIZE, AlphaBufferSize,
-        EGL_BUFFER_SIZE, RedBufferSize + GreenBufferSize + BlueBufferSize + AlphaBufferSize,
-        /* EGL_DEPTH_SIZE, (majorVersion == 2) ? 16 : 0, */
-        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
-        EGL_SAMPLES, 0,
-        EGL_NONE
-    };
-
     EGLRender::EGLRender()
         : _adminLock()
+        , _commands()
         , _display(nullptr)
         , _surface(nullptr)
         , _eglSurface(EGL_NO_SURFACE)
         , _eglContext(EGL_NO_CONTEXT)
         , _eglDisplay(EGL_NO_DISPLAY)
+        , _warmupContext(EGL_NO_CONTEXT)
+        , _warmupSurface(EGL_NO_SURFACE)
+        , _warmupLock()
+        , _warming(false)
+        , _measurements()
+        , _precompiler(*this)
+        , _renderer()
+        , _width(0)
+        , _height(0)
         , _fps(60)
         , _framesRendered(0)
+        , _loopMode(RenderConfig::TIMER)
+        , _presentTimeout(100)
+        , _published(false)
+        , _headless(false)
+        , _partialPresent(true)
+        , _pixelFormat(FramebufferFormat::RGBA8888)
+        , _compareFormats(false)
+        , _residencyBudget(0)
+        , _residencyIdle(0)
+        , _clock()
+        , _presentQueue()
+        , _gpuTimer()
+        , _sections()
+        , _damage()
+        , _framebuffer()
+        , _readback()
+        , _capture(nullptr)
+        , _captureTag(0)
+        , _recorder(nullptr)
+        , _recordInterval(1)
+        , _recordDropped(0)
+        , _statsLock()
+        , _gpuTimes()
+        , _resolution()
+        , _history()
+        , _frameTime(Histogram::FRAME)
+        , _presentWait(Histogram::FRAME)
+        , _gpuTime(Histogram::FRAME)
+        , _showLatency(Histogram::LATENCY)
+        , _hideLatency(Histogram::LATENCY)
+        , _lastFrame(0)
+        , _dirty(true)
+        , _still(false)
         , _models()
+        , _layers()
+        , _current(false)
+        , _released(false)
         , _suspend(false)
         , _active(false)
-        , _vsync()
-        , _rendering()
     {
         std::cout << __FILE__ << ":" << __LINE__ << " : " << __FUNCTION__ << std::endl;
     }
@@ -65,15 +121,30 @@ namespace Graphics {
 
     void EGLRender::Deinitialize()
     {
+        _precompiler.Stop();
+        _precompiler.Wait(Thunder::Core::Thread::STOPPED, Thunder::Core::infinite);
+
+        _warmupLock.Lock();
+        _measurements.clear();
+        _warmupLock.Unlock();
+
+        if (_eglDisplay != EGL_NO_DISPLAY) {
+            // The GL objects go on the thread that owns the context, which then lets go of it.
+            Submit([this]() { Release(); }).wait();
+        }
+
         Stop();
 
         Wait(Thunder::Core::Thread::STOPPED, Thunder::Core::infinite);
 
+        _layers.clear();
+
         for (auto model : _models) {
-            (model.second)->Destroy();
             (model.second).Release();
         }
 
+        _models.clear();
+
         DeinitEGL();
 
         if (_surface != nullptr) {
@@ -89,17 +160,46 @@ namespace Graphics {
         }
     }
 
-    bool EGLRender::Initialize(const string& name, const uint32_t width, const uint32_t height, const uint16_t fps)
+    bool EGLRender::Initialize(const string& name, const uint32_t width, const uint32_t height, const uint16_t fps, const RenderConfig& config)
     {
         std::stringstream strm;
 
-        TRACE(Trace::Information, ("EGLRender::%s name=%s width=%d, height=%d fps=%d", __FUNCTION__, name.c_str(), width, height, fps));
+        TRACE(Trace::Information, ("EGLRender::%s name=%s width=%d, height=%d fps=%d policy=%s vsynclock=%s", __FUNCTION__, name.c_str(), width, height, fps, config.FramePolicy.Data(), config.VSyncLock.Value() ? "on" : "off"));
 
+        _width = width;
+        _height = height;
         _fps = fps;
+        _loopMode = config.LoopMode.Value();
+        _presentTimeout = config.PresentTimeout.Value();
+        _residencyBudget = static_cast<uint64_t>(config.ResidencyBudget.Value()) * 1024;
+        _residencyIdle = static_cast<uint64_t>(config.ResidencyIdle.Value()) * 1000000;
+        _partialPresent = config.PartialPresent.Value();
+        _pixelFormat = config.PixelFormat.Value();
+        _compareFormats = config.CompareFormats.Value();
+        _released = false;
+
+        _clock.Configure(fps, config.FramePolicy.Value(), config.VSyncLock.Value());
+        _resolution.Configure(config.DynamicResolution.Value(), fps, config.MinScale.Value(), config.MaxScale.Value());
+
+        // When Published() drives the loop there is nothing to wait for after a swap.
+        _presentQueue.Configure((_loopMode == RenderConfig::COMPOSITOR) ? PresentQueue::PIPELINED : config.PresentMode.Value(), config.QueueDepth.Value(), _presentTimeout);
+
+        TRACE(Trace::Information, ("EGLRender::%s loop=%s present=%s depth=%d timeout=%dms", __FUNCTION__, config.LoopMode.Data(), (_presentQueue.Mode() == PresentQueue::PIPELINED) ? "pipelined" : "blocking", _presentQueue.Depth(), _presentTimeout));
 
         strm << name << "-" << time(NULL);
 
-        _display = Compositor::IDisplay::Instance(strm.str());
+        _headless = (config.Backend.Value() == RenderConfig::HEADLESS);
+
+        if (_headless == true) {
+#ifdef SCREENSAVER_HEADLESS
+            _display = Headless::Instance(strm.str(), config.RefreshRate.Value());
+#else
+            TRACE(Trace::Error, ("Headless backend not available in this build"));
+            return (false);
+#endif
+        } else {
+            _display = Compositor::IDisplay::Instance(strm.str());
+        }
         ASSERT(_display != nullptr);
 
         _surface = _display->Create(strm.str(), width, height, this);
@@ -110,27 +210,230 @@ namespace Graphics {
 
     uint32_t EGLRender::Add(const ModelConfig config)
     {
-        static uint32_t identifier = 1;
+        static std::atomic<uint32_t> identifier(1);
+
+        const uint32_t id(identifier++);
+
+        Core::ProxyType<IModel> model(IModel::Create(config));
+
+        const uint16_t width((config.Width.Value() == 0) ? _width : config.Width.Value());
+        const uint16_t height((config.Height.Value() == 0) ? _height : config.Height.Value());
+
+        // The model configuration has its origin top-left, GL bottom-left.
+        int32_t y(static_cast<int32_t>(_height) - config.Y.Value() - height);
+
+        if (y < 0) {
+            TRACE(Trace::Error, ("Model %d does not fit the surface height, moved to the bottom", id));
+            y = 0;
+        }
+
+        model->Position(DimensionType(config.X.Value(), y, config.Z.Value()));
+        model->Size(SizeType(width, height));
+
+        const Layer layer(id, model, config.X.Value(), y, config.Z.Value(), width, height);
+        const int32_t top(config.Y.Value());
+
+        Submit([this, layer, top]() {
+            _adminLock.Lock();
+
+            _models.emplace(std::piecewise_construct,
+                std::forward_as_tuple(layer.Id),
+                std::forward_as_tuple(layer.Model));
 
-        _models.emplace(std::piecewise_construct,
-            std::forward_as_tuple(identifier),
-            std::forward_as_tuple(IModel::Create(config)));
+            _adminLock.Unlock();
 
-        TRACE(Trace::Information, ("Added Model %d", identifier));
+            _layers.push_back(layer);
 
-        return identifier++;
+            Arrange();
+
+            TRACE(Trace::Information, ("Added Model %d at %dx%d z=%d %dwx%dh", layer.Id, layer.X, top, layer.Z, layer.Width, layer.Height));
+        });
+
+        return (id);
     }
 
     void EGLRender::Remove(const uint32_t identifier)
     {
-        ModelMap::iterator index(_models.find(identifier));
+        Submit([this, identifier]() {
+            Core::ProxyType<IModel> model;
+
+            _adminLock.Lock();
+
+            ModelMap::iterator index(_models.find(identifier));
+
+            ASSERT(index != _models.end());
+
+            if (index != _models.end()) {
+                model = index->second;
+                _models.erase(index);
+            }
+
+            _adminLock.Unlock();
+
+            if (model.IsValid() == true) {
+                _layers.erase(std::remove_if(_layers.begin(), _layers.end(),
+                                  [identifier](const Layer& layer) { return (layer.Id == identifier); }),
+                    _layers.end());
+
+                Arrange();
 
-        ASSERT(index != _models.end());
+                _statsLock.Lock();
+                _gpuTimes.erase(identifier);
+                _statsLock.Unlock();
 
-        if (index != _models.end()) {
-            index->second.Release();
-            _models.erase(index);
-            TRACE(Trace::Information, ("Removed Model %d", identifier));
+                // With the context current, so its GL objects are deleted too.
+                model.Release();
+                TRACE(Trace::Information, ("Removed Model %d", identifier));
+            }
+        });
+    }
+
+    bool EGLRender::Capture(Readback::IConsumer& consumer, const uint32_t tag)
+    {
+        const bool result((_active == true) && (_suspend == false));
+
+        if (result == true) {
+            Submit([this, &consumer, tag]() {
+                _capture = &consumer;
+                _captureTag = tag;
+            });
+        }
+
+        return (result);
+    }
+
+    void EGLRender::CancelCapture()
+    {
+        Submit([this]() { _capture = nullptr; });
+    }
+
+    void EGLRender::Record(Readback::IConsumer* consumer, const uint16_t interval)
+    {
+        ASSERT(interval != 0);
+
+        if ((consumer != nullptr) && (_readback.IsAsynchronous() == false)) {
+            TRACE(Trace::Information, ("Recording without pixel buffer objects, the render thread waits for every read"));
+        }
+
+        Submit([this, consumer, interval]() {
+            _recorder = consumer;
+            _recordInterval = interval;
+        }).wait();
+    }
+
+    void EGLRender::Calibrate(Calibration& calibration, const uint32_t id, const ModelConfig& config, const uint32_t budget)
+    {
+        _warmupLock.Lock();
+        _measurements.push_back({ &calibration, id, config, budget });
+        _warmupLock.Unlock();
+
+        Calibrations();
+    }
+
+    void EGLRender::Calibrations()
+    {
+        if (_active == false) {
+            if (_warmupContext != EGL_NO_CONTEXT) {
+                Core::SafeSyncType<Core::CriticalSection> scopedLock(_warmupLock);
+
+                // One in progress already picks up the queued ones.
+                if ((_warming == false) && (_measurements.empty() == false)) {
+                    _warming = true;
+                    _precompiler.Run();
+                }
+            } else {
+                // No other context, one model per command so a Show waits for one at most.
+                Submit([this]() {
+                    if ((_current == true) && (_released == false) && (Calibrate() == true)) {
+                        Calibrations();
+                    }
+                });
+            }
+        }
+    }
+
+    bool EGLRender::Calibrate()
+    {
+        bool result(false);
+        Measurement measurement {};
+
+        _warmupLock.Lock();
+
+        // Measuring next to a shown render would slow down both, it goes on after the next Hide.
+        const bool due((_active == false) && (_measurements.empty() == false));
+
+        if (due == true) {
+            measurement = _measurements.front();
+            _measurements.erase(_measurements.begin());
+        }
+
+        _warmupLock.Unlock();
+
+        if (due == true) {
+            if (measurement.Results->Measure(measurement.Config, measurement.Budget) == true) {
+                measurement.Results->Save();
+
+                const uint32_t id(measurement.Id);
+                const ModelConfig result(measurement.Config);
+
+                Submit([this, id, result]() {
+                    if ((_current == true) && (_released == false)) {
+                        Replace(id, result);
+                    }
+                });
+            }
+
+            result = true;
+        }
+
+        return (result);
+    }
+
+    void EGLRender::Replace(const uint32_t id, const ModelConfig& config)
+    {
+        LayerList::iterator layer(std::find_if(_layers.begin(), _layers.end(),
+            [id](const Layer& entry) { return (entry.Id == id); }));
+
+        if (layer != _layers.end()) {
+            Core::ProxyType<IModel> model(IModel::Create(config));
+
+            model->Position(DimensionType(layer->X, layer->Y, layer->Z));
+            model->Size(SizeType(layer->Width, layer->Height));
+
+            if (_resolution.IsEnabled() == true) {
+                model->Scale(_resolution.Scale());
+            }
+
+            // A resident model stays resident, one that is shown is drawn with the new one from the next frame.
+            if (layer->Model->IsValid() == true) {
+                layer->Model->Destroy();
+                model->Construct();
+            }
+
+            _adminLock.Lock();
+            _models[id] = model;
+            _adminLock.Unlock();
+
+            layer->Model = model;
+
+            TRACE(Trace::Information, ("Model %d rebuilt with quality %d scale %.2f", id, config.Quality.Value(), config.RenderScale.Value()));
+        }
+    }
+
+    void EGLRender::Arrange()
+    {
+        // Stable, so models with the same z are drawn in the order they were added.
+        std::stable_sort(_layers.begin(), _layers.end(),
+            [](const Layer& a, const Layer& b) { return (a.Z < b.Z); });
+
+        // Models are opaque, a layer fully covered by one drawn later is skipped.
+        for (LayerList::iterator index = _layers.begin(); index != _layers.end(); ++index) {
+            index->Occluded = std::any_of(std::next(index), _layers.end(),
+                [index](const Layer& above) { return (above.Covers(*index)); });
+
+            if (index->Occluded == true) {
+                TRACE(Trace::Information, ("Model %d is occluded", index->Id));
+            }
         }
     }
 
@@ -143,10 +446,13 @@ namespace Graphics {
         EGLint majorVersion(0);
         EGLint minorVersion(0);
         EGLint eglResult(0);
-        EGLint numConfigs(0);
         EGLConfig eglConfig;
 
+#ifdef SCREENSAVER_HEADLESS
+        _eglDisplay = (_headless == true) ? Headless::Platform() : eglGetDisplay(_display->Native());
+#else
         _eglDisplay = eglGetDisplay(_display->Native());
+#endif
         ASSERT(_eglDisplay != EGL_NO_DISPLAY);
 
         TRACE(Trace::Information, ("EGL Display %p", _eglDisplay));
@@ -159,20 +465,46 @@ namespace Graphics {
         eglResult = eglBindAPI(EGL_OPENGL_ES_API);
         ASSERT(eglResult == EGL_TRUE);
 
-        eglResult = eglChooseConfig(_eglDisplay, defaultConfigAttribs, &eglConfig, 1, &numConfigs);
-        ASSERT(eglResult == EGL_TRUE);
+        // Hide clears the window transparent, only headless nothing is shown behind it.
+        eglConfig = _framebuffer.Select(_eglDisplay, (_headless == true) ? EGL_PBUFFER_BIT : EGL_WINDOW_BIT, _pixelFormat, (_headless == false));
+        ASSERT(eglConfig != nullptr);
 
         TRACE(Trace::Information, ("Choosen config: %s", EGL::ConfigInfoLog(_eglDisplay, eglConfig).c_str()));
 
         _eglContext = eglCreateContext(_eglDisplay, eglConfig, EGL_NO_CONTEXT, defaultContextAttribs);
         ASSERT(_eglContext != EGL_NO_CONTEXT);
 
-        EGLNativeWindowType nativeWindowType = _surface->Native();
+        _warmupContext = eglCreateContext(_eglDisplay, eglConfig, _eglContext, defaultContextAttribs);
+
+        if (_warmupContext != EGL_NO_CONTEXT) {
+            const char* extensions(eglQueryString(_eglDisplay, EGL_EXTENSIONS));
 
-        _eglSurface = eglCreateWindowSurface(_eglDisplay, eglConfig, nativeWindowType, nullptr);
+            if ((extensions == nullptr) || (strstr(extensions, "EGL_KHR_surfaceless_context") == nullptr)) {
+                constexpr EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+
+                _warmupSurface = eglCreatePbufferSurface(_eglDisplay, eglConfig, pbufferAttribs);
+
+                if (_warmupSurface == EGL_NO_SURFACE) {
+                    eglDestroyContext(_eglDisplay, _warmupContext);
+                    _warmupContext = EGL_NO_CONTEXT;
+                }
+            }
+        }
+
+        TRACE(Trace::Information, ("Warm-up context %s", (_warmupContext != EGL_NO_CONTEXT) ? ((_warmupSurface != EGL_NO_SURFACE) ? "available (pbuffer)" : "available (surfaceless)") : "not available"));
+
+        if (_headless == true) {
+            const EGLint pbufferAttribs[] = { EGL_WIDTH, static_cast<EGLint>(_width), EGL_HEIGHT, static_cast<EGLint>(_height), EGL_NONE };
+
+            _eglSurface = eglCreatePbufferSurface(_eglDisplay, eglConfig, pbufferAttribs);
+        } else {
+            EGLNativeWindowType nativeWindowType = _surface->Native();
+
+            _eglSurface = eglCreateWindowSurface(_eglDisplay, eglConfig, nativeWindowType, nullptr);
+        }
 
         if (!_eglSurface) {
-            TRACE(Trace::Error, ("Unable to create a EGL window surface error=%s", EGL::ErrorString(eglGetError())));
+            TRACE(Trace::Error, ("Unable to create a EGL %s surface error=%s", (_headless == true) ? "pbuffer" : "window", EGL::ErrorString(eglGetError())));
         }
 
         // ASSERT(_eglSurface != EGL_NO_SURFACE);
@@ -183,13 +515,34 @@ namespace Graphics {
 
         TRACE(Trace::Information, ("EGL surface dimension: %dx%d", width, height));
 
+        if (_eglSurface != EGL_NO_SURFACE) {
+            _damage.Initialize(_eglDisplay, _eglSurface, width, height, _partialPresent);
+        }
+
         if (eglMakeCurrent(_eglDisplay, _eglSurface, _eglSurface, _eglContext) == EGL_FALSE) {
             TRACE(Trace::Error, ("Unable to make EGL context current error=%s", EGL::ErrorString(eglGetError())));
         } else {
             TRACE(Trace::Information, ("EGL Ready: %s %s", EGL::EGLInfo(_eglDisplay).c_str(), EGL::OpenGLInfo().c_str()));
+
+            const char* renderer(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+
+            _renderer = (renderer != nullptr) ? renderer : "";
+
+            // Without GPU timers the frame cost is estimated from the CPU and swap time.
+            const bool timer(_gpuTimer.Initialize());
+
+            TRACE(Trace::Information, ("GPU timer queries %s", (timer == true) ? ((_gpuTimer.HasSections() == true) ? "available, per model" : "available, per frame") : "not available"));
+
+            _readback.Initialize(_eglDisplay, eglConfig, _eglContext);
+
             eglMakeCurrent(_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
         }
 
+        // Offscreen, before the render thread runs: a window has one format.
+        if ((_compareFormats == true) && (_eglSurface != EGL_NO_SURFACE)) {
+            _framebuffer.Compare(_eglDisplay, static_cast<uint16_t>(width), static_cast<uint16_t>(height));
+        }
+
         return (_eglSurface != EGL_NO_SURFACE);
     }
 
@@ -200,6 +553,18 @@ namespace Graphics {
                 TRACE(Trace::Error, ("EGL make current failed error=%s", EGL::ErrorString(eglGetError())));
             }
 
+            if (_warmupSurface != EGL_NO_SURFACE) {
+                eglDestroySurface(_eglDisplay, _warmupSurface);
+                _warmupSurface = EGL_NO_SURFACE;
+            }
+
+            if (_warmupContext != EGL_NO_CONTEXT) {
+                eglDestroyContext(_eglDisplay, _warmupContext);
+                _warmupContext = EGL_NO_CONTEXT;
+            }
+
+            _damage.Deinitialize();
+
             if (eglDestroySurface(_eglDisplay, _eglSurface) == EGL_TRUE) {
                 _eglSurface = EGL_NO_SURFACE;
             } else {
@@ -226,137 +591,578 @@ namespace Graphics {
         return ((_eglDisplay == EGL_NO_DISPLAY) && (_eglSurface == EGL_NO_SURFACE) && (_eglContext == EGL_NO_CONTEXT));
     }
 
-    void EGLRender::LockContext()
+    void EGLRender::Prepare()
     {
-        _adminLock.Lock();
+        if ((_warmupContext != EGL_NO_CONTEXT) && (_active == false)) {
+            Core::SafeSyncType<Core::CriticalSection> scopedLock(_warmupLock);
+
+            // One in progress already picks up the models.
+            if (_warming == false) {
+                TRACE(Trace::Information, ("Prepare Render"));
+                _warming = true;
+                _precompiler.Run();
+            }
+        }
+    }
 
-        EGLBoolean result = eglMakeCurrent(_eglDisplay, _eglSurface, _eglSurface, _eglContext);
+    void EGLRender::Precompile()
+    {
+        if (eglMakeCurrent(_eglDisplay, _warmupSurface, _warmupSurface, _warmupContext) == EGL_TRUE) {
+            const uint64_t start(Monotonic());
 
-        if (result == EGL_FALSE) {
-            TRACE(Trace::Error, ("Unable to make EGL context current error=%s", EGL::ErrorString(eglGetError())));
+            std::vector<Core::ProxyType<IModel>> models;
+
+            _adminLock.Lock();
+
+            for (auto model : _models) {
+                models.push_back(model.second);
+            }
+
+            _adminLock.Unlock();
+
+            uint16_t prepared(0);
+
+            for (auto& model : models) {
+                if (model->IsValid() == false) {
+                    model->Prepare();
+                    ++prepared;
+                }
+            }
+
+            // Wait for the driver, so Construct() finds linked programs.
+            ProgramCache::Instance().Complete();
+
+            TRACE(Trace::Information, ("Prepared %d model%s in %dms", prepared, (prepared != 1) ? "s" : "", static_cast<uint32_t>((Monotonic() - start) / 1000)));
+
+            // Off the render thread, so a shown render keeps drawing meanwhile.
+            while (Calibrate() == true) {
+            }
+
+            eglMakeCurrent(_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        } else {
+            TRACE(Trace::Error, ("Unable to make warm-up context current error=%s", EGL::ErrorString(eglGetError())));
+
+            // Would not get measured on this thread either.
+            _warmupLock.Lock();
+            _measurements.clear();
+            _warmupLock.Unlock();
         }
+    }
 
-        ASSERT(result != GL_FALSE);
+    // Warm-up thread, after _warming is cleared: a Show() that still found it
+    // set left the layers to this command.
+    void EGLRender::Warmed()
+    {
+        Submit([this]() {
+            if (_active == true) {
+                Construct();
+            }
+        });
     }
 
-    void EGLRender::UnlockContext()
+    std::future<void> EGLRender::Submit(CommandQueue::Command&& command)
     {
-        EGLBoolean result = eglMakeCurrent(_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        std::future<void> result(_commands.Post(std::move(command)));
 
-        _adminLock.Unlock();
+        Run();
 
-        if (result == EGL_FALSE) {
-            TRACE(Trace::Error, ("Unable to make EGL context current error=%s", EGL::ErrorString(eglGetError())));
+        return (result);
+    }
+
+    void EGLRender::Show()
+    {
+        const uint64_t posted(Monotonic());
+
+        Submit([this, posted]() {
+            if (Activate() == true) {
+                _showLatency.Observe(static_cast<uint32_t>(Monotonic() - posted));
+            }
+        });
+    }
+
+    void EGLRender::Hide()
+    {
+        const uint64_t posted(Monotonic());
+
+        Submit([this, posted]() {
+            if (Deactivate() == true) {
+                _hideLatency.Observe(static_cast<uint32_t>(Monotonic() - posted));
+            }
+        });
+    }
+
+    void EGLRender::Pause()
+    {
+        std::future<void> done(Submit([this]() {
+            if ((_active == true) && (_suspend == false)) {
+                _suspend = true;
+                TRACE(Trace::Information, ("Paused Render"));
+            }
+        }));
+
+        // Commands run between frames, once it ran no frame is being rendered.
+        if (done.wait_for(std::chrono::milliseconds(1000)) != std::future_status::ready) {
+            TRACE(Trace::Error, ("Render did not pause within 1000ms"));
         }
+    }
 
-        ASSERT(result != GL_FALSE);
+    void EGLRender::Resume()
+    {
+        Submit([this]() {
+            if (_active == true) {
+                _suspend = false;
+                _clock.Reset();
+                _lastFrame = 0;
+                TRACE(Trace::Information, ("Resumed Render"));
+            }
+        });
     }
 
-    void EGLRender::Show()
+    bool EGLRender::Activate()
     {
-        if ((_eglDisplay != EGL_NO_DISPLAY) && (_active == false)) {
+        bool result(false);
+
+        if ((_current == true) && (_active == false)) {
             TRACE(Trace::Information, ("Show Render"));
 
-            Block();
+            // A warm-up still in progress is closer to done than starting over,
+            // it constructs the layers once it is. Until then they are not drawn.
+            _warmupLock.Lock();
+            const bool warming(_warming);
+            _warmupLock.Unlock();
 
-            LockContext();
+            if (warming == false) {
+                Construct();
+            }
 
-            for (auto model : _models) {
-                if (model.second->IsValid() == false) {
-                    model.second->Construct();
+            for (const Layer& layer : _layers) {
+                if (_resolution.IsEnabled() == true) {
+                    layer.Model->Scale(_resolution.Scale());
                 }
             }
 
+            _resolution.Reset();
+
             glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT);
             Present();
 
             _active = true;
+            _suspend = false;
+            _clock.Reset();
+            _lastFrame = 0;
 
-            UnlockContext();
-
-            Resume();
+            result = true;
         }
+
+        return (result);
     }
 
-    void EGLRender::Hide()
+    bool EGLRender::Deactivate()
     {
-        if ((_eglDisplay != EGL_NO_DISPLAY) && (_active == true)) {
-            Pause();
-
-            LockContext();
+        bool result(false);
 
+        if ((_current == true) && (_active == true)) {
             glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
             glClear(GL_COLOR_BUFFER_BIT);
             Present();
 
-            for (auto model : _models) {
-                if (model.second->IsValid() == true) {
-                    model.second->Destroy();
-                }
+            const uint64_t now(Monotonic());
+
+            for (Layer& layer : _layers) {
+                layer.Used = now;
             }
 
             _active = false;
 
-            UnlockContext();
+            // Not drawn again before a later Show, the requester gives up on it.
+            _capture = nullptr;
+
+            // Keep the models constructed, so the next Show is a single frame.
+            Evict();
+
+            _presentQueue.Reset();
 
-            TRACE(Trace::Information, ("Hide Render render blocked=%s", IsBlocked() ? "yes" : "no"));
+            // Calibrations that waited for the render to be hidden.
+            Calibrations();
+
+            TRACE(Trace::Information, ("Hide Render"));
+
+            result = true;
         }
+
+        return (result);
     }
 
-    void EGLRender::Pause()
+    // Render thread only, with the context current.
+    void EGLRender::Construct()
     {
-        Core::SafeSyncType<Core::CriticalSection> scopedLock(_adminLock);
-
-        if ((_active == true) && (_suspend == false)) {
-            _suspend = true;
-            Wait(Core::Thread::BLOCKED, 1000);
-            TRACE(Trace::Information, ("Paused Render"));
+        if (_current == true) {
+            for (const Layer& layer : _layers) {
+                if (layer.Model->IsValid() == false) {
+                    layer.Model->Construct();
+                }
+            }
         }
     }
 
-    void EGLRender::Resume()
+    void EGLRender::Release()
     {
-        Core::SafeSyncType<Core::CriticalSection> scopedLock(_adminLock);
+        _active = false;
 
-        if (_active == true) {
-            _suspend = false;
-            Run();
-            TRACE(Trace::Information, ("Resumed Render"));
+        if (_current == true) {
+            for (const Layer& layer : _layers) {
+                layer.Model->Destroy();
+            }
+
+            ProgramCache::Instance().Release();
+
+            _gpuTimer.Deinitialize();
+            _readback.Deinitialize();
+
+            if (eglMakeCurrent(_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT) == EGL_FALSE) {
+                TRACE(Trace::Error, ("Unable to release EGL context error=%s", EGL::ErrorString(eglGetError())));
+            }
+
+            _current = false;
         }
+
+        // Not to be taken again, the thread is about to be stopped.
+        _released = true;
     }
 
-    void EGLRender::Present()
+    uint32_t EGLRender::Present()
     {
-        if (eglSwapBuffers(_eglDisplay, _eglSurface) == GL_TRUE) {
+        const uint64_t start(Monotonic());
+
+        const EGLBoolean swapped(_damage.Swap());
+
+        const uint32_t duration(static_cast<uint32_t>(Monotonic() - start));
+
+        if (swapped == EGL_TRUE) {
             ++_framesRendered;
             _surface->RequestRender();
 
-            WaitForVSync(Core::infinite);
+            if (_presentQueue.Submit() == false) {
+                TRACE(Trace::Error, ("Frame %d not published within timeout", _framesRendered));
+            }
         } else {
             TRACE(Trace::Error, ("eglSwapBuffers failed error=%s", EGL::ErrorString(eglGetError())));
         }
+
+        return (duration);
+    }
+
+    // Destroys the least recently used models of a hidden renderer while
+    // over budget or idle for too long. Needs the context, returns the time
+    // in ms until the next model expires.
+    uint32_t EGLRender::Evict()
+    {
+        uint32_t result(Core::infinite);
+
+        if (_active == false) {
+            const uint64_t now(Monotonic());
+
+            std::vector<Layer*> resident;
+            uint64_t footprint(0);
+
+            for (Layer& layer : _layers) {
+                if (layer.Model->IsValid() == true) {
+                    footprint += layer.Model->Footprint();
+                    resident.push_back(&layer);
+                }
+            }
+
+            std::stable_sort(resident.begin(), resident.end(),
+                [](const Layer* a, const Layer* b) { return (a->Used < b->Used); });
+
+            for (Layer* layer : resident) {
+                const uint64_t idle(now - layer->Used);
+                const uint32_t size(layer->Model->Footprint());
+
+                if ((footprint > _residencyBudget) || ((_residencyIdle != 0) && (idle >= _residencyIdle))) {
+                    layer->Model->Destroy();
+                    footprint -= size;
+
+                    TRACE(Trace::Information, ("Evicted model %d, %dKiB, idle %llus, %lluKiB resident", layer->Id, size / 1024, static_cast<unsigned long long>(idle / 1000000), static_cast<unsigned long long>(footprint / 1024)));
+                } else if (_residencyIdle != 0) {
+                    result = std::min(result, static_cast<uint32_t>(((_residencyIdle - idle) + 999) / 1000));
+                }
+            }
+        }
+
+        return (result);
+    }
+
+    void EGLRender::Measure(const uint32_t cpu, const uint32_t swap)
+    {
+        bool changed(false);
+
+        if (_gpuTimer.IsValid() == true) {
+            uint64_t elapsed(0);
+
+            // GPU results arrive a few frames late, take all that are ready.
+            while (_gpuTimer.Result(elapsed, _sections) == true) {
+                _gpuTime.Observe(static_cast<uint32_t>(elapsed / 1000));
+                Account(_sections);
+
+                if (_resolution.IsEnabled() == true) {
+                    changed = _resolution.Update(std::max(cpu, static_cast<uint32_t>(elapsed / 1000))) || changed;
+                }
+            }
+        } else if (_resolution.IsEnabled() == true) {
+            changed = _resolution.Update(cpu + swap);
+        }
+
+        if (changed == true) {
+            for (const Layer& layer : _layers) {
+                layer.Model->Scale(_resolution.Scale());
+            }
+
+            _dirty = true;
+        }
+    }
+
+    uint16_t EGLRender::Changed(const uint64_t now, Damage::Region& area) const
+    {
+        uint16_t result(0);
+
+        for (const Layer& layer : _layers) {
+            if ((layer.Occluded == false) && (layer.Model->IsValid() == true)) {
+                const uint16_t rate(layer.Model->Rate());
+
+                // Within half a frame period of being due is due.
+                if ((rate != 0) && ((rate >= _fps) || (((now - layer.Drawn) + (500000 / _fps)) >= (1000000 / rate)))) {
+                    area.Add(layer.Bounds());
+                }
+
+                result = std::max(result, rate);
+            }
+        }
+
+        return (result);
+    }
+
+    Damage::Region EGLRender::Repaint(Damage::Region& damage) const
+    {
+        Damage::Region result(_damage.Repaint(damage));
+
+        // Animated layers are redrawn whole, a part drawn at a later time
+        // would show a seam. That also changes them on screen.
+        bool grown(true);
+
+        while (grown == true) {
+            grown = false;
+
+            for (const Layer& layer : _layers) {
+                if ((layer.Occluded == false) && (layer.Model->IsValid() == true) && (layer.Model->Rate() != 0)) {
+                    const Damage::Rectangle bounds(layer.Bounds().Intersection(_damage.Full()));
+
+                    if (result.Overlaps(bounds) == true) {
+                        damage.Add(bounds);
+
+                        if (result.Contains(bounds) == false) {
+                            result.Add(bounds);
+                            grown = true;
+                        }
+                    }
+                }
+            }
+        }
+
+        return (result);
+    }
+
+    void EGLRender::Account(const GpuTimer::Sections& sections)
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_statsLock);
+
+        for (const std::pair<uint32_t, uint64_t>& section : sections) {
+            const int64_t time(static_cast<int64_t>(section.second / 1000));
+            std::map<uint32_t, uint32_t>::iterator index(_gpuTimes.find(section.first));
+
+            // Results arrive frames late, also for a model removed meanwhile.
+            const bool removed(std::none_of(_layers.begin(), _layers.end(),
+                [&section](const Layer& layer) { return (layer.Id == section.first); }));
+
+            if (removed == false) {
+                if (index == _gpuTimes.end()) {
+                    _gpuTimes.emplace(section.first, static_cast<uint32_t>(time));
+                } else {
+                    // Moving average over roughly the last 8 frames.
+                    index->second = static_cast<uint32_t>(index->second + ((time - static_cast<int64_t>(index->second)) / 8));
+                }
+            }
+        }
     }
 
     uint32_t EGLRender::Worker()
     {
-        LockContext();
+        if ((_current == false) && (_released == false) && (_eglSurface != EGL_NO_SURFACE)) {
+            // Taken once, it stays current on this thread until Release().
+            if (eglMakeCurrent(_eglDisplay, _eglSurface, _eglSurface, _eglContext) == EGL_TRUE) {
+                _current = true;
+            } else {
+                TRACE(Trace::Error, ("Unable to make EGL context current error=%s", EGL::ErrorString(eglGetError())));
+            }
+        }
 
-        if ((_suspend == false) && (_eglDisplay != EGL_NO_DISPLAY) && (_eglSurface != EGL_NO_SURFACE)) {
-            for (auto model : _models) {
-                if (model.second->IsValid() == true) {
-                    model.second->Process();
+        if (_commands.Process() != 0) {
+            // Any of them may have changed what is on screen.
+            _dirty = true;
+        }
+
+        if (_released == true) {
+            Block();
+            return (Core::infinite);
+        }
+
+        const bool rendering((_active == true) && (_suspend == false));
+
+        if ((_loopMode == RenderConfig::COMPOSITOR) && (rendering == true)) {
+            const uint32_t remaining(_clock.Remaining());
+
+            if (remaining > 0) {
+                // Published before the next deadline (fps below the refresh rate), skip this one.
+                _published = false;
+                Block();
+                return (remaining);
+            }
+        }
+
+        const uint64_t frame(Monotonic());
+
+        Damage::Region damage;
+        bool draw((rendering == true) && (_current == true));
+
+        if ((draw == true) && (_dirty == true)) {
+            damage.Add(_damage.Full());
+        } else if (draw == true) {
+            // Unchanged since the last frame: static content is not drawn
+            // again, slower content once its next frame is due.
+            const uint16_t rate(Changed(frame, damage));
+
+            if (damage.IsEmpty() == true) {
+                draw = false;
+
+                if ((rate == 0) && (_still == false)) {
+                    _still = true;
+                    TRACE(Trace::Information, ("Static content, stopped presenting"));
+                }
+            }
+        }
+
+        if ((draw == true) && (_still == true)) {
+            // Nothing to catch up on or to count as missed.
+            _still = false;
+            _clock.Reset();
+            _lastFrame = 0;
+            TRACE(Trace::Information, ("Content changed, presenting again"));
+        }
+
+        // Bounded, so commands posted meanwhile wait at most the present timeout.
+        if ((draw == true) && (_presentQueue.Acquire() == false)) {
+            TRACE(Trace::Error, ("Present queue full, gave up on a frame in flight"));
+        }
+
+        if (draw == true) {
+            const Damage::Region repaint(Repaint(damage));
+
+            _damage.Begin(repaint, damage);
+
+            // Each model only touches its own rectangle, within what is repainted.
+            glEnable(GL_SCISSOR_TEST);
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+            for (uint8_t index = 0; index < repaint.Count(); ++index) {
+                glScissor(repaint[index].X, repaint[index].Y, repaint[index].Width, repaint[index].Height);
+                glClear(GL_COLOR_BUFFER_BIT);
+            }
+
+            const uint64_t start(Monotonic());
+
+            _gpuTimer.Begin();
+
+            for (Layer& layer : _layers) {
+                if ((layer.Occluded == false) && (layer.Model->IsValid() == true)) {
+                    const Damage::Region area(repaint.Intersection(layer.Bounds()));
+
+                    if (area.IsEmpty() == false) {
+                        ScissorType boxes[Damage::Region::MaxRectangles];
+
+                        for (uint8_t index = 0; index < area.Count(); ++index) {
+                            boxes[index] = { area[index].X, area[index].Y, area[index].Width, area[index].Height };
+                        }
+
+                        // Rendered once, drawn into every rectangle.
+                        layer.Model->Process(area.Count(), boxes);
+
+                        layer.Drawn = frame;
+                        _gpuTimer.Mark(layer.Id);
+                    }
                 }
             }
 
-            Present();
+            glDisable(GL_SCISSOR_TEST);
+
+            _gpuTimer.End();
+
+            if (_capture != nullptr) {
+                // Queued behind the frame, the render thread does not wait for it.
+                if (_readback.Read(0, 0, _width, _height, _captureTag, *_capture) == false) {
+                    TRACE(Trace::Error, ("Readback of frame %d dropped, all buffers in flight", _framesRendered + 1));
+                }
+
+                _capture = nullptr;
+            }
+
+            if ((_recorder != nullptr) && (((_framesRendered + 1) % _recordInterval) == 0)) {
+                if (_readback.Read(0, 0, _width, _height, _framesRendered + 1, *_recorder) == false) {
+                    ++_recordDropped;
+                }
+            }
+
+            const uint32_t cpu(static_cast<uint32_t>(Monotonic() - start));
+            const uint32_t swap(Present());
+
+            const uint32_t interval((_lastFrame != 0) ? static_cast<uint32_t>(frame - _lastFrame) : 0);
+            const uint32_t wait(static_cast<uint32_t>(start - frame));
+
+            _history.Record(frame, interval, cpu, swap, wait);
+            _lastFrame = frame;
+            _dirty = false;
+
+            if (interval != 0) {
+                _frameTime.Observe(interval);
+            }
+            _presentWait.Observe(wait);
+
+            Measure(cpu, swap);
         }
 
+        const uint32_t expire((_current == true) ? Evict() : Core::infinite);
+
         Block();
 
-        UnlockContext();
+        uint32_t delay(expire);
+
+        if (_commands.IsEmpty() == false) {
+            // Posted after the drain above, its Run() may have been undone by the Block().
+            Run();
+            delay = 0;
+        } else if ((_still == true) && (rendering == true)) {
+            // Only a command (Show, Add, a screenshot...) changes the content.
+        } else if ((_fps != 0) && (rendering == true)) {
+            delay = _clock.Next();
+
+            if ((_loopMode == RenderConfig::COMPOSITOR) && (draw == true)) {
+                // The next Published() schedules the next frame, the timeout is only a
+                // watchdog. A publish that raced the Block() above is not lost.
+                delay = (_published.exchange(false) == true) ? 0 : _presentTimeout;
+            }
+        }
 
-        return ((_fps == 0) || (_suspend == true)) ? Core::infinite : (1000 / _fps);
+        return (delay);
     }
 
     void EGLRender::Rendered(Compositor::IDisplay::ISurface* surface VARIABLE_IS_NOT_USED)
@@ -365,7 +1171,13 @@ namespace Graphics {
 
     void EGLRender::Published(Compositor::IDisplay::ISurface* surface VARIABLE_IS_NOT_USED)
     {
-        _vsync.notify_all();
+        _clock.VSync();
+        _presentQueue.Published();
+
+        if ((_loopMode == RenderConfig::COMPOSITOR) && (_active == true) && (_suspend == false)) {
+            _published = true;
+            Run();
+        }
     }
 
 } // namespace Graphics
@@ -2,7 +2,18 @@
 
 #include "Module.h"
 
+#include "Calibration.h"
+#include "CommandQueue.h"
+#include "Damage.h"
+#include "DynamicResolution.h"
+#include "FrameClock.h"
+#include "FrameHistory.h"
+#include "FramebufferFormat.h"
+#include "GpuTimer.h"
+#include "Histogram.h"
 #include "IModel.h"
+#include "PresentQueue.h"
+#include "Readback.h"
 #include "Tracing.h"
 
 #ifndef GL_ES_VERSION_2_0
@@ -12,11 +23,100 @@
 
 #include <compositor/Client.h>
 
-#include <condition_variable>
-#include <mutex>
+#include <atomic>
+#include <map>
+#include <vector>
 
 namespace Thunder {
 namespace Graphics {
+    class EXTERNAL RenderConfig : public Core::JSON::Container {
+    public:
+        enum loop : uint8_t {
+            TIMER, // frames are paced by the frame clock
+            COMPOSITOR // every Published() schedules the next frame
+        };
+
+        enum backend : uint8_t {
+            WINDOW, // window surface of the compositor
+            HEADLESS // pbuffer, with a simulated display firing Published()
+        };
+
+    public:
+        RenderConfig(const RenderConfig&) = delete;
+        RenderConfig& operator=(const RenderConfig&) = delete;
+
+        RenderConfig()
+            : Core::JSON::Container()
+            , FramePolicy(FrameClock::SKIP)
+            , VSyncLock(true)
+            , PresentMode(PresentQueue::BLOCKING)
+            , QueueDepth(2)
+            , PresentTimeout(100)
+            , LoopMode(TIMER)
+            , DynamicResolution(false)
+            , MinScale(0.5)
+            , MaxScale(1.0)
+            , ProgramCache(true)
+            , Optimizer(false)
+            , Quality(2)
+            , Calibrate(true)
+            , ResidencyBudget(16384)
+            , ResidencyIdle(600)
+            , PartialPresent(true)
+            , PixelFormat(FramebufferFormat::RGBA8888)
+            , CompareFormats(false)
+            , Backend(WINDOW)
+            , RefreshRate(60)
+        {
+            Add(_T("framepolicy"), &FramePolicy);
+            Add(_T("vsynclock"), &VSyncLock);
+            Add(_T("presentmode"), &PresentMode);
+            Add(_T("queuedepth"), &QueueDepth);
+            Add(_T("presenttimeout"), &PresentTimeout);
+            Add(_T("loopmode"), &LoopMode);
+            Add(_T("dynamicresolution"), &DynamicResolution);
+            Add(_T("minscale"), &MinScale);
+            Add(_T("maxscale"), &MaxScale);
+            Add(_T("programcache"), &ProgramCache);
+            Add(_T("optimizer"), &Optimizer);
+            Add(_T("quality"), &Quality);
+            Add(_T("calibrate"), &Calibrate);
+            Add(_T("residencybudget"), &ResidencyBudget);
+            Add(_T("residencyidle"), &ResidencyIdle);
+            Add(_T("partialpresent"), &PartialPresent);
+            Add(_T("pixelformat"), &PixelFormat);
+            Add(_T("compareformats"), &CompareFormats);
+            Add(_T("backend"), &Backend);
+            Add(_T("refreshrate"), &RefreshRate);
+        }
+
+        ~RenderConfig()
+        {
+        }
+
+    public:
+        Core::JSON::EnumType<FrameClock::policy> FramePolicy;
+        Core::JSON::Boolean VSyncLock;
+        Core::JSON::EnumType<PresentQueue::mode> PresentMode;
+        Core::JSON::DecUInt8 QueueDepth;
+        Core::JSON::DecUInt16 PresentTimeout; // ms
+        Core::JSON::EnumType<loop> LoopMode;
+        Core::JSON::Boolean DynamicResolution;
+        Core::JSON::Float MinScale;
+        Core::JSON::Float MaxScale;
+        Core::JSON::Boolean ProgramCache;
+        Core::JSON::Boolean Optimizer; // source pass over the fragment shaders, see ShaderOptimizer
+        Core::JSON::DecUInt8 Quality; // shader tier of the device, for models that do not set one
+        Core::JSON::Boolean Calibrate; // measure quality and render scale per model once, see Calibration
+        Core::JSON::DecUInt32 ResidencyBudget; // KiB of models kept constructed while hidden
+        Core::JSON::DecUInt32 ResidencyIdle; // s, 0 keeps them until the budget is exceeded
+        Core::JSON::Boolean PartialPresent; // repaint and swap only what changed, see Damage
+        Core::JSON::EnumType<FramebufferFormat::format> PixelFormat; // wanted colour buffer, see FramebufferFormat
+        Core::JSON::Boolean CompareFormats; // measure the frame time of every format at start
+        Core::JSON::EnumType<backend> Backend;
+        Core::JSON::DecUInt16 RefreshRate; // Hz of the simulated display, headless only
+    };
+
     class EGLRender : public Core::Thread, public Compositor::IDisplay::ISurface::ICallback {
     public:
         struct EXTERNAL INotification {
@@ -28,9 +128,76 @@ namespace Graphics {
         bool InitEGL();
         bool DeinitEGL();
 
-        void Present();
-        void UnlockContext();
-        void LockContext();
+        uint32_t Present();
+        uint32_t Evict();
+        void Measure(const uint32_t cpu, const uint32_t swap);
+        void Account(const GpuTimer::Sections& sections);
+        void Precompile();
+        void Warmed();
+        // Starts the queued calibrations unless shown, see Calibrate().
+        void Calibrations();
+        // Needs a current context. Measures the next queued calibration, false
+        // if none is left or the render is shown.
+        bool Calibrate();
+
+        // Adds the visible layers due for a new frame to area, returns the
+        // highest IModel::Rate() of the visible layers.
+        uint16_t Changed(const uint64_t now, Damage::Region& area) const;
+        // What to draw for the damage, which grows by the animated layers drawn.
+        Damage::Region Repaint(Damage::Region& damage) const;
+
+        // Queues a command for the render thread and wakes it up.
+        std::future<void> Submit(CommandQueue::Command&& command);
+
+        // Render thread only, with the context current. True if it changed the state.
+        bool Activate();
+        bool Deactivate();
+        void Release();
+        void Construct();
+
+        // Builds the models on a context sharing objects with the render
+        // context, so Show() does not have to wait for the compiler.
+        class Precompiler : public Core::Thread {
+        public:
+            Precompiler() = delete;
+            Precompiler(const Precompiler&) = delete;
+            Precompiler& operator=(const Precompiler&) = delete;
+
+            Precompiler(EGLRender& parent)
+                : Core::Thread(Core::Thread::DefaultStackSize(), _T("ScreensaverWarmup"))
+                , _parent(parent)
+            {
+            }
+            ~Precompiler() override
+            {
+                Stop();
+                Wait(Core::Thread::STOPPED, Core::infinite);
+            }
+
+            uint32_t Worker() override
+            {
+                _parent.Precompile();
+
+                // Blocked before the flag is cleared, a Prepare() that finds it cleared can Run() it again.
+                // A calibration queued after the last one was taken is still measured.
+                _parent._warmupLock.Lock();
+                const bool done((_parent._measurements.empty() == true) || (_parent._active == true));
+                if (done == true) {
+                    Block();
+                    _parent._warming = false;
+                }
+                _parent._warmupLock.Unlock();
+
+                if (done == true) {
+                    _parent.Warmed();
+                }
+
+                return ((done == true) ? Core::infinite : 0);
+            }
+
+        private:
+            EGLRender& _parent;
+        };
 
     public:
         EGLRender(const EGLRender&) = delete;
@@ -40,17 +207,144 @@ namespace Graphics {
 
         virtual ~EGLRender();
 
-        bool Initialize(const string& name, const uint32_t width, const uint32_t height, const uint16_t fps);
+        bool Initialize(const string& name, const uint32_t width, const uint32_t height, const uint16_t fps, const RenderConfig& config);
         void Deinitialize();
 
         uint32_t Add(const ModelConfig config);
         void Remove(uint32_t id);
 
+        // Measures the config of model id while the render is not shown, on
+        // the warm-up context if there is one, without waiting for it. The
+        // model is rebuilt with the result once measured, it renders as it
+        // was added until then.
+        void Calibrate(Calibration& calibration, const uint32_t id, const ModelConfig& config, const uint32_t budget);
+
+        // The consumer gets the next rendered frame on the readback thread,
+        // numbered with tag instead of the frame so it can tell it apart from
+        // one of an earlier capture. False if nothing is being rendered.
+        bool Capture(Readback::IConsumer& consumer, const uint32_t tag);
+        // Drops a capture that did not get its frame yet, e.g. after a timeout.
+        void CancelCapture();
+
+        // The consumer gets every interval-th swapped frame until it is
+        // replaced, nullptr stops. Once returned no more reads are issued,
+        // those in flight are still delivered.
+        void Record(Readback::IConsumer* consumer, const uint16_t interval);
+
+        // GL_RENDERER, empty if the context could not be made current.
+        inline const string& Renderer() const
+        {
+            return _renderer;
+        }
+
         inline uint32_t FramesRendered() const
         {
             return _framesRendered;
         }
 
+        inline uint32_t FramesMissed() const
+        {
+            return _clock.Missed();
+        }
+
+        inline uint32_t PublishMissed() const
+        {
+            return _presentQueue.Missed();
+        }
+
+        inline uint32_t PublishLate() const
+        {
+            return _presentQueue.Late();
+        }
+
+        inline float RenderScale() const
+        {
+            return _resolution.Scale();
+        }
+
+        inline uint32_t Width() const
+        {
+            return _width;
+        }
+
+        inline uint32_t Height() const
+        {
+            return _height;
+        }
+
+        inline uint16_t FrameRate() const
+        {
+            return _fps;
+        }
+
+        inline const FrameHistory& History() const
+        {
+            return _history;
+        }
+
+        // Since the start, in us.
+        inline const Histogram& FrameTime() const
+        {
+            return _frameTime;
+        }
+
+        inline const Histogram& PresentWait() const
+        {
+            return _presentWait;
+        }
+
+        inline const Histogram& GpuTime() const
+        {
+            return _gpuTime;
+        }
+
+        // From the call until the first (or last) frame is swapped.
+        inline const Histogram& ShowLatency() const
+        {
+            return _showLatency;
+        }
+
+        inline const Histogram& HideLatency() const
+        {
+            return _hideLatency;
+        }
+
+        // Repainted share of the drawn frames.
+        inline double RepaintRatio() const
+        {
+            return _damage.Ratio();
+        }
+
+        // Format and config of the surface, with the measured frame times.
+        inline const FramebufferFormat& Framebuffer() const
+        {
+            return _framebuffer;
+        }
+
+        inline uint32_t ReadbackDropped() const
+        {
+            return _readback.Dropped();
+        }
+
+        // Recorded frames not read back, all readback buffers in flight.
+        inline uint32_t RecordDropped() const
+        {
+            return _recordDropped;
+        }
+
+        // Calls action(id, us) for the GPU time per model id, averaged over
+        // the last frames, under the lock so nothing is copied. Not called
+        // without GL_EXT_disjoint_timer_query timestamps.
+        template <typename ACTION>
+        void GpuTimes(ACTION&& action) const
+        {
+            Core::SafeSyncType<Core::CriticalSection> scopedLock(_statsLock);
+
+            for (const std::pair<const uint32_t, uint32_t>& time : _gpuTimes) {
+                action(time.first, time.second);
+            }
+        }
+
         // ICallback methods
         void Rendered(Compositor::IDisplay::ISurface* surface) override;
         void Published(Compositor::IDisplay::ISurface* surface) override;
@@ -58,31 +352,73 @@ namespace Graphics {
         // IThread methods
         uint32_t Worker() override;
 
+        void Prepare();
         void Show();
         void Hide();
         void Pause();
         void Resume();
 
+        // Written by the render thread only.
         bool IsActive() const
         {
             return _active;
         }
 
     private:
-        void WaitForVSync(uint32_t timeoutMs)
-        {
-            std::unique_lock<std::mutex> lock(_rendering);
+        struct Layer {
+            Layer(const uint32_t id, const Core::ProxyType<IModel>& model, const int32_t x, const int32_t y, const uint16_t z, const uint16_t width, const uint16_t height)
+                : Id(id)
+                , Model(model)
+                , X(x)
+                , Y(y)
+                , Z(z)
+                , Width(width)
+                , Height(height)
+                , Occluded(false)
+                , Used(0)
+                , Drawn(0)
+            {
+            }
 
-            if (timeoutMs == Core::infinite) {
-                _vsync.wait(lock);
-            } else {
-                _vsync.wait_for(lock, std::chrono::milliseconds(timeoutMs));
+            Damage::Rectangle Bounds() const
+            {
+                return (Damage::Rectangle(X, Y, Width, Height));
             }
-        }
+
+            bool Covers(const Layer& other) const
+            {
+                return ((X <= other.X) && (Y <= other.Y) && ((X + Width) >= (other.X + other.Width)) && ((Y + Height) >= (other.Y + other.Height)));
+            }
+
+            uint32_t Id;
+            Core::ProxyType<IModel> Model;
+            int32_t X; // window coordinates, origin bottom-left
+            int32_t Y;
+            uint16_t Z;
+            uint16_t Width;
+            uint16_t Height;
+            bool Occluded;
+            uint64_t Used; // us, last time it was hidden
+            uint64_t Drawn; // us, start of the last frame it was drawn in
+        };
+
+        void Arrange();
+
+        // Render thread only. Builds model id anew from config, in place of the current one.
+        void Replace(const uint32_t id, const ModelConfig& config);
+
+        struct Measurement {
+            Calibration* Results;
+            uint32_t Id;
+            ModelConfig Config;
+            uint32_t Budget;
+        };
 
         typedef std::map<uint32_t, Core::ProxyType<IModel>> ModelMap;
+        typedef std::vector<Layer> LayerList;
 
-        mutable Core::CriticalSection _adminLock;
+        mutable Core::CriticalSection _adminLock; // _models, shared with the warm-up thread
+        CommandQueue _commands;
 
         Compositor::IDisplay* _display;
         Compositor::IDisplay::ISurface* _surface;
@@ -91,17 +427,61 @@ namespace Graphics {
         EGLContext _eglContext;
         EGLDisplay _eglDisplay;
 
+        EGLContext _warmupContext;
+        EGLSurface _warmupSurface; // EGL_NO_SURFACE if surfaceless contexts are supported
+        Core::CriticalSection _warmupLock; // _warming, _measurements and the state of the warm-up thread
+        bool _warming; // a warm-up is running, it constructs the layers Show() left when done
+        std::vector<Measurement> _measurements; // calibrations not measured yet
+        Precompiler _precompiler;
+
+        string _renderer;
+        uint32_t _width;
+        uint32_t _height;
         uint16_t _fps;
         uint32_t _framesRendered;
 
-        ModelMap _models;
+        RenderConfig::loop _loopMode;
+        uint32_t _presentTimeout;
+        std::atomic<bool> _published;
+        bool _headless;
+        bool _partialPresent;
+        FramebufferFormat::format _pixelFormat;
+        bool _compareFormats;
+        uint64_t _residencyBudget; // bytes
+        uint64_t _residencyIdle; // us
 
-        bool _suspend;
-        bool _active;
+        FrameClock _clock;
+        PresentQueue _presentQueue;
+        GpuTimer _gpuTimer;
+        GpuTimer::Sections _sections;
+        Damage _damage;
+        FramebufferFormat _framebuffer;
+        Readback _readback;
+        Readback::IConsumer* _capture; // render thread, read before the next swap
+        uint32_t _captureTag; // render thread
+        Readback::IConsumer* _recorder; // render thread
+        uint16_t _recordInterval;
+        std::atomic<uint32_t> _recordDropped;
+        mutable Core::CriticalSection _statsLock;
+        std::map<uint32_t, uint32_t> _gpuTimes; // model id, us
+        DynamicResolution _resolution;
+        FrameHistory _history;
+        Histogram _frameTime;
+        Histogram _presentWait;
+        Histogram _gpuTime;
+        Histogram _showLatency;
+        Histogram _hideLatency;
+        uint64_t _lastFrame; // us, start of the previous frame, 0 after a (re)start
+        bool _dirty; // render thread, a command ran since the last drawn frame
+        bool _still; // render thread, static content on screen, nothing is swapped
 
-        std::condition_variable _vsync;
-        std::mutex _rendering;
+        ModelMap _models;
+        LayerList _layers; // in draw order, lowest z first
 
+        bool _current; // the render thread holds the context
+        bool _released;
+        std::atomic<bool> _suspend;
+        std::atomic<bool> _active;
     }; // class EGLRender
 
 } // namespace Graphics
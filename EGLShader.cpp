@@ -3,6 +3,10 @@
 #include "EGLToolbox.h"
 
 #include "IModel.h"
+#include "ProgramCache.h"
+#include "ShaderLibrary.h"
+#include "ShaderOptimizer.h"
+#include "ShaderPreprocessor.h"
 
 #include "Tracing.h"
 
@@ -16,6 +20,11 @@
 #include <GLES2/gl2ext.h>
 #include <esUtil.h>
 
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <vector>
+
 namespace Thunder {
 namespace Graphics {
     constexpr GLfloat vVertices[] = {
@@ -25,6 +34,429 @@ namespace Graphics {
         1.0f, 1.0f, 0.0f, //
     };
 
+    constexpr char blitVertexShaderSource[] = "#version 100                                 \n"
+                                              "attribute vec3 vPosition;                    \n"
+                                              "varying vec2 vTexCoord;                      \n"
+                                              "void main()                                  \n"
+                                              "{                                            \n"
+                                              "    vTexCoord = (vPosition.xy * 0.5) + 0.5;  \n"
+                                              "    gl_Position = vec4(vPosition, 1.0);      \n"
+                                              "}                                            \n";
+
+    constexpr char blitFragmentShaderSource[] = "#version 100                                 \n"
+                                                "precision mediump float;                     \n"
+                                                "uniform sampler2D u_texture;                 \n"
+                                                "varying vec2 vTexCoord;                      \n"
+                                                "void main()                                  \n"
+                                                "{                                            \n"
+                                                "    gl_FragColor = texture2D(u_texture, vTexCoord);\n"
+                                                "}                                            \n";
+
+    // The quad on vertex attribute 0, scissored to each box in turn.
+    static void Draw(const uint8_t count, const ScissorType boxes[])
+    {
+        if (count == 0) {
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+
+        for (uint8_t index = 0; index < count; ++index) {
+            glScissor(boxes[index].X, boxes[index].Y, boxes[index].Width, boxes[index].Height);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+    }
+
+    // Render target of a fraction of the model size, upscaled to the window
+    // with a single bilinear filtered blit.
+    class Offscreen {
+    public:
+        Offscreen(const Offscreen&) = delete;
+        Offscreen& operator=(const Offscreen&) = delete;
+
+        Offscreen()
+            : _program(GL_FALSE)
+            , _uTexture(-1)
+            , _framebuffer(0)
+            , _texture(0)
+            , _width(0)
+            , _height(0)
+            , _previous(0)
+            , _scissor(GL_FALSE)
+            , _programSize(0)
+        {
+        }
+
+        ~Offscreen()
+        {
+            Destroy();
+        }
+
+    public:
+        bool IsValid() const
+        {
+            return (_framebuffer != 0);
+        }
+
+        // Color buffer plus the blit program, in bytes.
+        uint32_t Footprint() const
+        {
+            return ((IsValid() == true) ? ((static_cast<uint32_t>(_width) * _height * 4) + _programSize) : 0);
+        }
+
+        static ProgramCache::Attributes BlitAttributes()
+        {
+            return { { 0, "vPosition" } };
+        }
+
+        uint16_t Width() const
+        {
+            return (_width);
+        }
+
+        uint16_t Height() const
+        {
+            return (_height);
+        }
+
+        bool Construct(const uint16_t width, const uint16_t height)
+        {
+            if (_program == GL_FALSE) {
+                _program = ProgramCache::Instance().Create(blitVertexShaderSource, blitFragmentShaderSource, BlitAttributes());
+
+                if (_program != GL_FALSE) {
+                    _uTexture = glGetUniformLocation(_program, "u_texture");
+                    _programSize = ProgramCache::Instance().Footprint(_program);
+                }
+            }
+
+            return ((_program != GL_FALSE) && (Resize(width, height) == true));
+        }
+
+        bool Resize(const uint16_t width, const uint16_t height)
+        {
+            if ((IsValid() == false) || (width != _width) || (height != _height)) {
+                if (_texture == 0) {
+                    glGenTextures(1, &_texture);
+                    glGenFramebuffers(1, &_framebuffer);
+                }
+
+                glBindTexture(GL_TEXTURE_2D, _texture);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glBindTexture(GL_TEXTURE_2D, 0);
+
+                GLint previous(0);
+                glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+
+                glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _texture, 0);
+
+                const GLenum status(glCheckFramebufferStatus(GL_FRAMEBUFFER));
+
+                glBindFramebuffer(GL_FRAMEBUFFER, previous);
+
+                if (status == GL_FRAMEBUFFER_COMPLETE) {
+                    _width = width;
+                    _height = height;
+                    TRACE(Trace::EGL, ("Offscreen target %dx%d", _width, _height));
+                } else {
+                    TRACE(Trace::Error, ("Offscreen target %dx%d incomplete: 0x%04X", width, height, status));
+                    Destroy();
+                }
+            }
+
+            return (IsValid());
+        }
+
+        void Destroy()
+        {
+            if (_framebuffer != 0) {
+                glDeleteFramebuffers(1, &_framebuffer);
+                _framebuffer = 0;
+            }
+
+            if (_texture != 0) {
+                glDeleteTextures(1, &_texture);
+                _texture = 0;
+            }
+
+            if (_program != GL_FALSE) {
+                EGL::DeleteProgram(_program);
+                _program = GL_FALSE;
+            }
+
+            _width = 0;
+            _height = 0;
+        }
+
+        // Redirect drawing into the texture.
+        void Bind()
+        {
+            glGetIntegerv(GL_FRAMEBUFFER_BINDING, &_previous);
+            _scissor = glIsEnabled(GL_SCISSOR_TEST);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+            glDisable(GL_SCISSOR_TEST);
+            glViewport(0, 0, _width, _height);
+        }
+
+        // Back to the previous target and upscale the texture into the viewport,
+        // once per box, expects the quad on vertex attribute 0.
+        void Blit(const uint16_t x, const uint16_t y, const uint16_t width, const uint16_t height, const uint8_t count, const ScissorType boxes[])
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, _previous);
+
+            if (_scissor == GL_TRUE) {
+                glEnable(GL_SCISSOR_TEST);
+            }
+
+            glViewport(x, y, width, height);
+
+            glUseProgram(_program);
+
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, _texture);
+            glUniform1i(_uTexture, 0);
+
+            Draw(count, boxes);
+
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+    private:
+        GLuint _program;
+        GLint _uTexture;
+        GLuint _framebuffer;
+        GLuint _texture;
+        uint16_t _width;
+        uint16_t _height;
+        GLint _previous;
+        GLboolean _scissor;
+        uint32_t _programSize;
+    }; // class Offscreen
+
+    // Noise and lookup tables shared by the shader models, so a shader can
+    // trade hashing or a color ramp for a single texture fetch. Built on the
+    // CPU and uploaded with the first model that samples one of them, deleted
+    // with the last one. Render thread only.
+    class LookupTables {
+    public:
+        enum table : uint8_t {
+            WHITE_NOISE, // u_noise0: 4 independent channels, nearest
+            VALUE_NOISE, // u_noise1: tileable, 8/16/32/64 cells in r/g/b/a, linear
+            HUE, // u_hue: fully saturated hue ramp in one row, linear
+            TABLES
+        };
+
+        // Unit 0 is taken by the offscreen blit.
+        static constexpr GLint FirstUnit = 1;
+
+    private:
+        friend Core::SingletonType<LookupTables>;
+
+        LookupTables()
+            : _textures()
+            , _users(0)
+        {
+        }
+
+        static constexpr uint16_t Size = 256;
+
+    public:
+        LookupTables(const LookupTables&) = delete;
+        LookupTables& operator=(const LookupTables&) = delete;
+        ~LookupTables() = default;
+
+        static LookupTables& Instance()
+        {
+            return (Core::SingletonType<LookupTables>::Instance());
+        }
+
+        static const char* Uniform(const table id)
+        {
+            static const char* const names[TABLES] = { "u_noise0", "u_noise1", "u_hue" };
+
+            return (names[id]);
+        }
+
+    public:
+        // Needs a current context.
+        bool Acquire()
+        {
+            if (_users == 0) {
+                Upload();
+            }
+
+            if (_textures[WHITE_NOISE] != 0) {
+                ++_users;
+            }
+
+            return (_textures[WHITE_NOISE] != 0);
+        }
+
+        void Release()
+        {
+            ASSERT(_users > 0);
+
+            if ((_users > 0) && (--_users == 0)) {
+                glDeleteTextures(TABLES, _textures);
+
+                for (GLuint& texture : _textures) {
+                    texture = 0;
+                }
+            }
+        }
+
+        // Leaves GL_TEXTURE0 active.
+        void Bind() const
+        {
+            for (uint8_t index = 0; index < TABLES; ++index) {
+                glActiveTexture(GL_TEXTURE0 + FirstUnit + index);
+                glBindTexture(GL_TEXTURE_2D, _textures[index]);
+            }
+
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+    private:
+        void Upload()
+        {
+            std::vector<uint8_t> pixels(Size * Size * 4);
+
+            glGenTextures(TABLES, _textures);
+
+            if (_textures[WHITE_NOISE] != 0) {
+                glActiveTexture(GL_TEXTURE0 + FirstUnit);
+
+                WhiteNoise(pixels);
+                Load(_textures[WHITE_NOISE], Size, GL_NEAREST, pixels);
+
+                ValueNoise(pixels);
+                Load(_textures[VALUE_NOISE], Size, GL_LINEAR, pixels);
+
+                HueRamp(pixels);
+                Load(_textures[HUE], 1, GL_LINEAR, pixels);
+
+                glBindTexture(GL_TEXTURE_2D, 0);
+                glActiveTexture(GL_TEXTURE0);
+
+                TRACE(Trace::EGL, ("Lookup tables uploaded, %dx%d noise", Size, Size));
+            } else {
+                TRACE(Trace::Error, ("Lookup tables not available"));
+            }
+        }
+
+        static void Load(const GLuint texture, const uint16_t height, const GLint filter, const std::vector<uint8_t>& pixels)
+        {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, Size, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        }
+
+        // lowbias32, so every device gets the same tables.
+        static uint32_t Hash(uint32_t value)
+        {
+            value ^= value >> 16;
+            value *= 0x7feb352dU;
+            value ^= value >> 15;
+            value *= 0x846ca68bU;
+            value ^= value >> 16;
+
+            return (value);
+        }
+
+        static void WhiteNoise(std::vector<uint8_t>& pixels)
+        {
+            for (uint32_t index = 0; index < pixels.size(); ++index) {
+                pixels[index] = static_cast<uint8_t>(Hash(index) >> 24);
+            }
+        }
+
+        // Random values on a lattice that wraps at the texture edge, smoothstep
+        // interpolated in between.
+        static void ValueNoise(std::vector<uint8_t>& pixels)
+        {
+            for (uint8_t channel = 0; channel < 4; ++channel) {
+                const uint16_t cells(8 << channel);
+                const uint16_t span(Size / cells);
+
+                for (uint16_t y = 0; y < Size; ++y) {
+                    const uint16_t y0(y / span);
+                    const uint16_t y1((y0 + 1) % cells);
+                    const float fy(Fade(static_cast<float>(y % span) / span));
+
+                    for (uint16_t x = 0; x < Size; ++x) {
+                        const uint16_t x0(x / span);
+                        const uint16_t x1((x0 + 1) % cells);
+                        const float fx(Fade(static_cast<float>(x % span) / span));
+
+                        const float bottom(Mix(Lattice(channel, x0, y0), Lattice(channel, x1, y0), fx));
+                        const float top(Mix(Lattice(channel, x0, y1), Lattice(channel, x1, y1), fx));
+
+                        pixels[(((y * Size) + x) * 4) + channel] = static_cast<uint8_t>(Mix(bottom, top, fy) + 0.5f);
+                    }
+                }
+            }
+        }
+
+        // Same ramp as the hue2rgb() of the bundled shaders.
+        static void HueRamp(std::vector<uint8_t>& pixels)
+        {
+            for (uint16_t index = 0; index < Size; ++index) {
+                const float hue((index * 6.0f) / Size);
+                const uint8_t x(static_cast<uint8_t>(((1.0f - std::fabs(std::fmod(hue, 2.0f) - 1.0f)) * 255.0f) + 0.5f));
+                uint8_t* pixel(&pixels[index * 4]);
+
+                switch (static_cast<uint8_t>(hue)) {
+                case 0:
+                    pixel[0] = 255, pixel[1] = x, pixel[2] = 0;
+                    break;
+                case 1:
+                    pixel[0] = x, pixel[1] = 255, pixel[2] = 0;
+                    break;
+                case 2:
+                    pixel[0] = 0, pixel[1] = 255, pixel[2] = x;
+                    break;
+                case 3:
+                    pixel[0] = 0, pixel[1] = x, pixel[2] = 255;
+                    break;
+                case 4:
+                    pixel[0] = x, pixel[1] = 0, pixel[2] = 255;
+                    break;
+                default:
+                    pixel[0] = 255, pixel[1] = 0, pixel[2] = x;
+                    break;
+                }
+
+                pixel[3] = 255;
+            }
+        }
+
+        static float Lattice(const uint8_t channel, const uint16_t x, const uint16_t y)
+        {
+            return (static_cast<float>(Hash(0x9e3779b9U ^ ((static_cast<uint32_t>(channel) << 16) | (y << 8) | x)) >> 24));
+        }
+
+        static float Fade(const float t)
+        {
+            return (t * t * (3.0f - (2.0f * t)));
+        }
+
+        static float Mix(const float a, const float b, const float t)
+        {
+            return (a + ((b - a) * t));
+        }
+
+    private:
+        GLuint _textures[TABLES];
+        uint32_t _users;
+    }; // class LookupTables
+
     class EGLShader : public IModel {
     public:
         EGLShader(const EGLShader&) = delete;
@@ -38,36 +470,67 @@ namespace Graphics {
         bool Construct() override
         {
             if (IsValid() == false) {
-                _program = EGL::CreateProgram(_vertexShaderSource, _fragmentShaderSource);
+                _program = ProgramCache::Instance().Create(_vertexShaderSource, _fragmentShaderSource, Attributes());
+
+                if ((_program == GL_FALSE) && (_originalSource.empty() == false)) {
+                    TRACE(Trace::Error, ("Optimized shader rejected, building the original"));
+
+                    ShaderOptimizer::Instance().Rejected();
 
-                if (glIsProgram(_program)) {
-                    glBindAttribLocation(_program, 0, "vPosition");
-                    glBindAttribLocation(_program, 1, "vOpacity");
+                    _fragmentShaderSource.swap(_originalSource);
+                    _originalSource.clear();
 
-                    if (EGL::LinkProgram(_program) == GL_TRUE) {
-                        glUseProgram(_program);
+                    _program = ProgramCache::Instance().Create(_vertexShaderSource, _fragmentShaderSource, Attributes());
+                }
+
+                if (_program != GL_FALSE) {
+                    _originalSource.clear();
 
-                        _uTime = glGetUniformLocation(_program, "u_time");
-                        _uResolution = glGetUniformLocation(_program, "u_resolution");
-                        _uOpacity = glGetUniformLocation(_program, "u_opacity");
+                    glUseProgram(_program);
 
-                        glUniform3f(_uResolution, _width, _height, 0);
-                        glUniform1f(_uOpacity, _opacity);
+                    _uTime = glGetUniformLocation(_program, "u_time");
+                    _uResolution = glGetUniformLocation(_program, "u_resolution");
+                    _uOpacity = glGetUniformLocation(_program, "u_opacity");
+                    _uOffset = glGetUniformLocation(_program, "u_offset");
 
-                        glGenBuffers(1, &_vbo);
-                        glBindBuffer(GL_ARRAY_BUFFER, _vbo);
-                        glBufferData(GL_ARRAY_BUFFER, sizeof(vVertices), 0, GL_STATIC_DRAW);
-                        glBufferSubData(GL_ARRAY_BUFFER, _inPosition, sizeof(vVertices), &vVertices[0]);
+                    _programSize = ProgramCache::Instance().Footprint(_program);
 
-                        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)(intptr_t)_inPosition);
-                        glEnableVertexAttribArray(0);
+                    GLint samplers[LookupTables::TABLES];
+                    bool sampled(false);
 
-                        TRACE(Trace::Information, (_T("Setup done.")));
-                    } else {
-                        TRACE(Trace::Error, ("Error linking program:\n%s", EGL::ProgramInfoLog(_program).c_str()));
-                        glDeleteProgram(_program);
-                        _program = GL_FALSE;
+                    for (uint8_t index = 0; index < LookupTables::TABLES; ++index) {
+                        samplers[index] = glGetUniformLocation(_program, LookupTables::Uniform(static_cast<LookupTables::table>(index)));
+                        sampled = sampled || (samplers[index] != -1);
                     }
+
+                    if (sampled == true) {
+                        _tables = LookupTables::Instance().Acquire();
+
+                        for (uint8_t index = 0; index < LookupTables::TABLES; ++index) {
+                            if (samplers[index] != -1) {
+                                glUniform1i(samplers[index], LookupTables::FirstUnit + index);
+                            }
+                        }
+                    }
+
+                    glUniform3f(_uResolution, _width, _height, 0);
+                    glUniform1f(_uOpacity, _opacity);
+
+                    glGenBuffers(1, &_vbo);
+                    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+                    glBufferData(GL_ARRAY_BUFFER, sizeof(vVertices), 0, GL_STATIC_DRAW);
+                    glBufferSubData(GL_ARRAY_BUFFER, _inPosition, sizeof(vVertices), &vVertices[0]);
+
+                    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)(intptr_t)_inPosition);
+                    glEnableVertexAttribArray(0);
+
+                    if ((_scale < 1.0f) && (_offscreen.Construct(Scaled(_width), Scaled(_height)) == false)) {
+                        TRACE(Trace::Error, ("Render scale %.2f not available, rendering at full size", _scale));
+                    }
+
+                    TRACE(Trace::Information, (_T("Setup done.")));
+                } else {
+                    TRACE(Trace::Error, ("Error creating program"));
                 }
             }
 
@@ -76,9 +539,30 @@ namespace Graphics {
             return (IsValid() == true);
         }
 
+        void Prepare() override
+        {
+            if (IsValid() == false) {
+                ProgramCache::Instance().Precompile(_vertexShaderSource, _fragmentShaderSource, Attributes());
+
+                if (_scale < 1.0f) {
+                    ProgramCache::Instance().Precompile(blitVertexShaderSource, blitFragmentShaderSource, Offscreen::BlitAttributes());
+                }
+            }
+        }
+
         bool Destroy() override
         {
             if (IsValid() == true) {
+                _offscreen.Destroy();
+
+                if (_tables == true) {
+                    LookupTables::Instance().Release();
+                    _tables = false;
+                }
+
+                glDeleteBuffers(1, &_vbo);
+                _vbo = 0;
+
                 EGL::DeleteProgram(_program);
                 _program = EGL_FALSE;
             }
@@ -86,33 +570,54 @@ namespace Graphics {
             return (IsValid() == false);
         }
 
-        void Process() override
+        void Process(const uint8_t count, const ScissorType boxes[]) override
         {
             if (IsValid() == true) {
 
                 // fprintf(stdout, "%s:%d [%s] frameNumber=%ld\n", __FILE__, __LINE__, __FUNCTION__, _frameNumber);fflush(stdout);
 
-                glViewport(0, 0, _width, _height);
-                glEnable(GL_CULL_FACE);
+                const bool offscreen(_offscreen.IsValid());
+
+                // The surface is cleared once per frame by the renderer, the
+                // boxes lie within this model's rectangle and do not overlap.
+                if (offscreen == true) {
+                    _offscreen.Bind();
+                } else {
+                    glViewport(_x, _y, _width, _height);
+                }
 
-                /* clear the color buffer */
-                glClearColor(0.5, 0.5, 0.5, 1.0);
-                glClear(GL_COLOR_BUFFER_BIT);
+                glEnable(GL_CULL_FACE);
 
                 glUseProgram(_program);
 
+                if (_tables == true) {
+                    LookupTables::Instance().Bind();
+                }
+
                 // float now = float(_frameNumber / 60.0f);
                 float now = (Core::Time::Now().Ticks() - _start) / float(Core::Time::TicksPerMillisecond) / float(Core::Time::MilliSecondsPerSecond);
 
                 glUniform1f(_uTime, now);
                 glUniform1f(_uOpacity, _opacity);
-                glUniform3f(_uResolution, _width, _height, 0);
+                if (offscreen == true) {
+                    glUniform3f(_uResolution, _offscreen.Width(), _offscreen.Height(), 0);
+                    glUniform2f(_uOffset, 0, 0);
+                } else {
+                    glUniform3f(_uResolution, _width, _height, 0);
+                    glUniform2f(_uOffset, _x, _y);
+                }
 
                 glBindBuffer(GL_ARRAY_BUFFER, _vbo);
                 glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)(intptr_t)_inPosition);
                 glEnableVertexAttribArray(0);
 
-                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                // Rendered once, only the upscale is repeated per box.
+                if (offscreen == true) {
+                    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                    _offscreen.Blit(_x, _y, _width, _height, count, boxes);
+                } else {
+                    Draw(count, boxes);
+                }
 
                 glDisableVertexAttribArray(0);
 
@@ -122,8 +627,10 @@ namespace Graphics {
             }
         }
 
-        void Position(const DimensionType& /*dimension*/) override
+        void Position(const DimensionType& dimension) override
         {
+            _x = dimension.X;
+            _y = dimension.Y;
         }
 
         void Size(const SizeType& surfaceSize) override
@@ -137,31 +644,121 @@ namespace Graphics {
             _opacity = opacity;
         }
 
+        void Scale(const float scale) override
+        {
+            _scale = std::min(std::max(_configured * scale, 0.1f), 1.0f);
+
+            if (IsValid() == true) {
+                if (_scale >= 1.0f) {
+                    _offscreen.Destroy();
+                } else if (_offscreen.Construct(Scaled(_width), Scaled(_height)) == false) {
+                    TRACE(Trace::Error, ("Render scale %.2f not available, rendering at full size", _scale));
+                }
+            }
+        }
+
         bool IsValid() const override
         {
             return (_program != GL_FALSE);
         }
 
+        uint32_t Footprint() const override
+        {
+            return ((IsValid() == true) ? (sizeof(vVertices) + _programSize + _offscreen.Footprint()) : 0);
+        }
+
+        uint16_t Rate() const override
+        {
+            // u_time is the only input that changes by itself, without it
+            // (also when the compiler dropped it) every frame is the same.
+            return (((_rate == IModel::Continuous) && (_uTime == -1)) ? static_cast<uint16_t>(0) : _rate);
+        }
+
+    private:
+        static ProgramCache::Attributes Attributes()
+        {
+            return { { 0, "vPosition" }, { 1, "vOpacity" } };
+        }
+
+        uint16_t Scaled(const uint16_t size) const
+        {
+            return (std::max(static_cast<uint16_t>(1), static_cast<uint16_t>(std::ceil(size * _scale))));
+        }
+
+        // Includes are looked up next to the fragment shader file, if there is one.
+        void Preprocess(const ModelConfig& config)
+        {
+            ShaderPreprocessor::Defines defines;
+
+            if (config.Quality.IsSet() == true) {
+                const uint8_t quality(config.Quality.Value());
+
+                defines.emplace_back(_T("QUALITY"), std::to_string((quality < ShaderPreprocessor::MaxQuality) ? quality : static_cast<uint8_t>(ShaderPreprocessor::MaxQuality)));
+            }
+
+            Core::JSON::ArrayType<Core::JSON::String>::ConstIterator index(config.Defines.Elements());
+
+            while (index.Next() == true) {
+                ShaderPreprocessor::Add(defines, index.Current().Value());
+            }
+
+            const string& file(config.FragmentShaderFile.Value());
+            const string directory(((config.FragmentShaderFile.IsSet() == true) && (file.find('/') != string::npos)) ? file.substr(0, file.rfind('/') + 1) : string());
+
+            string output;
+
+            ShaderPreprocessor vertex(directory);
+
+            if (vertex.Process(_vertexShaderSource, defines, output) == true) {
+                _vertexShaderSource.swap(output);
+            }
+
+            ShaderPreprocessor fragment(directory);
+
+            if (fragment.Process(_fragmentShaderSource, defines, output) == true) {
+                _fragmentShaderSource.swap(output);
+            } else {
+                TRACE(Trace::Error, ("Preprocessing %s failed, compiling it as is", config.FragmentShader.Value().c_str()));
+            }
+        }
+
     public:
         EGLShader(const ModelConfig& config)
             : _frameNumber(0)
             , _start(Core::Time::Now().Ticks())
+            , _x(0)
+            , _y(0)
             , _width(0)
             , _height(0)
             , _opacity(255)
+            , _configured(1.0f)
+            , _scale(1.0f)
+            , _rate(IModel::Continuous)
+            , _offscreen()
             , _vertexShaderSource()
             , _fragmentShaderSource()
+            , _originalSource()
             , _program(GL_FALSE)
             , _vbo(0)
+            , _programSize(0)
+            , _tables(false)
             , _inPosition(0)
             , _uTime(0)
             , _uResolution(0)
             , _uOpacity(0)
+            , _uOffset(-1)
         {
-            _vertexShaderSource = config.FragmentShaderSource.Value();
+            _vertexShaderSource = config.VertexShaderSource.Value();
             _fragmentShaderSource = config.FragmentShaderSource.Value();
 
-            if ((config.VertexShaderFile.IsSet() == true) && (config.VertexShaderFile.Value().empty() == false)) {
+            // Linked into the plugin, no file to read.
+            const ShaderLibrary::Entry* vertexShader(ShaderLibrary::Find(config.VertexShader.Value()));
+            const ShaderLibrary::Entry* fragmentShader(ShaderLibrary::Find(config.FragmentShader.Value()));
+
+            if (vertexShader != nullptr) {
+                _vertexShaderSource.assign(vertexShader->Source, vertexShader->Length);
+                TRACE(Trace::Information, (("Embedded vertex shader %s %016" PRIx64), vertexShader->Name, vertexShader->Hash));
+            } else if ((config.VertexShaderFile.IsSet() == true) && (config.VertexShaderFile.Value().empty() == false)) {
                 Core::File vertex(config.VertexShaderFile.Value());
 
                 if ((vertex.Exists() == true) && (vertex.Size() > 0)) {
@@ -179,7 +776,10 @@ namespace Graphics {
                 }
             }
 
-            if ((config.FragmentShaderFile.IsSet() == true) && (config.FragmentShaderFile.Value().empty() == false)) {
+            if (fragmentShader != nullptr) {
+                _fragmentShaderSource.assign(fragmentShader->Source, fragmentShader->Length);
+                TRACE(Trace::Information, (("Embedded fragment shader %s %016" PRIx64), fragmentShader->Name, fragmentShader->Hash));
+            } else if ((config.FragmentShaderFile.IsSet() == true) && (config.FragmentShaderFile.Value().empty() == false)) {
                 Core::File fragment(config.FragmentShaderFile.Value());
 
                 if ((fragment.Exists() == true) && (fragment.Size() > 0)) {
@@ -197,6 +797,17 @@ namespace Graphics {
                 }
             }
 
+            Preprocess(config);
+
+            if (ShaderOptimizer::Instance().IsEnabled() == true) {
+                string optimized(ShaderOptimizer::Instance().Optimize(_fragmentShaderSource));
+
+                if (optimized != _fragmentShaderSource) {
+                    _originalSource.swap(_fragmentShaderSource);
+                    _fragmentShaderSource.swap(optimized);
+                }
+            }
+
             if (config.Width.IsSet() == true) {
                 _width = config.Width.Value();
             }
@@ -205,7 +816,16 @@ namespace Graphics {
                 _height = config.Height.Value();
             }
 
-            TRACE(Trace::Information, ("Created EGL Model %p %dhx%dw", this, _height, _width));
+            if (config.RenderScale.IsSet() == true) {
+                _configured = std::min(std::max(config.RenderScale.Value(), 0.1f), 1.0f);
+                _scale = _configured;
+            }
+
+            if (config.Rate.IsSet() == true) {
+                _rate = config.Rate.Value();
+            }
+
+            TRACE(Trace::Information, ("Created EGL Model %p %dhx%dw scale=%.2f", this, _height, _width, _scale));
 
             // TRACE(Trace::EGL, ("Vertex shader:\n====START====================\n%s\n====END========================", _vertexShaderSource.c_str()));
             // TRACE(Trace::EGL, ("Fragment shader:\n====START====================\n%s\n==END==========================", _fragmentShaderSource.c_str()));
@@ -215,14 +835,23 @@ namespace Graphics {
         uint32_t _frameNumber;
         const uint64_t _start;
 
+        uint16_t _x; // in pixels, window coordinates
+        uint16_t _y; // in pixels, window coordinates
         uint16_t _width; // in pixels
         uint16_t _height; // in pixels
         uint8_t _opacity; // in 0-255;
+        float _configured; // render scale of the model, Scale() is a factor on it
+        float _scale; // offscreen render size as fraction of the viewport
+        uint16_t _rate; // fps the output changes at, see IModel::Rate()
+        Offscreen _offscreen;
         string _vertexShaderSource;
         string _fragmentShaderSource;
+        string _originalSource; // fragment shader before the optimizer, until a program is built
 
         GLuint _program;
         GLuint _vbo;
+        uint32_t _programSize; // bytes
+        bool _tables; // samples the shared lookup tables
 
         // vertex variables
         GLuint _inPosition;
@@ -231,6 +860,7 @@ namespace Graphics {
         GLint _uTime; // running time in seconds
         GLint _uResolution;
         GLint _uOpacity;
+        GLint _uOffset; // window position of the viewport
     }; // class EGLShader
 
     Core::ProxyType<IModel> IModel::Create(const ModelConfig& config)
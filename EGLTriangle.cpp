@@ -14,6 +14,8 @@
 
 #include <esUtil.h>
 
+#include <algorithm>
+
 namespace Thunder {
 namespace Graphics {
     constexpr char vertex_shader_source[] = "#version 300 es                          \n"
@@ -53,7 +55,7 @@ namespace Graphics {
             }
         }
 
-        void Process() override
+        void Process(const uint8_t count, const ScissorType boxes[]) override
         {
             static uint32_t frameNumber;
             int r, g, b;
@@ -77,13 +79,20 @@ namespace Graphics {
              * Different color every frame
              */
             glClearColor(r / 256.0, g / 256.0, b / 256.0, 1.0);
-            glClear(GL_COLOR_BUFFER_BIT);
 
             // Load the vertex data
             glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, vVertices);
             glEnableVertexAttribArray(0);
 
-            glDrawArrays(GL_TRIANGLES, 0, 3);
+            // Same frame in every box, without boxes the scissor is left alone.
+            for (uint8_t index = 0; index < std::max(count, static_cast<uint8_t>(1)); ++index) {
+                if (count != 0) {
+                    glScissor(boxes[index].X, boxes[index].Y, boxes[index].Width, boxes[index].Height);
+                }
+
+                glClear(GL_COLOR_BUFFER_BIT);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }
 
             ++frameNumber;
 
@@ -120,6 +129,24 @@ namespace Graphics {
         {
         }
 
+        void Scale(const float scale) override
+        {
+        }
+
+        uint32_t Footprint() const override
+        {
+            return (0);
+        }
+
+        uint16_t Rate() const override
+        {
+            return (IModel::Continuous);
+        }
+
+        void Prepare() override
+        {
+        }
+
         bool IsValid() const override
         {
             return (_program != GL_FALSE);
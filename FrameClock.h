@@ -0,0 +1,280 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace Thunder {
+namespace Graphics {
+    // Schedules frames against absolute deadlines (base + n * period) on a
+    // monotonic clock, so render and present time do not add up to the period.
+    class FrameClock {
+    public:
+        enum policy : uint8_t {
+            SKIP, // drop the missed slots, continue at the next deadline
+            CATCHUP // render the missed slots back-to-back, bounded by MaxCatchUp
+        };
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr uint8_t MaxCatchUp = 3;
+        static constexpr uint8_t LockSamples = 16;
+        static constexpr uint64_t MinVSyncInterval = 4000000; // ns
+        static constexpr uint64_t MaxVSyncInterval = 100000000; // ns
+
+        static uint64_t Now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+        }
+
+    public:
+        FrameClock(const FrameClock&) = delete;
+        FrameClock& operator=(const FrameClock&) = delete;
+
+        FrameClock()
+            : _lock()
+            , _fps(0)
+            , _policy(SKIP)
+            , _vsyncLock(false)
+            , _base(0)
+            , _frame(0)
+            , _counted(0)
+            , _period(0)
+            , _refresh(0)
+            , _lastVSync(0)
+            , _samples()
+            , _sampleCount(0)
+            , _missed(0)
+        {
+        }
+        ~FrameClock() = default;
+
+    public:
+        void Configure(const uint16_t fps, const policy missed, const bool vsyncLock)
+        {
+            Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+
+            _fps = fps;
+            _policy = missed;
+            _vsyncLock = vsyncLock;
+            _refresh = 0;
+            _sampleCount = 0;
+            _period = (fps > 0) ? (1000000000ULL / fps) : 0;
+        }
+
+        // Restart the timeline, e.g. after a pause, so nothing is caught up.
+        void Reset()
+        {
+            Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+
+            _base = Now();
+            _frame = 0;
+            _counted = 0;
+        }
+
+        // Feed a display refresh event (Published). The intervals are multiples
+        // of the refresh period, used to lock the period to a whole divisor.
+        void VSync()
+        {
+            Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+
+            const uint64_t now(Now());
+            const uint64_t previous(_lastVSync);
+            const uint64_t delta(now - previous);
+
+            _lastVSync = now;
+
+            if ((previous != 0) && (delta >= MinVSyncInterval) && (delta <= MaxVSyncInterval)) {
+                _samples[_sampleCount++] = delta;
+
+                if (_sampleCount == LockSamples) {
+                    _sampleCount = 0;
+
+                    if ((_vsyncLock == true) && (_fps != 0)) {
+                        Lock();
+                    }
+                }
+
+                if ((_refresh != 0) && (_base != 0)) {
+                    // Slowly pull the deadline grid onto the vsync phase.
+                    int64_t error(static_cast<int64_t>((now - _base) % _refresh));
+
+                    if (error > static_cast<int64_t>(_refresh / 2)) {
+                        error -= _refresh;
+                    }
+
+                    _base += (error / 8);
+                }
+            }
+        }
+
+        // Called once a frame is done, returns the time in ms until the next deadline.
+        uint32_t Next()
+        {
+            Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+
+            uint32_t result(Core::infinite);
+
+            if (_period != 0) {
+                const uint64_t now(Now());
+
+                uint64_t deadline(_base + (++_frame * _period));
+
+                if (deadline <= now) {
+                    const uint64_t due(((now - _base) / _period) + 1);
+                    const uint64_t behind(due - _frame);
+
+                    // Catching up passes the same late slots again, each is missed once.
+                    if (due > std::max(_frame, _counted)) {
+                        _missed += static_cast<uint32_t>(due - std::max(_frame, _counted));
+                        _counted = due;
+                    }
+
+                    if ((_policy == SKIP) || (behind > MaxCatchUp)) {
+                        _frame += behind;
+                        deadline = _base + (_frame * _period);
+                    }
+                }
+
+                result = (deadline > now) ? static_cast<uint32_t>((deadline - now + 500000) / 1000000) : 0;
+            }
+
+            return (result);
+        }
+
+        // Time in ms until the current deadline, 0 when it is (almost) due.
+        uint32_t Remaining() const
+        {
+            Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+
+            uint32_t result(0);
+
+            if (_period != 0) {
+                const uint64_t now(Now());
+                const uint64_t deadline(_base + (_frame * _period));
+
+                if (deadline > (now + (_period / 4))) {
+                    result = static_cast<uint32_t>((deadline - now) / 1000000);
+                }
+            }
+
+            return (result);
+        }
+
+        uint32_t Missed() const
+        {
+            return (_missed);
+        }
+
+        // Effective frame period in microseconds.
+        uint32_t Period() const
+        {
+            return (static_cast<uint32_t>(_period / 1000));
+        }
+
+        // Measured display refresh in mHz, 0 if not (yet) locked.
+        uint32_t Refresh() const
+        {
+            return ((_refresh != 0) ? static_cast<uint32_t>(1000000000000ULL / _refresh) : 0);
+        }
+
+    private:
+        void Lock()
+        {
+            // The samples are publish intervals, so whole multiples of the refresh
+            // period, not the refresh itself. Only rates that are at least the
+            // requested fps can be the display, the lowest of those that divides
+            // the intervals wins: every interval of a 60Hz display is a whole
+            // multiple of 120Hz too. Of rates less than 1% apart (60 and 59.94Hz)
+            // the closest fit wins.
+            static constexpr uint32_t rates[] = { 23976, 24000, 25000, 29970, 30000, 50000, 59940, 60000, 120000 }; // mHz
+
+            const uint32_t minimum((static_cast<uint32_t>(_fps) * 1000) - (static_cast<uint32_t>(_fps) * 10));
+
+            uint32_t chosen(0);
+            double best(0.05);
+
+            for (const uint32_t rate : rates) {
+                if (rate < minimum) {
+                    continue;
+                }
+                if ((chosen != 0) && (rate > (chosen + (chosen / 100)))) {
+                    break;
+                }
+
+                const double refresh(1000000000000.0 / rate);
+                double error(0);
+
+                for (uint8_t i = 0; i < LockSamples; i++) {
+                    const double multiple(_samples[i] / refresh);
+                    error += std::abs(multiple - std::round(multiple));
+                }
+
+                if ((error / LockSamples) < best) {
+                    best = error / LockSamples;
+                    chosen = rate;
+                }
+            }
+
+            if (chosen != 0) {
+                const uint64_t refresh(static_cast<uint64_t>(1000000000000.0 / chosen));
+
+                // Whole divisor of the refresh that does not exceed the requested fps.
+                const uint32_t divisor(std::max(1U, static_cast<uint32_t>(std::ceil((chosen / 1000.0) / _fps - 0.01))));
+
+                if (_refresh != refresh) {
+                    _refresh = refresh;
+                    _period = _refresh * divisor;
+                    _base = _lastVSync;
+                    _frame = 0;
+                    _counted = 0;
+
+                    TRACE(Trace::Information, ("Frame clock locked to %d.%03dHz/%d", chosen / 1000, chosen % 1000, divisor));
+                }
+            }
+        }
+
+    private:
+        mutable Core::CriticalSection _lock;
+
+        uint16_t _fps;
+        policy _policy;
+        bool _vsyncLock;
+
+        uint64_t _base; // ns
+        uint64_t _frame;
+        uint64_t _counted; // slots before this are counted as missed
+        uint64_t _period; // ns
+        uint64_t _refresh; // ns
+
+        uint64_t _lastVSync; // ns
+        uint64_t _samples[LockSamples];
+        uint8_t _sampleCount;
+
+        uint32_t _missed;
+    }; // class FrameClock
+
+} // namespace Graphics
+} // namespace Thunder
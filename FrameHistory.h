@@ -0,0 +1,180 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace Thunder {
+namespace Graphics {
+    // Timing of the last Capacity frames. Written by the render thread only,
+    // read from any thread without a lock: every slot carries a sequence
+    // number that is odd while it is written, a reader skips a slot that
+    // changed while it was copied.
+    class FrameHistory {
+    public:
+        static constexpr uint16_t Capacity = 512;
+
+        struct Sample {
+            uint64_t Frame;
+            uint64_t Start; // us, monotonic
+            uint32_t Interval; // us since the previous frame, 0 for the first after a (re)start
+            uint32_t Cpu; // us recording the models
+            uint32_t Swap; // us in eglSwapBuffers
+            uint32_t Wait; // us waiting for the compositor before recording
+        };
+
+        struct Distribution {
+            uint32_t Min;
+            uint32_t Avg;
+            uint32_t P95;
+            uint32_t P99;
+            uint32_t Max;
+        };
+
+    private:
+        struct Slot {
+            Slot()
+                : Sequence(0)
+                , Start(0)
+                , Interval(0)
+                , Cpu(0)
+                , Swap(0)
+                , Wait(0)
+            {
+            }
+
+            std::atomic<uint64_t> Sequence;
+            std::atomic<uint64_t> Start;
+            std::atomic<uint32_t> Interval;
+            std::atomic<uint32_t> Cpu;
+            std::atomic<uint32_t> Swap;
+            std::atomic<uint32_t> Wait;
+        };
+
+    public:
+        FrameHistory(const FrameHistory&) = delete;
+        FrameHistory& operator=(const FrameHistory&) = delete;
+
+        FrameHistory()
+            : _slots()
+            , _recorded(0)
+        {
+        }
+        ~FrameHistory() = default;
+
+    public:
+        // Render thread only.
+        void Record(const uint64_t start, const uint32_t interval, const uint32_t cpu, const uint32_t swap, const uint32_t wait)
+        {
+            const uint64_t frame(_recorded.load(std::memory_order_relaxed));
+            Slot& slot(_slots[frame % Capacity]);
+
+            slot.Sequence.store((2 * frame) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            slot.Start.store(start, std::memory_order_relaxed);
+            slot.Interval.store(interval, std::memory_order_relaxed);
+            slot.Cpu.store(cpu, std::memory_order_relaxed);
+            slot.Swap.store(swap, std::memory_order_relaxed);
+            slot.Wait.store(wait, std::memory_order_relaxed);
+
+            slot.Sequence.store((2 * frame) + 2, std::memory_order_release);
+            _recorded.store(frame + 1, std::memory_order_release);
+        }
+
+        uint64_t Recorded() const
+        {
+            return (_recorded.load(std::memory_order_acquire));
+        }
+
+        // Copies up to the last count frames, oldest first.
+        void Snapshot(std::vector<Sample>& samples, const uint16_t count = Capacity) const
+        {
+            const uint64_t recorded(Recorded());
+            const uint64_t window((count < Capacity) ? count : static_cast<uint16_t>(Capacity));
+            const uint64_t first((recorded > window) ? (recorded - window) : 0);
+
+            samples.clear();
+            samples.reserve(static_cast<size_t>(recorded - first));
+
+            for (uint64_t frame = first; frame < recorded; ++frame) {
+                const Slot& slot(_slots[frame % Capacity]);
+                const uint64_t sequence(slot.Sequence.load(std::memory_order_acquire));
+
+                Sample sample;
+                sample.Frame = frame;
+                sample.Start = slot.Start.load(std::memory_order_relaxed);
+                sample.Interval = slot.Interval.load(std::memory_order_relaxed);
+                sample.Cpu = slot.Cpu.load(std::memory_order_relaxed);
+                sample.Swap = slot.Swap.load(std::memory_order_relaxed);
+                sample.Wait = slot.Wait.load(std::memory_order_relaxed);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                // Overwritten by a newer frame meanwhile, that one is not asked for.
+                if ((sequence == ((2 * frame) + 2)) && (slot.Sequence.load(std::memory_order_relaxed) == sequence)) {
+                    samples.push_back(sample);
+                }
+            }
+        }
+
+        // Nearest rank percentiles, reorders the values.
+        static Distribution Summarize(std::vector<uint32_t>& values)
+        {
+            Distribution result = { 0, 0, 0, 0, 0 };
+
+            if (values.empty() == false) {
+                std::sort(values.begin(), values.end());
+
+                uint64_t total(0);
+
+                for (const uint32_t value : values) {
+                    total += value;
+                }
+
+                result.Min = values.front();
+                result.Avg = static_cast<uint32_t>(total / values.size());
+                result.P95 = values[Rank(values.size(), 95)];
+                result.P99 = values[Rank(values.size(), 99)];
+                result.Max = values.back();
+            }
+
+            return (result);
+        }
+
+    private:
+        static size_t Rank(const size_t size, const uint8_t percentile)
+        {
+            const size_t rank(((size * percentile) + 99) / 100);
+
+            return ((rank > 0) ? (rank - 1) : 0);
+        }
+
+    private:
+        Slot _slots[Capacity];
+        std::atomic<uint64_t> _recorded;
+    }; // class FrameHistory
+
+} // namespace Graphics
+} // namespace Thunder
@@ -0,0 +1,311 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FramebufferFormat.h"
+
+#include "EGLToolbox.h"
+#include "Tracing.h"
+
+#include <GLES2/gl2.h>
+
+#include <algorithm>
+#include <chrono>
+
+ENUM_CONVERSION_BEGIN(Thunder::Graphics::FramebufferFormat::format)
+    { Thunder::Graphics::FramebufferFormat::RGB565, _TXT("rgb565") },
+    { Thunder::Graphics::FramebufferFormat::RGB888, _TXT("rgb888") },
+    { Thunder::Graphics::FramebufferFormat::RGBA8888, _TXT("rgba8888") },
+ENUM_CONVERSION_END(Thunder::Graphics::FramebufferFormat::format)
+
+namespace Thunder {
+namespace Graphics {
+    namespace {
+        struct Channels {
+            EGLint Red;
+            EGLint Green;
+            EGLint Blue;
+            EGLint Alpha;
+        };
+
+        constexpr Channels FormatChannels[FramebufferFormat::Formats] = {
+            { 5, 6, 5, 0 }, // RGB565
+            { 8, 8, 8, 0 }, // RGB888
+            { 8, 8, 8, 8 } // RGBA8888
+        };
+
+        constexpr EGLint ContextAttribs[] = {
+            EGL_CONTEXT_CLIENT_VERSION, 2,
+            EGL_NONE
+        };
+
+        constexpr char VertexShader[] = "attribute vec2 position;\n"
+                                        "void main() {\n"
+                                        "    gl_Position = vec4(position, 0.0, 1.0);\n"
+                                        "}\n";
+
+        // Cheap per fragment, so the blended passes are bound by the
+        // framebuffer reads and writes.
+        constexpr char FragmentShader[] = "precision mediump float;\n"
+                                          "uniform vec4 color;\n"
+                                          "void main() {\n"
+                                          "    gl_FragColor = color;\n"
+                                          "}\n";
+
+        constexpr GLfloat Quad[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+
+        uint64_t Monotonic() // in us
+        {
+            return (std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        GLuint Compile(const GLenum type, const char source[])
+        {
+            GLuint shader(glCreateShader(type));
+            GLint compiled(GL_FALSE);
+
+            glShaderSource(shader, 1, &source, nullptr);
+            glCompileShader(shader);
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+
+            if (compiled != GL_TRUE) {
+                glDeleteShader(shader);
+                shader = 0;
+            }
+
+            return (shader);
+        }
+
+        EGLint Attribute(EGLDisplay display, EGLConfig config, const EGLint name)
+        {
+            EGLint value(0);
+
+            eglGetConfigAttrib(display, config, name, &value);
+
+            return (value);
+        }
+    }
+
+    FramebufferFormat::FramebufferFormat()
+        : _chosen(RGBA8888)
+        , _configId(0)
+        , _bufferSize(0)
+        , _frameTimes()
+    {
+    }
+
+    EGLConfig FramebufferFormat::Select(EGLDisplay display, const EGLint surfaceType, const format requested, const bool alpha)
+    {
+        // The requested format, then the larger ones, then the smaller ones.
+        // A surface that hides by turning transparent only gets formats with alpha.
+        format order[Formats];
+        uint8_t count(0);
+
+        if ((alpha == false) || (FormatChannels[requested].Alpha != 0)) {
+            order[count++] = requested;
+        } else {
+            TRACE(Trace::Information, ("Format %s has no alpha, the surface needs it to hide", Core::EnumerateType<format>(requested).Data()));
+        }
+
+        for (uint8_t index = requested + 1; index < Formats; ++index) {
+            if ((alpha == false) || (FormatChannels[index].Alpha != 0)) {
+                order[count++] = static_cast<format>(index);
+            }
+        }
+
+        for (uint8_t index = requested; index > 0; --index) {
+            if ((alpha == false) || (FormatChannels[index - 1].Alpha != 0)) {
+                order[count++] = static_cast<format>(index - 1);
+            }
+        }
+
+        EGLConfig fallback(nullptr);
+        EGLConfig result(nullptr);
+        uint8_t attempt(0);
+
+        while ((result == nullptr) && (attempt < count)) {
+            result = Best(display, surfaceType, order[attempt], fallback);
+
+            if (result != nullptr) {
+                _chosen = order[attempt];
+            } else {
+                TRACE(Trace::Information, ("No %s config for this surface", Core::EnumerateType<format>(order[attempt]).Data()));
+            }
+
+            ++attempt;
+        }
+
+        if (result == nullptr) {
+            // Nothing with exact channel sizes, take what EGL ranks first.
+            result = fallback;
+            _chosen = RGBA8888;
+        }
+
+        if (result != nullptr) {
+            _configId = Attribute(display, result, EGL_CONFIG_ID);
+            _bufferSize = Attribute(display, result, EGL_BUFFER_SIZE);
+
+            TRACE(Trace::Information, ("Framebuffer format %s (requested %s), config %d of %d bits", Core::EnumerateType<format>(_chosen).Data(), Core::EnumerateType<format>(requested).Data(), _configId, _bufferSize));
+        } else {
+            TRACE(Trace::Error, ("No EGL config for this surface"));
+        }
+
+        return (result);
+    }
+
+    void FramebufferFormat::Compare(EGLDisplay display, const uint16_t width, const uint16_t height)
+    {
+        for (uint8_t index = 0; index < Formats; ++index) {
+            EGLConfig fallback(nullptr);
+            EGLConfig config(Best(display, EGL_PBUFFER_BIT, static_cast<format>(index), fallback));
+
+            _frameTimes[index] = (config != nullptr) ? Measure(display, config, width, height) : 0;
+
+            TRACE(Trace::Information, ("Framebuffer format %s: %dus per frame", Core::EnumerateType<format>(static_cast<format>(index)).Data(), _frameTimes[index]));
+        }
+    }
+
+    /* static */ EGLConfig FramebufferFormat::Best(EGLDisplay display, const EGLint surfaceType, const format type, EGLConfig& fallback)
+    {
+        const Channels& channels(FormatChannels[type]);
+
+        const EGLint attributes[] = {
+            EGL_SURFACE_TYPE, surfaceType,
+            EGL_RED_SIZE, channels.Red,
+            EGL_GREEN_SIZE, channels.Green,
+            EGL_BLUE_SIZE, channels.Blue,
+            EGL_ALPHA_SIZE, channels.Alpha,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+            EGL_SAMPLES, 0,
+            EGL_NONE
+        };
+
+        const std::vector<EGLConfig> configs(EGL::MatchConfigs(display, attributes));
+
+        if ((fallback == nullptr) && (configs.empty() == false)) {
+            fallback = configs.front();
+        }
+
+        // The sizes are minimums and EGL sorts the deepest colour first,
+        // so pick the exact match with the fewest bits per pixel.
+        EGLConfig result(nullptr);
+        uint64_t cost(~0ULL);
+
+        for (const EGLConfig config : configs) {
+            if ((Attribute(display, config, EGL_RED_SIZE) == channels.Red)
+                && (Attribute(display, config, EGL_GREEN_SIZE) == channels.Green)
+                && (Attribute(display, config, EGL_BLUE_SIZE) == channels.Blue)
+                && (Attribute(display, config, EGL_ALPHA_SIZE) == channels.Alpha)) {
+
+                const uint64_t candidate((static_cast<uint64_t>(Attribute(display, config, EGL_CONFIG_CAVEAT) == EGL_SLOW_CONFIG) << 48)
+                    | (static_cast<uint64_t>(Attribute(display, config, EGL_SAMPLES)) << 40)
+                    | (static_cast<uint64_t>(Attribute(display, config, EGL_BUFFER_SIZE)) << 16)
+                    | static_cast<uint64_t>(Attribute(display, config, EGL_DEPTH_SIZE) + Attribute(display, config, EGL_STENCIL_SIZE)));
+
+                if (candidate < cost) {
+                    cost = candidate;
+                    result = config;
+                }
+            }
+        }
+
+        return (result);
+    }
+
+    // Median of a few frames of blended full screen passes, each finished
+    // before the next, so every frame is written out to memory.
+    /* static */ uint32_t FramebufferFormat::Measure(EGLDisplay display, EGLConfig config, const uint16_t width, const uint16_t height)
+    {
+        uint32_t result(0);
+
+        const EGLint pbufferAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+
+        EGLContext context(eglCreateContext(display, config, EGL_NO_CONTEXT, ContextAttribs));
+        EGLSurface surface((context != EGL_NO_CONTEXT) ? eglCreatePbufferSurface(display, config, pbufferAttribs) : EGL_NO_SURFACE);
+
+        if ((surface != EGL_NO_SURFACE) && (eglMakeCurrent(display, surface, surface, context) == EGL_TRUE)) {
+            const GLuint vertex(Compile(GL_VERTEX_SHADER, VertexShader));
+            const GLuint fragment(Compile(GL_FRAGMENT_SHADER, FragmentShader));
+            const GLuint program(glCreateProgram());
+
+            GLint linked(GL_FALSE);
+
+            glAttachShader(program, vertex);
+            glAttachShader(program, fragment);
+            glBindAttribLocation(program, 0, "position");
+            glLinkProgram(program);
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+            if (linked == GL_TRUE) {
+                uint32_t samples[Frames];
+
+                glUseProgram(program);
+                glUniform4f(glGetUniformLocation(program, "color"), 0.2f, 0.4f, 0.6f, 0.5f);
+
+                glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, Quad);
+                glEnableVertexAttribArray(0);
+
+                glViewport(0, 0, width, height);
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+                for (uint8_t frame = 0; frame < (WarmupFrames + Frames); ++frame) {
+                    const uint64_t start(Monotonic());
+
+                    glClear(GL_COLOR_BUFFER_BIT);
+
+                    for (uint8_t pass = 0; pass < Passes; ++pass) {
+                        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                    }
+
+                    glFinish();
+
+                    if (frame >= WarmupFrames) {
+                        samples[frame - WarmupFrames] = static_cast<uint32_t>(Monotonic() - start);
+                    }
+                }
+
+                std::nth_element(samples, samples + (Frames / 2), samples + Frames);
+
+                result = samples[Frames / 2];
+
+                glDisableVertexAttribArray(0);
+                glUseProgram(0);
+            }
+
+            glDeleteProgram(program);
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        }
+
+        if (surface != EGL_NO_SURFACE) {
+            eglDestroySurface(display, surface);
+        }
+
+        if (context != EGL_NO_CONTEXT) {
+            eglDestroyContext(display, context);
+        }
+
+        return (result);
+    }
+
+} // namespace Graphics
+} // namespace Thunder
@@ -0,0 +1,99 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include <EGL/egl.h>
+
+namespace Thunder {
+namespace Graphics {
+    // Picks the EGL config of the surface. While shown the screensaver is
+    // opaque, so a format without alpha, or with 16 bits per pixel, saves
+    // memory bandwidth on every fill, blend and scan-out. A surface of the
+    // compositor hides by being cleared transparent though, it keeps alpha.
+    // Of the configs EGL matches, only those with exactly the channel sizes
+    // of the format count, the ones with the smallest buffer win. When a
+    // format has none, the larger formats are tried first, then the smaller
+    // ones.
+    class FramebufferFormat {
+    public:
+        enum format : uint8_t {
+            RGB565,
+            RGB888,
+            RGBA8888
+        };
+
+        static constexpr uint8_t Formats = 3;
+        static constexpr uint8_t WarmupFrames = 2;
+        static constexpr uint8_t Frames = 8; // measured per format
+        static constexpr uint8_t Passes = 3; // blended full screen passes per frame
+
+    public:
+        FramebufferFormat(const FramebufferFormat&) = delete;
+        FramebufferFormat& operator=(const FramebufferFormat&) = delete;
+
+        FramebufferFormat();
+        ~FramebufferFormat() = default;
+
+    public:
+        // nullptr if EGL has no config for the surface type at all. With alpha
+        // only formats with an alpha channel are taken.
+        EGLConfig Select(EGLDisplay display, const EGLint surfaceType, const format requested, const bool alpha);
+
+        // Needs no context current on the calling thread. Renders a few
+        // bandwidth bound frames into a pbuffer of every format and keeps
+        // the median frame time of each.
+        void Compare(EGLDisplay display, const uint16_t width, const uint16_t height);
+
+        format Chosen() const
+        {
+            return (_chosen);
+        }
+
+        EGLint ConfigId() const
+        {
+            return (_configId);
+        }
+
+        EGLint BufferSize() const
+        {
+            return (_bufferSize);
+        }
+
+        // In us, 0 if the format was not measured or has no pbuffer config.
+        uint32_t FrameTime(const format type) const
+        {
+            return (_frameTimes[type]);
+        }
+
+    private:
+        static EGLConfig Best(EGLDisplay display, const EGLint surfaceType, const format type, EGLConfig& fallback);
+        static uint32_t Measure(EGLDisplay display, EGLConfig config, const uint16_t width, const uint16_t height);
+
+    private:
+        format _chosen;
+        EGLint _configId;
+        EGLint _bufferSize; // bits per pixel
+        uint32_t _frameTimes[Formats]; // us
+    }; // class FramebufferFormat
+
+} // namespace Graphics
+} // namespace Thunder
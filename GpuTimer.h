@@ -0,0 +1,285 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include "Tracing.h"
+
+#ifndef GL_ES_VERSION_2_0
+#include <GLES2/gl2.h>
+#endif
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+
+#include <string.h>
+
+#include <vector>
+
+namespace Thunder {
+namespace Graphics {
+    // Asynchronous GPU time measurement with GL_EXT_disjoint_timer_query. The
+    // queries form a ring, results are collected Latency frames later so the
+    // pipeline is never stalled on a readback. When the driver has timestamp
+    // counters, a frame is split in sections by Mark(), e.g. one per model.
+    class GpuTimer {
+    public:
+        static constexpr uint8_t Latency = 4;
+        static constexpr uint8_t MaxSections = 16;
+
+        typedef std::vector<std::pair<uint32_t, uint64_t>> Sections; // id, ns
+
+    private:
+        struct Frame {
+            GLuint Queries[MaxSections + 2]; // begin, a mark per section, end
+            uint32_t Ids[MaxSections];
+            uint8_t Marks;
+        };
+
+    public:
+        GpuTimer(const GpuTimer&) = delete;
+        GpuTimer& operator=(const GpuTimer&) = delete;
+
+        GpuTimer()
+            : _frames()
+            , _head(0)
+            , _count(0)
+            , _running(false)
+            , _timestamps(false)
+            , _discard()
+            , _genQueries(nullptr)
+            , _deleteQueries(nullptr)
+            , _beginQuery(nullptr)
+            , _endQuery(nullptr)
+            , _queryCounter(nullptr)
+            , _getQueryiv(nullptr)
+            , _getQueryObjectiv(nullptr)
+            , _getQueryObjectui64v(nullptr)
+        {
+        }
+        ~GpuTimer() = default;
+
+    public:
+        static bool IsSupported()
+        {
+            const char* extensions(reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS)));
+
+            return ((extensions != nullptr) && (strstr(extensions, "GL_EXT_disjoint_timer_query") != nullptr));
+        }
+
+        // Needs a current context.
+        bool Initialize()
+        {
+            if ((IsValid() == false) && (IsSupported() == true)) {
+                _genQueries = reinterpret_cast<PFNGLGENQUERIESEXTPROC>(eglGetProcAddress("glGenQueriesEXT"));
+                _deleteQueries = reinterpret_cast<PFNGLDELETEQUERIESEXTPROC>(eglGetProcAddress("glDeleteQueriesEXT"));
+                _beginQuery = reinterpret_cast<PFNGLBEGINQUERYEXTPROC>(eglGetProcAddress("glBeginQueryEXT"));
+                _endQuery = reinterpret_cast<PFNGLENDQUERYEXTPROC>(eglGetProcAddress("glEndQueryEXT"));
+                _queryCounter = reinterpret_cast<PFNGLQUERYCOUNTEREXTPROC>(eglGetProcAddress("glQueryCounterEXT"));
+                _getQueryiv = reinterpret_cast<PFNGLGETQUERYIVEXTPROC>(eglGetProcAddress("glGetQueryivEXT"));
+                _getQueryObjectiv = reinterpret_cast<PFNGLGETQUERYOBJECTIVEXTPROC>(eglGetProcAddress("glGetQueryObjectivEXT"));
+                _getQueryObjectui64v = reinterpret_cast<PFNGLGETQUERYOBJECTUI64VEXTPROC>(eglGetProcAddress("glGetQueryObjectui64vEXT"));
+
+                if ((_genQueries != nullptr) && (_deleteQueries != nullptr) && (_beginQuery != nullptr) && (_endQuery != nullptr) && (_getQueryObjectiv != nullptr) && (_getQueryObjectui64v != nullptr)) {
+                    // The extension allows a timestamp counter of 0 bits.
+                    GLint bits(0);
+
+                    if ((_queryCounter != nullptr) && (_getQueryiv != nullptr)) {
+                        _getQueryiv(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT, &bits);
+                    }
+
+                    _timestamps = (bits > 0);
+
+                    for (Frame& frame : _frames) {
+                        _genQueries(Queries(), frame.Queries);
+                        frame.Marks = 0;
+                    }
+                } else {
+                    _genQueries = nullptr;
+                }
+            }
+
+            return (IsValid());
+        }
+
+        // Needs the context the queries were created on.
+        void Deinitialize()
+        {
+            if (IsValid() == true) {
+                if ((_running == true) && (_timestamps == false)) {
+                    _endQuery(GL_TIME_ELAPSED_EXT);
+                }
+
+                for (Frame& frame : _frames) {
+                    _deleteQueries(Queries(), frame.Queries);
+                }
+
+                _genQueries = nullptr;
+                _running = false;
+                _timestamps = false;
+                _head = 0;
+                _count = 0;
+            }
+        }
+
+        bool IsValid() const
+        {
+            return (_genQueries != nullptr);
+        }
+
+        // Sections are only measured with timestamp counters.
+        bool HasSections() const
+        {
+            return (_timestamps);
+        }
+
+        void Begin()
+        {
+            // Skip a measurement rather than waiting for a free query.
+            if ((IsValid() == true) && (_count < Latency)) {
+                Frame& frame(_frames[_head]);
+
+                frame.Marks = 0;
+
+                if (_timestamps == true) {
+                    _queryCounter(frame.Queries[0], GL_TIMESTAMP_EXT);
+                } else {
+                    _beginQuery(GL_TIME_ELAPSED_EXT, frame.Queries[0]);
+                }
+
+                _running = true;
+            }
+        }
+
+        // Closes the section of id, which started at Begin() or the previous Mark().
+        void Mark(const uint32_t id)
+        {
+            if ((_running == true) && (_timestamps == true)) {
+                Frame& frame(_frames[_head]);
+
+                if (frame.Marks < MaxSections) {
+                    frame.Ids[frame.Marks] = id;
+                    ++frame.Marks;
+                    _queryCounter(frame.Queries[frame.Marks], GL_TIMESTAMP_EXT);
+                }
+            }
+        }
+
+        void End()
+        {
+            if (_running == true) {
+                Frame& frame(_frames[_head]);
+
+                if (_timestamps == true) {
+                    _queryCounter(frame.Queries[frame.Marks + 1], GL_TIMESTAMP_EXT);
+                } else {
+                    _endQuery(GL_TIME_ELAPSED_EXT);
+                }
+
+                _running = false;
+                _head = (_head + 1) % Latency;
+                ++_count;
+            }
+        }
+
+        // Oldest available result in ns, false if none is ready or it was
+        // invalidated by a disjoint event (e.g. a GPU frequency change).
+        bool Result(uint64_t& elapsed)
+        {
+            return (Result(elapsed, _discard));
+        }
+
+        // Also the time per section of that frame, in the order they were marked.
+        bool Result(uint64_t& elapsed, Sections& sections)
+        {
+            bool result(false);
+
+            if (_count > 0) {
+                const Frame& frame(_frames[(_head + Latency - _count) % Latency]);
+                const uint8_t last((_timestamps == true) ? (frame.Marks + 1) : 0);
+                GLint available(GL_FALSE);
+
+                // Results become available in order, the last one covers the frame.
+                _getQueryObjectiv(frame.Queries[last], GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+
+                if (available != GL_FALSE) {
+                    GLint disjoint(GL_FALSE);
+
+                    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+                    --_count;
+
+                    if (disjoint == GL_FALSE) {
+                        sections.clear();
+
+                        if (_timestamps == true) {
+                            GLuint64 stamps[MaxSections + 2];
+
+                            for (uint8_t index = 0; index <= last; ++index) {
+                                _getQueryObjectui64v(frame.Queries[index], GL_QUERY_RESULT_EXT, &stamps[index]);
+                            }
+
+                            for (uint8_t index = 0; index < frame.Marks; ++index) {
+                                sections.emplace_back(frame.Ids[index], stamps[index + 1] - stamps[index]);
+                            }
+
+                            elapsed = stamps[last] - stamps[0];
+                        } else {
+                            GLuint64 value(0);
+
+                            _getQueryObjectui64v(frame.Queries[0], GL_QUERY_RESULT_EXT, &value);
+
+                            elapsed = value;
+                        }
+
+                        result = true;
+                    }
+                }
+            }
+
+            return (result);
+        }
+
+    private:
+        static GLsizei Queries()
+        {
+            return (MaxSections + 2);
+        }
+
+    private:
+        Frame _frames[Latency];
+        uint8_t _head;
+        uint8_t _count;
+        bool _running;
+        bool _timestamps;
+        Sections _discard;
+
+        PFNGLGENQUERIESEXTPROC _genQueries;
+        PFNGLDELETEQUERIESEXTPROC _deleteQueries;
+        PFNGLBEGINQUERYEXTPROC _beginQuery;
+        PFNGLENDQUERYEXTPROC _endQuery;
+        PFNGLQUERYCOUNTEREXTPROC _queryCounter;
+        PFNGLGETQUERYIVEXTPROC _getQueryiv;
+        PFNGLGETQUERYOBJECTIVEXTPROC _getQueryObjectiv;
+        PFNGLGETQUERYOBJECTUI64VEXTPROC _getQueryObjectui64v;
+    }; // class GpuTimer
+
+} // namespace Graphics
+} // namespace Thunder
@@ -0,0 +1,189 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Headless.h"
+
+#include "Tracing.h"
+
+#include <EGL/eglext.h>
+
+#include <chrono>
+#include <string.h>
+
+namespace Thunder {
+namespace Graphics {
+    namespace {
+        uint64_t Monotonic() // in us
+        {
+            return (std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+    }
+
+    uint32_t Headless::Surface::VSync::Worker()
+    {
+        const uint64_t period(_parent._display.Period());
+        const uint64_t now(Monotonic());
+
+        if ((_next == 0) || ((_next + period) < now)) {
+            // First tick or stalled for over a period, restart the grid.
+            _next = now + period;
+        } else if (_next <= now) {
+            _parent.Refresh();
+            _next += period;
+        }
+
+        return (static_cast<uint32_t>((_next - now + 999) / 1000));
+    }
+
+    Headless::Surface::Surface(Headless& display, const std::string& name, const uint32_t width, const uint32_t height, ICallback* callback)
+        : _refCount(1)
+        , _display(display)
+        , _name(name)
+        , _width(width)
+        , _height(height)
+        , _callback(callback)
+        , _requested(false)
+        , _vsync(*this)
+    {
+        _display.AddRef();
+        _vsync.Run();
+
+        TRACE(Trace::Information, ("Headless surface %s %dx%d", _name.c_str(), _width, _height));
+    }
+
+    Headless::Surface::~Surface()
+    {
+        _vsync.Stop();
+        _vsync.Wait(Core::Thread::STOPPED, Core::infinite);
+
+        _display.Detach(this);
+        _display.Release();
+    }
+
+    uint32_t Headless::Surface::Release() const
+    {
+        uint32_t result(Core::ERROR_NONE);
+
+        if (--_refCount == 0) {
+            delete this;
+            result = Core::ERROR_DESTRUCTION_SUCCEEDED;
+        }
+
+        return (result);
+    }
+
+    void Headless::Surface::Refresh()
+    {
+        // Like a compositor, only publish when something new was rendered.
+        if ((_requested.exchange(false) == true) && (_callback != nullptr)) {
+            _callback->Rendered(this);
+            _callback->Published(this);
+        }
+    }
+
+    Headless::Headless(const std::string& name, const uint16_t refresh)
+        : _refCount(1)
+        , _adminLock()
+        , _name(name)
+        , _period(1000000 / ((refresh > 0) ? refresh : 60))
+        , _surface(nullptr)
+    {
+        TRACE(Trace::Information, ("Headless display %s %dHz", _name.c_str(), 1000000 / _period));
+    }
+
+    /* static */ Compositor::IDisplay* Headless::Instance(const std::string& name, const uint16_t refresh)
+    {
+        return (new Headless(name, refresh));
+    }
+
+    /* static */ EGLDisplay Headless::Platform()
+    {
+        EGLDisplay result(EGL_NO_DISPLAY);
+
+        const char* extensions(eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS));
+
+        if ((extensions != nullptr) && (strstr(extensions, "EGL_MESA_platform_surfaceless") != nullptr)) {
+            PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay(reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT")));
+
+            if (getPlatformDisplay != nullptr) {
+                result = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            }
+        }
+
+        if (result == EGL_NO_DISPLAY) {
+            result = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+
+        return (result);
+    }
+
+    uint32_t Headless::Release() const
+    {
+        uint32_t result(Core::ERROR_NONE);
+
+        if (--_refCount == 0) {
+            delete this;
+            result = Core::ERROR_DESTRUCTION_SUCCEEDED;
+        }
+
+        return (result);
+    }
+
+    Compositor::IDisplay::ISurface* Headless::SurfaceByName(const std::string& name)
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_adminLock);
+
+        ISurface* result(nullptr);
+
+        if ((_surface != nullptr) && (_surface->Name() == name)) {
+            result = _surface;
+            result->AddRef();
+        }
+
+        return (result);
+    }
+
+    Compositor::IDisplay::ISurface* Headless::Create(const std::string& name, const uint32_t width, const uint32_t height, ISurface::ICallback* callback)
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_adminLock);
+
+        ISurface* result(nullptr);
+
+        // One surface, the render only ever creates one.
+        if (_surface == nullptr) {
+            _surface = new Surface(*this, name, width, height, callback);
+            result = _surface;
+        } else {
+            TRACE(Trace::Error, ("Headless display %s already has a surface", _name.c_str()));
+        }
+
+        return (result);
+    }
+
+    void Headless::Detach(const Surface* surface)
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_adminLock);
+
+        if (_surface == surface) {
+            _surface = nullptr;
+        }
+    }
+
+} // namespace Graphics
+} // namespace Thunder
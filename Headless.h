@@ -0,0 +1,192 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include <EGL/egl.h>
+
+#include <compositor/Client.h>
+
+#include <atomic>
+
+namespace Thunder {
+namespace Graphics {
+    // Stand-in for the compositor, so the render path runs without one, e.g.
+    // on a build host with Mesa llvmpipe. The surface has no native window,
+    // the render draws into a pbuffer. Published() is fired on a simulated
+    // vsync for every refresh period that had a RequestRender().
+    class Headless : public Compositor::IDisplay {
+    private:
+        class Surface : public Compositor::IDisplay::ISurface {
+        private:
+            class VSync : public Core::Thread {
+            public:
+                VSync() = delete;
+                VSync(const VSync&) = delete;
+                VSync& operator=(const VSync&) = delete;
+
+                VSync(Surface& parent)
+                    : Core::Thread(Core::Thread::DefaultStackSize(), _T("HeadlessVSync"))
+                    , _parent(parent)
+                    , _next(0)
+                {
+                }
+                ~VSync() override
+                {
+                    Stop();
+                    Wait(Core::Thread::STOPPED, Core::infinite);
+                }
+
+                uint32_t Worker() override;
+
+            private:
+                Surface& _parent;
+                uint64_t _next; // us
+            };
+
+        public:
+            Surface() = delete;
+            Surface(const Surface&) = delete;
+            Surface& operator=(const Surface&) = delete;
+
+            Surface(Headless& display, const std::string& name, const uint32_t width, const uint32_t height, ICallback* callback);
+            ~Surface() override;
+
+        public:
+            void AddRef() const override
+            {
+                _refCount++;
+            }
+            uint32_t Release() const override;
+
+            EGLNativeWindowType Native() const override
+            {
+                return (static_cast<EGLNativeWindowType>(0));
+            }
+            std::string Name() const override
+            {
+                return (_name);
+            }
+
+            void Keyboard(IKeyboard*) override
+            {
+            }
+            void Pointer(IPointer*) override
+            {
+            }
+            void Wheel(IWheel*) override
+            {
+            }
+            void TouchPanel(ITouchPanel*) override
+            {
+            }
+
+            int32_t Width() const override
+            {
+                return (_width);
+            }
+            int32_t Height() const override
+            {
+                return (_height);
+            }
+
+            void RequestRender() override
+            {
+                _requested = true;
+            }
+
+        private:
+            void Refresh();
+
+        private:
+            mutable std::atomic<uint32_t> _refCount;
+            Headless& _display;
+            const std::string _name;
+            const int32_t _width;
+            const int32_t _height;
+            ICallback* _callback;
+            std::atomic<bool> _requested;
+            VSync _vsync;
+        };
+
+    public:
+        Headless() = delete;
+        Headless(const Headless&) = delete;
+        Headless& operator=(const Headless&) = delete;
+
+        ~Headless() override = default;
+
+        // Refresh rate of the simulated display in Hz.
+        static Compositor::IDisplay* Instance(const std::string& name, const uint16_t refresh);
+
+        // Surfaceless platform display when Mesa offers it, the default display otherwise.
+        static EGLDisplay Platform();
+
+    private:
+        Headless(const std::string& name, const uint16_t refresh);
+
+    public:
+        void AddRef() const override
+        {
+            _refCount++;
+        }
+        uint32_t Release() const override;
+
+        EGLNativeDisplayType Native() const override
+        {
+            return (EGL_DEFAULT_DISPLAY);
+        }
+        const std::string& Name() const override
+        {
+            return (_name);
+        }
+        int Process(const uint32_t) override
+        {
+            return (0);
+        }
+        int FileDescriptor() const override
+        {
+            return (-1);
+        }
+
+        ISurface* SurfaceByName(const std::string& name) override;
+        ISurface* Create(const std::string& name, const uint32_t width, const uint32_t height, ISurface::ICallback* callback = nullptr) override;
+
+        // Simulated refresh period in us.
+        uint32_t Period() const
+        {
+            return (_period);
+        }
+
+    private:
+        friend class Surface;
+        void Detach(const Surface* surface);
+
+    private:
+        mutable std::atomic<uint32_t> _refCount;
+        Core::CriticalSection _adminLock;
+        const std::string _name;
+        const uint32_t _period;
+        Surface* _surface;
+    }; // class Headless
+
+} // namespace Graphics
+} // namespace Thunder
@@ -0,0 +1,127 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+
+namespace Thunder {
+namespace Graphics {
+    // Cumulative histogram of durations in us with fixed bucket bounds, as
+    // used by Prometheus. Observing is a few relaxed atomic increments, so
+    // any thread can record while another one writes it out.
+    class Histogram {
+    public:
+        enum scale : uint8_t {
+            FRAME, // 1ms..1s, for frame timings
+            LATENCY // 1ms..10s, for operations like Show()
+        };
+
+    public:
+        Histogram() = delete;
+        Histogram(const Histogram&) = delete;
+        Histogram& operator=(const Histogram&) = delete;
+
+        Histogram(const scale buckets)
+            : _bounds(Bounds(buckets))
+            , _buckets()
+            , _observations(0)
+            , _sum(0)
+        {
+        }
+        ~Histogram() = default;
+
+    public:
+        void Observe(const uint32_t duration)
+        {
+            uint8_t index(0);
+
+            while ((index < Buckets) && (duration > _bounds[index])) {
+                ++index;
+            }
+
+            // Past the last bound only counts for +Inf.
+            if (index < Buckets) {
+                _buckets[index].fetch_add(1, std::memory_order_relaxed);
+            }
+
+            _sum.fetch_add(duration, std::memory_order_relaxed);
+            _observations.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        uint64_t Count() const
+        {
+            return (_observations.load(std::memory_order_relaxed));
+        }
+
+        // Appends it in the Prometheus text format, durations in seconds. The
+        // string keeps its capacity between calls, so it only grows once.
+        void Write(string& output, const char* name, const char* help) const
+        {
+            char line[160];
+
+            Append(output, line, snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s histogram\n", name, help, name));
+
+            uint64_t cumulative(0);
+
+            for (uint8_t index = 0; index < Buckets; ++index) {
+                cumulative += _buckets[index].load(std::memory_order_relaxed);
+
+                Append(output, line, snprintf(line, sizeof(line), "%s_bucket{le=\"%g\"} %llu\n", name, _bounds[index] / 1000000.0, static_cast<unsigned long long>(cumulative)));
+            }
+
+            // Read last, so no bucket is ever above the total.
+            const uint64_t observations(std::max(_observations.load(std::memory_order_relaxed), cumulative));
+
+            Append(output, line, snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.6f\n%s_count %llu\n", name, static_cast<unsigned long long>(observations), name, _sum.load(std::memory_order_relaxed) / 1000000.0, name, static_cast<unsigned long long>(observations)));
+        }
+
+        // A line snprintf() had to truncate is appended as far as it got.
+        template <size_t N>
+        static void Append(string& output, const char (&line)[N], const int length)
+        {
+            if (length > 0) {
+                output.append(line, std::min(static_cast<size_t>(length), N - 1));
+            }
+        }
+
+    private:
+        static constexpr uint8_t Buckets = 12;
+
+        // Upper bounds in us.
+        static const uint32_t* Bounds(const scale buckets)
+        {
+            static const uint32_t frame[Buckets] = { 1000, 2000, 4000, 8000, 12000, 16667, 20000, 33333, 50000, 100000, 250000, 1000000 };
+            static const uint32_t latency[Buckets] = { 1000, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000 };
+
+            return ((buckets == FRAME) ? frame : latency);
+        }
+
+        const uint32_t* _bounds;
+        std::atomic<uint64_t> _buckets[Buckets];
+        std::atomic<uint64_t> _observations;
+        std::atomic<uint64_t> _sum; // us
+    }; // class Histogram
+
+} // namespace Graphics
+} // namespace Thunder
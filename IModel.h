@@ -12,7 +12,7 @@ namespace Graphics {
         ModelConfig(const ModelConfig& copy)
             : Core::JSON::Container()
             , X(copy.X)
-            , Y(copy.X)
+            , Y(copy.Y)
             , Z(copy.Z)
             , Height(copy.Height)
             , Width(copy.Width)
@@ -20,6 +20,12 @@ namespace Graphics {
             , VertexShaderFile(copy.VertexShaderFile)
             , FragmentShaderSource(copy.FragmentShaderSource)
             , FragmentShaderFile(copy.FragmentShaderFile)
+            , VertexShader(copy.VertexShader)
+            , FragmentShader(copy.FragmentShader)
+            , RenderScale(copy.RenderScale)
+            , Defines(copy.Defines)
+            , Quality(copy.Quality)
+            , Rate(copy.Rate)
         {
             Add(_T("x"), &X);
             Add(_T("y"), &Y);
@@ -30,6 +36,12 @@ namespace Graphics {
             Add(_T("vertexsource"), &VertexShaderSource);
             Add(_T("fragmentfile"), &FragmentShaderFile);
             Add(_T("fragmentsource"), &FragmentShaderSource);
+            Add(_T("vertexshader"), &VertexShader);
+            Add(_T("fragmentshader"), &FragmentShader);
+            Add(_T("renderscale"), &RenderScale);
+            Add(_T("defines"), &Defines);
+            Add(_T("quality"), &Quality);
+            Add(_T("rate"), &Rate);
         }
 
         ModelConfig& operator=(const ModelConfig& RHS)
@@ -41,8 +53,14 @@ namespace Graphics {
             Width = RHS.Width;
             VertexShaderSource = RHS.VertexShaderSource;
             VertexShaderFile = RHS.VertexShaderFile;
-            FragmentShaderSource = RHS.VertexShaderSource;
+            FragmentShaderSource = RHS.FragmentShaderSource;
             FragmentShaderFile = RHS.FragmentShaderFile;
+            VertexShader = RHS.VertexShader;
+            FragmentShader = RHS.FragmentShader;
+            RenderScale = RHS.RenderScale;
+            Defines = RHS.Defines;
+            Quality = RHS.Quality;
+            Rate = RHS.Rate;
 
             return (*this);
         }
@@ -58,6 +76,12 @@ namespace Graphics {
             , VertexShaderFile()
             , FragmentShaderSource()
             , FragmentShaderFile()
+            , VertexShader()
+            , FragmentShader()
+            , RenderScale(1.0)
+            , Defines()
+            , Quality(0)
+            , Rate(0)
         {
             Add(_T("x"), &X);
             Add(_T("y"), &Y);
@@ -68,6 +92,12 @@ namespace Graphics {
             Add(_T("vertexsource"), &VertexShaderSource);
             Add(_T("fragmentfile"), &FragmentShaderFile);
             Add(_T("fragmentsource"), &FragmentShaderSource);
+            Add(_T("vertexshader"), &VertexShader);
+            Add(_T("fragmentshader"), &FragmentShader);
+            Add(_T("renderscale"), &RenderScale);
+            Add(_T("defines"), &Defines);
+            Add(_T("quality"), &Quality);
+            Add(_T("rate"), &Rate);
         }
 
         virtual ~ModelConfig()
@@ -84,6 +114,12 @@ namespace Graphics {
         Core::JSON::String VertexShaderFile;
         Core::JSON::String FragmentShaderSource;
         Core::JSON::String FragmentShaderFile;
+        Core::JSON::String VertexShader; // name in shaders/, embedded or read from the data path
+        Core::JSON::String FragmentShader;
+        Core::JSON::Float RenderScale; // fraction of width and height to render at, upscaled to the window
+        Core::JSON::ArrayType<Core::JSON::String> Defines; // "NAME" or "NAME=VALUE", put in front of both shaders
+        Core::JSON::DecUInt8 Quality; // QUALITY of the shaders, 0 - 3
+        Core::JSON::DecUInt16 Rate; // fps the output changes at, 0 for a still image; unset follows u_time
     };
 
     typedef struct Size {
@@ -121,7 +157,17 @@ namespace Graphics {
         uint16_t Z;
     } DimensionType;
 
+    // Box of the surface a model may touch, lower left origin as glScissor.
+    typedef struct Scissor {
+        int32_t X;
+        int32_t Y;
+        int32_t Width;
+        int32_t Height;
+    } ScissorType;
+
     struct EXTERNAL IModel {
+        static constexpr uint16_t Continuous = 0xFFFF; // changes every frame
+
         static Core::ProxyType<IModel> Create(const ModelConfig& config);
 
         virtual ~IModel() = default;
@@ -131,11 +177,26 @@ namespace Graphics {
         virtual bool Construct() = 0;
         virtual bool Destroy() = 0;
 
-        virtual void Process() = 0;
+        // Called on a context sharing objects with the render context ahead of
+        // Construct(), to start the expensive work like compiling programs.
+        virtual void Prepare() = 0;
+
+        // Draws one frame into each of the boxes, the frame itself is only
+        // rendered once. Without boxes the scissor is left as it is.
+        virtual void Process(const uint8_t count, const ScissorType boxes[]) = 0;
 
         virtual void Position(const DimensionType& dimension) = 0;
         virtual void Size(const SizeType& size) = 0;
         virtual void Opacity(const uint8_t opacity) = 0;
+        // Factor on the configured render scale, e.g. from dynamic resolution.
+        virtual void Scale(const float scale) = 0;
+
+        // Approximate GPU memory held while constructed, in bytes.
+        virtual uint32_t Footprint() const = 0;
+
+        // Frames per second the output changes at by itself, 0 if it only
+        // changes with the calls above, Continuous if it changes every frame.
+        virtual uint16_t Rate() const = 0;
     };
 } // namespace Graphics
 } // namespace Thunder
\ No newline at end of file
@@ -0,0 +1,186 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace Thunder {
+namespace Graphics {
+    // Tracks the frames that are swapped but not yet Published() by the
+    // compositor. Waits are always bounded, a frame that is not published
+    // within the timeout is given up on and counted as missed.
+    class PresentQueue {
+    public:
+        enum mode : uint8_t {
+            BLOCKING, // wait for Published() right after every swap
+            PIPELINED // record the next frame while up to depth frames are in flight
+        };
+
+        static constexpr uint8_t MaxDepth = 3;
+
+    public:
+        PresentQueue(const PresentQueue&) = delete;
+        PresentQueue& operator=(const PresentQueue&) = delete;
+
+        PresentQueue()
+            : _lock()
+            , _published()
+            , _mode(BLOCKING)
+            , _depth(1)
+            , _timeout(100)
+            , _pending(0)
+            , _abandoned(0)
+            , _abandonedAt()
+            , _missed(0)
+            , _late(0)
+        {
+        }
+        ~PresentQueue() = default;
+
+    public:
+        void Configure(const mode presentMode, const uint8_t depth, const uint32_t timeoutMs)
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+
+            _mode = presentMode;
+            _depth = (presentMode == BLOCKING) ? 1 : std::max(depth, static_cast<uint8_t>(2));
+
+            if (_depth > MaxDepth) {
+                _depth = MaxDepth;
+            }
+            _timeout = timeoutMs;
+        }
+
+        // Backpressure before a frame is recorded, returns false if a slot was
+        // only freed by giving up on a frame.
+        bool Acquire()
+        {
+            bool result(true);
+
+            if (_mode == PIPELINED) {
+                std::unique_lock<std::mutex> lock(_lock);
+                result = Wait(lock, _depth);
+            }
+
+            return (result);
+        }
+
+        // A frame has been swapped and handed to the compositor.
+        bool Submit()
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+
+            ++_pending;
+
+            return ((_mode == BLOCKING) ? Wait(lock, 1) : true);
+        }
+
+        void Published()
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+
+            // A frame given up on more than a timeout ago is not coming back anymore,
+            // so do not let it swallow the publish of a frame still pending.
+            if ((_abandoned > 0) && ((std::chrono::steady_clock::now() - _abandonedAt) > std::chrono::milliseconds(_timeout))) {
+                _abandoned = 0;
+            }
+
+            // Published in order, an abandoned frame is older than any pending one.
+            if (_abandoned > 0) {
+                --_abandoned;
+                ++_late;
+            } else if (_pending > 0) {
+                --_pending;
+            }
+
+            _published.notify_all();
+        }
+
+        // Forget about all frames in flight, e.g. when the surface is hidden.
+        void Reset()
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+
+            _pending = 0;
+            _abandoned = 0;
+
+            _published.notify_all();
+        }
+
+        mode Mode() const
+        {
+            return (_mode);
+        }
+        uint8_t Depth() const
+        {
+            return (_depth);
+        }
+        uint8_t Pending() const
+        {
+            return (_pending);
+        }
+        uint32_t Missed() const
+        {
+            return (_missed);
+        }
+        uint32_t Late() const
+        {
+            return (_late);
+        }
+
+    private:
+        bool Wait(std::unique_lock<std::mutex>& lock, const uint8_t limit)
+        {
+            bool result(true);
+
+            if (_published.wait_for(lock, std::chrono::milliseconds(_timeout), [this, limit]() { return (_pending < limit); }) == false) {
+                // The compositor did not publish in time, assume the oldest frame got lost.
+                --_pending;
+                ++_abandoned;
+                ++_missed;
+                _abandonedAt = std::chrono::steady_clock::now();
+                result = false;
+            }
+
+            return (result);
+        }
+
+    private:
+        std::mutex _lock;
+        std::condition_variable _published;
+
+        mode _mode;
+        uint8_t _depth;
+        uint32_t _timeout;
+
+        uint8_t _pending;
+        uint32_t _abandoned;
+        std::chrono::steady_clock::time_point _abandonedAt;
+        uint32_t _missed;
+        uint32_t _late;
+    }; // class PresentQueue
+
+} // namespace Graphics
+} // namespace Thunder
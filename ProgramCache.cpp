@@ -0,0 +1,408 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ProgramCache.h"
+
+#include "AtomicFile.h"
+#include "EGLToolbox.h"
+#include "Tracing.h"
+
+#include <EGL/egl.h>
+
+#include <algorithm>
+#include <string.h>
+
+namespace Thunder {
+namespace Graphics {
+    namespace {
+        constexpr uint32_t Magic = 0x42505354; // "TSPB"
+
+        struct Header {
+            uint32_t magic;
+            uint32_t format;
+            uint32_t length;
+        };
+
+        uint64_t Ticks() // in us
+        {
+            return (Core::Time::Now().Ticks());
+        }
+
+        string GLString(const GLenum name)
+        {
+            const char* value(reinterpret_cast<const char*>(glGetString(name)));
+
+            return ((value != nullptr) ? string(value) : string());
+        }
+    }
+
+    ProgramCache::ProgramCache()
+        : _lock()
+        , _path()
+        , _probed(false)
+        , _getProgramBinary(nullptr)
+        , _programBinary(nullptr)
+        , _maxShaderCompilerThreads(nullptr)
+        , _resident()
+        , _pending()
+        , _hits(0)
+        , _misses(0)
+        , _rejected(0)
+        , _precompiled(0)
+        , _loadTime(0)
+        , _compileTime(0)
+        , _linkTime(0)
+    {
+    }
+
+    void ProgramCache::Configure(const string& path)
+    {
+        _path = path;
+
+        if ((_path.empty() == false) && (Core::Directory(_path.c_str()).CreatePath() == false)) {
+            TRACE(Trace::Error, ("Could not create program cache %s", _path.c_str()));
+            _path.clear();
+        }
+    }
+
+    bool ProgramCache::Binaries()
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+
+        if (_probed == false) {
+            const char* extensions(reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS)));
+            GLint formats(0);
+
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+
+            if ((extensions != nullptr) && (strstr(extensions, "GL_OES_get_program_binary") != nullptr) && (formats > 0)) {
+                _getProgramBinary = reinterpret_cast<PFNGLGETPROGRAMBINARYOESPROC>(eglGetProcAddress("glGetProgramBinaryOES"));
+                _programBinary = reinterpret_cast<PFNGLPROGRAMBINARYOESPROC>(eglGetProcAddress("glProgramBinaryOES"));
+
+                if (_getProgramBinary == nullptr) {
+                    _programBinary = nullptr;
+                }
+            }
+
+            if ((extensions != nullptr) && (strstr(extensions, "GL_KHR_parallel_shader_compile") != nullptr)) {
+                _maxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(eglGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+            }
+
+            _probed = true;
+        }
+
+        return (_programBinary != nullptr);
+    }
+
+    bool ProgramCache::IsSupported()
+    {
+        if ((_path.empty() == false) && (Binaries() == false)) {
+            TRACE(Trace::Information, ("Program binaries not supported, program cache disabled"));
+            _path.clear();
+        }
+
+        return (_path.empty() == false);
+    }
+
+    uint32_t ProgramCache::Footprint(const GLuint program)
+    {
+        GLint length(0);
+
+        if ((program != GL_FALSE) && (Binaries() == true)) {
+            glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+        }
+
+        return (static_cast<uint32_t>(length));
+    }
+
+    uint64_t ProgramCache::Key(const string& vertexSource, const string& fragmentSource, const Attributes& attributes) const
+    {
+        // A driver update changes the renderer/version strings and so invalidates all entries.
+        uint64_t key(Hash(GLString(GL_RENDERER)));
+        key = Hash(GLString(GL_VERSION), key);
+        key = Hash(vertexSource, key);
+        key = Hash(fragmentSource, key);
+
+        for (const auto& attribute : attributes) {
+            key = Hash(std::to_string(attribute.first) + attribute.second, key);
+        }
+
+        return (key);
+    }
+
+    string ProgramCache::FileName(const uint64_t key) const
+    {
+        char name[24];
+
+        snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+
+        return (_path + name);
+    }
+
+    GLuint ProgramCache::Load(const uint64_t key)
+    {
+        GLuint program(GL_FALSE);
+
+        Core::File file(FileName(key));
+
+        if ((file.Exists() == true) && (file.Open(true) == true)) {
+            Header header;
+            const uint64_t size(file.Size());
+
+            if ((size > sizeof(header))
+                && (file.Read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header))
+                && (header.magic == Magic)
+                && (header.length == (size - sizeof(header)))) {
+
+                std::vector<uint8_t> binary(header.length);
+
+                if (file.Read(binary.data(), header.length) == header.length) {
+                    GLint status(GL_FALSE);
+
+                    program = glCreateProgram();
+
+                    _programBinary(program, header.format, binary.data(), header.length);
+
+                    glGetProgramiv(program, GL_LINK_STATUS, &status);
+
+                    if (status == GL_FALSE) {
+                        glDeleteProgram(program);
+                        program = GL_FALSE;
+                    }
+                }
+            }
+
+            file.Close();
+
+            if (program == GL_FALSE) {
+                // Stale or corrupt, it will be replaced after the compile.
+                ++_rejected;
+                file.Destroy();
+                TRACE(Trace::Information, ("Program binary %016llx rejected", static_cast<unsigned long long>(key)));
+            }
+        }
+
+        return (program);
+    }
+
+    void ProgramCache::Store(const uint64_t key, const GLuint program)
+    {
+        GLint length(0);
+
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+
+        if (length > 0) {
+            // The header goes in front of the binary, written in one go.
+            std::vector<uint8_t> binary(sizeof(Header) + length);
+            GLenum format(0);
+            GLsizei written(0);
+
+            _getProgramBinary(program, length, &written, &format, binary.data() + sizeof(Header));
+
+            if (written > 0) {
+                const Header header = { Magic, format, static_cast<uint32_t>(written) };
+                const string name(FileName(key));
+
+                memcpy(binary.data(), &header, sizeof(header));
+
+                if (WriteAtomic(name, binary.data(), static_cast<uint32_t>(sizeof(header) + header.length)) == false) {
+                    TRACE(Trace::Error, ("Could not store program binary %s", name.c_str()));
+                }
+            }
+        }
+    }
+
+    void ProgramCache::Precompile(const string& vertexSource, const string& fragmentSource, const Attributes& attributes)
+    {
+        const bool cached(IsSupported());
+        const uint64_t key(Key(vertexSource, fragmentSource, attributes));
+
+        _lock.Lock();
+        const bool resident(_resident.find(key) != _resident.end());
+        _lock.Unlock();
+
+        // Models can share a program (e.g. the blit), it is only compiled once.
+        const bool pending(std::any_of(_pending.begin(), _pending.end(), [key](const Pending& entry) { return (entry.Key == key); }));
+
+        if ((resident == false) && (pending == false)) {
+            const uint64_t start(Ticks());
+
+            GLuint program((cached == true) ? Load(key) : GL_FALSE);
+
+            if (program != GL_FALSE) {
+                ++_hits;
+                _loadTime += (Ticks() - start);
+
+                Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+
+                if (_resident.emplace(key, program).second == false) {
+                    EGL::DeleteProgram(program);
+                }
+            } else {
+                if ((_pending.empty() == true) && (_maxShaderCompilerThreads != nullptr)) {
+                    // Per context, let the driver compile everything queued below concurrently.
+                    _maxShaderCompilerThreads(0xFFFFFFFF);
+                }
+
+                const char* sources[] = { vertexSource.c_str(), fragmentSource.c_str() };
+                const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+
+                program = glCreateProgram();
+
+                // No status queries until Complete(), they would wait for the compiler.
+                for (uint8_t index = 0; index < 2; index++) {
+                    GLuint shader(glCreateShader(types[index]));
+
+                    glShaderSource(shader, 1, &sources[index], nullptr);
+                    glCompileShader(shader);
+                    glAttachShader(program, shader);
+                }
+
+                for (const auto& attribute : attributes) {
+                    glBindAttribLocation(program, attribute.first, attribute.second.c_str());
+                }
+
+                glLinkProgram(program);
+
+                _pending.push_back({ key, program, start });
+            }
+        }
+    }
+
+    void ProgramCache::Complete()
+    {
+        const bool cached(IsSupported());
+
+        for (const Pending& pending : _pending) {
+            GLint status(GL_FALSE);
+
+            glGetProgramiv(pending.Program, GL_LINK_STATUS, &status);
+
+            if (status == GL_TRUE) {
+                const uint32_t duration(static_cast<uint32_t>(Ticks() - pending.Start));
+
+                ++_misses;
+                _compileTime += duration;
+
+                TRACE(Trace::Information, ("Program %016llx precompiled in %d.%03dms", static_cast<unsigned long long>(pending.Key), duration / 1000, duration % 1000));
+
+                if (cached == true) {
+                    Store(pending.Key, pending.Program);
+                }
+
+                Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+
+                if (_resident.emplace(pending.Key, pending.Program).second == false) {
+                    EGL::DeleteProgram(pending.Program);
+                }
+            } else {
+                TRACE(Trace::Error, ("Program %016llx precompile failed: %s", static_cast<unsigned long long>(pending.Key), EGL::ProgramInfoLog(pending.Program).c_str()));
+                EGL::DeleteProgram(pending.Program);
+            }
+        }
+
+        _pending.clear();
+
+        // Make the programs visible to the other contexts of the share group.
+        glFlush();
+    }
+
+    void ProgramCache::Release()
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+
+        for (const auto& entry : _resident) {
+            EGL::DeleteProgram(entry.second);
+        }
+
+        _resident.clear();
+    }
+
+    GLuint ProgramCache::Create(const string& vertexSource, const string& fragmentSource, const Attributes& attributes)
+    {
+        GLuint program(GL_FALSE);
+
+        const bool cached(IsSupported());
+        const uint64_t key(Key(vertexSource, fragmentSource, attributes));
+
+        _lock.Lock();
+
+        std::map<uint64_t, GLuint>::iterator index(_resident.find(key));
+
+        if (index != _resident.end()) {
+            program = index->second;
+            _resident.erase(index);
+            ++_precompiled;
+        }
+
+        _lock.Unlock();
+
+        if (program != GL_FALSE) {
+            TRACE(Trace::Information, ("Program %016llx precompiled [hits=%d misses=%d rejected=%d]", static_cast<unsigned long long>(key), Hits(), Misses(), Rejected()));
+        } else if (cached == true) {
+            const uint64_t start(Ticks());
+
+            program = Load(key);
+
+            if (program != GL_FALSE) {
+                const uint32_t duration(static_cast<uint32_t>(Ticks() - start));
+
+                ++_hits;
+                _loadTime += duration;
+
+                TRACE(Trace::Information, ("Program %016llx loaded in %d.%03dms [hits=%d misses=%d rejected=%d]", static_cast<unsigned long long>(key), duration / 1000, duration % 1000, Hits(), Misses(), Rejected()));
+            }
+        }
+
+        if (program == GL_FALSE) {
+            const uint64_t start(Ticks());
+
+            program = EGL::CreateProgram(vertexSource, fragmentSource);
+
+            const uint64_t compiled(Ticks());
+
+            if (program != GL_FALSE) {
+                for (const auto& attribute : attributes) {
+                    glBindAttribLocation(program, attribute.first, attribute.second.c_str());
+                }
+
+                if (EGL::LinkProgram(program) == GL_TRUE) {
+                    const uint64_t linked(Ticks());
+
+                    ++_misses;
+                    _compileTime += (compiled - start);
+                    _linkTime += (linked - compiled);
+
+                    TRACE(Trace::Information, ("Program %016llx compiled in %d.%03dms, linked in %d.%03dms [hits=%d misses=%d rejected=%d]", static_cast<unsigned long long>(key), static_cast<uint32_t>(compiled - start) / 1000, static_cast<uint32_t>(compiled - start) % 1000, static_cast<uint32_t>(linked - compiled) / 1000, static_cast<uint32_t>(linked - compiled) % 1000, Hits(), Misses(), Rejected()));
+
+                    if (cached == true) {
+                        Store(key, program);
+                    }
+                } else {
+                    EGL::DeleteProgram(program);
+                    program = GL_FALSE;
+                }
+            }
+        }
+
+        return (program);
+    }
+
+} // namespace Graphics
+} // namespace Thunder
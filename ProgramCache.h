@@ -0,0 +1,158 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#ifndef GL_ES_VERSION_2_0
+#include <GLES2/gl2.h>
+#endif
+#include <GLES2/gl2ext.h>
+
+#include <atomic>
+#include <map>
+#include <vector>
+
+namespace Thunder {
+namespace Graphics {
+    // Creates linked GL programs, using GL_OES_get_program_binary to store
+    // them under a persistent path. Entries are keyed by a hash of the shader
+    // sources, the attribute bindings and the GL_RENDERER/GL_VERSION strings,
+    // a binary rejected by the driver falls back to a full compile.
+    // Programs can also be built ahead on a context of the same share group,
+    // Create() then hands out the precompiled program.
+    class EXTERNAL ProgramCache {
+    public:
+        typedef std::vector<std::pair<GLuint, string>> Attributes;
+
+    private:
+        friend Core::SingletonType<ProgramCache>;
+        ProgramCache();
+
+    public:
+        ProgramCache(const ProgramCache&) = delete;
+        ProgramCache& operator=(const ProgramCache&) = delete;
+        ~ProgramCache() = default;
+
+        static ProgramCache& Instance()
+        {
+            return (Core::SingletonType<ProgramCache>::Instance());
+        }
+
+        // FNV-1a, stable across builds and platforms.
+        static uint64_t Hash(const string& data, const uint64_t seed = 0xcbf29ce484222325ULL)
+        {
+            uint64_t hash(seed);
+
+            for (const char c : data) {
+                hash ^= static_cast<uint8_t>(c);
+                hash *= 0x100000001b3ULL;
+            }
+
+            return (hash);
+        }
+
+    public:
+        // An empty path disables the persistent cache.
+        void Configure(const string& path);
+
+        // Needs a current context, returns a linked program or GL_FALSE.
+        GLuint Create(const string& vertexSource, const string& fragmentSource, const Attributes& attributes);
+
+        // Size of the linked program binary in bytes, 0 if it can not be queried.
+        uint32_t Footprint(const GLuint program);
+
+        // Needs a current context sharing objects with the render context. Starts
+        // building the program without waiting for it, Complete() collects all.
+        void Precompile(const string& vertexSource, const string& fragmentSource, const Attributes& attributes);
+        void Complete();
+
+        // Deletes the precompiled programs nobody claimed, needs a context of the share group.
+        void Release();
+
+        uint32_t Hits() const
+        {
+            return (_hits);
+        }
+        uint32_t Misses() const
+        {
+            return (_misses);
+        }
+        uint32_t Rejected() const
+        {
+            return (_rejected);
+        }
+        uint32_t Precompiled() const
+        {
+            return (_precompiled);
+        }
+        // Accumulated times in us.
+        uint64_t LoadTime() const
+        {
+            return (_loadTime);
+        }
+        uint64_t CompileTime() const
+        {
+            return (_compileTime);
+        }
+        uint64_t LinkTime() const
+        {
+            return (_linkTime);
+        }
+
+    private:
+        struct Pending {
+            uint64_t Key;
+            GLuint Program;
+            uint64_t Start;
+        };
+
+        bool Binaries();
+        bool IsSupported();
+        uint64_t Key(const string& vertexSource, const string& fragmentSource, const Attributes& attributes) const;
+        string FileName(const uint64_t key) const;
+
+        GLuint Load(const uint64_t key);
+        void Store(const uint64_t key, const GLuint program);
+
+    private:
+        Core::CriticalSection _lock;
+
+        string _path;
+        bool _probed;
+
+        PFNGLGETPROGRAMBINARYOESPROC _getProgramBinary;
+        PFNGLPROGRAMBINARYOESPROC _programBinary;
+        PFNGLMAXSHADERCOMPILERTHREADSKHRPROC _maxShaderCompilerThreads;
+
+        std::map<uint64_t, GLuint> _resident; // precompiled, not yet claimed
+        std::vector<Pending> _pending; // only used by the precompiling thread
+
+        std::atomic<uint32_t> _hits;
+        std::atomic<uint32_t> _misses;
+        std::atomic<uint32_t> _rejected;
+        std::atomic<uint32_t> _precompiled;
+        std::atomic<uint64_t> _loadTime;
+        std::atomic<uint64_t> _compileTime;
+        std::atomic<uint64_t> _linkTime;
+    }; // class ProgramCache
+
+} // namespace Graphics
+} // namespace Thunder
@@ -0,0 +1,287 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Readback.h"
+
+#include "EGLToolbox.h"
+#include "Tracing.h"
+
+#include <string.h>
+
+#ifndef GL_PIXEL_PACK_BUFFER_NV
+#define GL_PIXEL_PACK_BUFFER_NV 0x88EB
+#endif
+
+#ifndef GL_MAP_READ_BIT_EXT
+#define GL_MAP_READ_BIT_EXT 0x0001
+#endif
+
+namespace Thunder {
+namespace Graphics {
+    namespace {
+        constexpr GLenum StreamRead = 0x88E1; // GL_STREAM_READ, GLES 3 only
+
+        constexpr EGLint contextAttribs[] = {
+            EGL_CONTEXT_CLIENT_VERSION, 2,
+            EGL_NONE
+        };
+
+        bool HasExtension(const char* extensions, const char* name)
+        {
+            return ((extensions != nullptr) && (strstr(extensions, name) != nullptr));
+        }
+    }
+
+    Readback::Readback()
+        : Core::Thread(Core::Thread::DefaultStackSize(), _T("ScreensaverReadback"))
+        , _display(EGL_NO_DISPLAY)
+        , _context(EGL_NO_CONTEXT)
+        , _surface(EGL_NO_SURFACE)
+        , _usage(GL_STREAM_DRAW)
+        , _slots()
+        , _head(0)
+        , _tail(0)
+        , _dropped(0)
+        , _mapBufferRange(nullptr)
+        , _unmapBuffer(nullptr)
+        , _createSync(nullptr)
+        , _clientWaitSync(nullptr)
+        , _destroySync(nullptr)
+    {
+    }
+
+    Readback::~Readback()
+    {
+        Stop();
+        Wait(Core::Thread::STOPPED, Core::infinite);
+    }
+
+    bool Readback::Initialize(EGLDisplay display, EGLConfig config, EGLContext share)
+    {
+        ASSERT(_display == EGL_NO_DISPLAY);
+
+        const char* version(reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+        const char* extensions(reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS)));
+        const char* eglExtensions(eglQueryString(display, EGL_EXTENSIONS));
+
+        _display = display;
+
+        if ((version != nullptr) && (strncmp(version, "OpenGL ES 3", 11) == 0)) {
+            _mapBufferRange = reinterpret_cast<PFNGLMAPBUFFERRANGEEXTPROC>(eglGetProcAddress("glMapBufferRange"));
+            _unmapBuffer = reinterpret_cast<PFNGLUNMAPBUFFEROESPROC>(eglGetProcAddress("glUnmapBuffer"));
+            _usage = StreamRead;
+        } else if ((HasExtension(extensions, "GL_NV_pixel_buffer_object") == true) && (HasExtension(extensions, "GL_EXT_map_buffer_range") == true)) {
+            _mapBufferRange = reinterpret_cast<PFNGLMAPBUFFERRANGEEXTPROC>(eglGetProcAddress("glMapBufferRangeEXT"));
+            _unmapBuffer = reinterpret_cast<PFNGLUNMAPBUFFEROESPROC>(eglGetProcAddress("glUnmapBufferOES"));
+        }
+
+        if (HasExtension(eglExtensions, "EGL_KHR_fence_sync") == true) {
+            _createSync = reinterpret_cast<PFNEGLCREATESYNCKHRPROC>(eglGetProcAddress("eglCreateSyncKHR"));
+            _clientWaitSync = reinterpret_cast<PFNEGLCLIENTWAITSYNCKHRPROC>(eglGetProcAddress("eglClientWaitSyncKHR"));
+            _destroySync = reinterpret_cast<PFNEGLDESTROYSYNCKHRPROC>(eglGetProcAddress("eglDestroySyncKHR"));
+        }
+
+        if ((_mapBufferRange != nullptr) && (_unmapBuffer != nullptr) && (_createSync != nullptr) && (_clientWaitSync != nullptr) && (_destroySync != nullptr)) {
+            _context = eglCreateContext(_display, config, share, contextAttribs);
+
+            if ((_context != EGL_NO_CONTEXT) && (HasExtension(eglExtensions, "EGL_KHR_surfaceless_context") == false)) {
+                constexpr EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+
+                _surface = eglCreatePbufferSurface(_display, config, pbufferAttribs);
+
+                if (_surface == EGL_NO_SURFACE) {
+                    eglDestroyContext(_display, _context);
+                    _context = EGL_NO_CONTEXT;
+                }
+            }
+        }
+
+        TRACE(Trace::Information, ("Readback %s", (_context != EGL_NO_CONTEXT) ? "asynchronous, pixel buffer objects" : "synchronous"));
+
+        return (IsValid());
+    }
+
+    void Readback::Deinitialize()
+    {
+        if (IsValid() == true) {
+            Stop();
+            Wait(Core::Thread::STOPPED, Core::infinite);
+
+            for (Slot& slot : _slots) {
+                if (slot.Fence != EGL_NO_SYNC_KHR) {
+                    _destroySync(_display, slot.Fence);
+                    slot.Fence = EGL_NO_SYNC_KHR;
+                }
+
+                if (slot.Buffer != 0) {
+                    glDeleteBuffers(1, &slot.Buffer);
+                    slot.Buffer = 0;
+                    slot.Size = 0;
+                }
+
+                slot.Pixels.clear();
+                slot.Pixels.shrink_to_fit();
+                slot.State = FREE;
+            }
+
+            if (_surface != EGL_NO_SURFACE) {
+                eglDestroySurface(_display, _surface);
+                _surface = EGL_NO_SURFACE;
+            }
+
+            if (_context != EGL_NO_CONTEXT) {
+                eglDestroyContext(_display, _context);
+                _context = EGL_NO_CONTEXT;
+            }
+
+            _mapBufferRange = nullptr;
+            _unmapBuffer = nullptr;
+            _createSync = nullptr;
+            _clientWaitSync = nullptr;
+            _destroySync = nullptr;
+            _display = EGL_NO_DISPLAY;
+        }
+    }
+
+    bool Readback::Read(const int32_t x, const int32_t y, const uint16_t width, const uint16_t height, const uint32_t frame, IConsumer& consumer)
+    {
+        bool result(false);
+
+        if (IsValid() == true) {
+            Slot& slot(_slots[_head]);
+
+            if (slot.State == FREE) {
+                const uint32_t size(static_cast<uint32_t>(width) * height * 4);
+
+                if (IsAsynchronous() == true) {
+                    if (slot.Buffer == 0) {
+                        glGenBuffers(1, &slot.Buffer);
+                    }
+
+                    glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, slot.Buffer);
+
+                    if (slot.Size != size) {
+                        glBufferData(GL_PIXEL_PACK_BUFFER_NV, size, nullptr, _usage);
+                        slot.Size = size;
+                    }
+
+                    // Only queued, the data lands in the buffer when the GPU gets there.
+                    glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                    glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, 0);
+
+                    slot.Fence = _createSync(_display, EGL_SYNC_FENCE_KHR, nullptr);
+
+                    // The readback thread can only wait for commands the driver has seen.
+                    glFlush();
+                } else {
+                    slot.Pixels.resize(size);
+                    glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, slot.Pixels.data());
+                }
+
+                slot.Consumer = &consumer;
+                slot.Frame = frame;
+                slot.Width = width;
+                slot.Height = height;
+                slot.State = PENDING;
+
+                _head = (_head + 1) % Depth;
+
+                Run();
+
+                result = true;
+            } else {
+                ++_dropped;
+            }
+        }
+
+        return (result);
+    }
+
+    void Readback::Deliver(Slot& slot)
+    {
+        if (slot.Buffer != 0) {
+            if (slot.Fence != EGL_NO_SYNC_KHR) {
+                _clientWaitSync(_display, slot.Fence, 0, EGL_FOREVER_KHR);
+                _destroySync(_display, slot.Fence);
+                slot.Fence = EGL_NO_SYNC_KHR;
+            }
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, slot.Buffer);
+
+            const uint8_t* pixels(static_cast<const uint8_t*>(_mapBufferRange(GL_PIXEL_PACK_BUFFER_NV, 0, slot.Size, GL_MAP_READ_BIT_EXT)));
+
+            if (pixels != nullptr) {
+                slot.Consumer->Frame(slot.Frame, slot.Width, slot.Height, pixels);
+                _unmapBuffer(GL_PIXEL_PACK_BUFFER_NV);
+            } else {
+                TRACE(Trace::Error, ("Could not map readback of frame %d: 0x%04X", slot.Frame, glGetError()));
+                ++_dropped;
+            }
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, 0);
+        } else {
+            slot.Consumer->Frame(slot.Frame, slot.Width, slot.Height, slot.Pixels.data());
+        }
+    }
+
+    uint32_t Readback::Worker()
+    {
+        bool current(false);
+
+        while (_slots[_tail].State == PENDING) {
+            Slot& slot(_slots[_tail]);
+
+            if ((current == false) && (IsAsynchronous() == true)) {
+                current = (eglMakeCurrent(_display, _surface, _surface, _context) == EGL_TRUE);
+
+                if (current == false) {
+                    TRACE(Trace::Error, ("Unable to make readback context current error=%s", EGL::ErrorString(eglGetError())));
+                }
+            }
+
+            if ((current == true) || (slot.Buffer == 0)) {
+                Deliver(slot);
+            } else {
+                ++_dropped;
+            }
+
+            slot.State = FREE;
+            _tail = (_tail + 1) % Depth;
+        }
+
+        // Not kept between reads, so Deinitialize() can destroy it from the render thread.
+        if (current == true) {
+            eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        }
+
+        Block();
+
+        uint32_t delay(Core::infinite);
+
+        if (_slots[_tail].State == PENDING) {
+            // Issued after the loop above, its Run() may have been undone by the Block().
+            Run();
+            delay = 0;
+        }
+
+        return (delay);
+    }
+
+} // namespace Graphics
+} // namespace Thunder
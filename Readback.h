@@ -0,0 +1,144 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#ifndef GL_ES_VERSION_2_0
+#include <GLES2/gl2.h>
+#endif
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2ext.h>
+
+#include <atomic>
+#include <vector>
+
+namespace Thunder {
+namespace Graphics {
+    // Reads frames back without stalling the render thread: glReadPixels goes
+    // into a ring of pixel buffer objects (GLES 3, or GL_NV_pixel_buffer_object
+    // with GL_EXT_map_buffer_range) followed by an EGL_KHR_fence_sync fence.
+    // A thread of its own, with a context sharing objects with the render
+    // context, waits for the fence, maps the buffer and hands the pixels to the
+    // consumer straight from the mapping. Without these the read is done on
+    // the render thread, which then waits for the GPU.
+    class Readback : public Core::Thread {
+    public:
+        static constexpr uint8_t Depth = 3; // reads in flight, more are dropped
+
+        struct EXTERNAL IConsumer {
+            virtual ~IConsumer() = default;
+
+            // On the readback thread, frame as given to Read(). RGBA, rows
+            // bottom-up, only valid during the call.
+            virtual void Frame(const uint32_t frame, const uint16_t width, const uint16_t height, const uint8_t pixels[]) = 0;
+        };
+
+    private:
+        enum state : uint8_t {
+            FREE,
+            PENDING // read issued, not yet delivered
+        };
+
+        struct Slot {
+            Slot()
+                : Buffer(0)
+                , Size(0)
+                , Pixels()
+                , Fence(EGL_NO_SYNC_KHR)
+                , Consumer(nullptr)
+                , Frame(0)
+                , Width(0)
+                , Height(0)
+                , State(FREE)
+            {
+            }
+
+            GLuint Buffer;
+            uint32_t Size; // bytes allocated for Buffer
+            std::vector<uint8_t> Pixels; // without pixel buffer objects
+            EGLSyncKHR Fence;
+            IConsumer* Consumer;
+            uint32_t Frame;
+            uint16_t Width;
+            uint16_t Height;
+            std::atomic<uint8_t> State;
+        };
+
+    public:
+        Readback(const Readback&) = delete;
+        Readback& operator=(const Readback&) = delete;
+
+        Readback();
+        ~Readback() override;
+
+    public:
+        // Needs the render context current, creates the context of the readback thread.
+        bool Initialize(EGLDisplay display, EGLConfig config, EGLContext share);
+        // Needs the render context current, undelivered reads are dropped.
+        void Deinitialize();
+
+        bool IsValid() const
+        {
+            return (_display != EGL_NO_DISPLAY);
+        }
+
+        // Reads are only asynchronous with pixel buffer objects, fences and a readback context.
+        bool IsAsynchronous() const
+        {
+            return (_context != EGL_NO_CONTEXT);
+        }
+
+        // Render thread, reads a rectangle of the bound framebuffer for the
+        // consumer. False if all buffers are still in flight, the frame is dropped.
+        bool Read(const int32_t x, const int32_t y, const uint16_t width, const uint16_t height, const uint32_t frame, IConsumer& consumer);
+
+        uint32_t Dropped() const
+        {
+            return (_dropped);
+        }
+
+        uint32_t Worker() override;
+
+    private:
+        void Deliver(Slot& slot);
+
+    private:
+        EGLDisplay _display;
+        EGLContext _context;
+        EGLSurface _surface; // EGL_NO_SURFACE if surfaceless contexts are supported
+        GLenum _usage;
+
+        Slot _slots[Depth];
+        uint8_t _head; // render thread
+        uint8_t _tail; // readback thread
+
+        std::atomic<uint32_t> _dropped;
+
+        PFNGLMAPBUFFERRANGEEXTPROC _mapBufferRange;
+        PFNGLUNMAPBUFFEROESPROC _unmapBuffer;
+        PFNEGLCREATESYNCKHRPROC _createSync;
+        PFNEGLCLIENTWAITSYNCKHRPROC _clientWaitSync;
+        PFNEGLDESTROYSYNCKHRPROC _destroySync;
+    }; // class Readback
+
+} // namespace Graphics
+} // namespace Thunder
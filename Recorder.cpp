@@ -0,0 +1,308 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Recorder.h"
+
+#include "Tracing.h"
+
+#include <string.h>
+
+ENUM_CONVERSION_BEGIN(Thunder::Graphics::Recorder::format)
+    { Thunder::Graphics::Recorder::Y4M, _TXT("y4m") },
+    { Thunder::Graphics::Recorder::RAW, _TXT("raw") },
+ENUM_CONVERSION_END(Thunder::Graphics::Recorder::format)
+
+namespace Thunder {
+namespace Graphics {
+    namespace {
+        constexpr char FrameHeader[] = "FRAME\n";
+
+        // Both loops are written for the auto-vectorizer (built with
+        // -ftree-vectorize): a unit step size_t index, no branches and
+        // non-aliasing pointers. The RGBA loads become interleaved vector loads
+        // (vld4 on NEON), the luma fits 16 bit lanes. BT.601, limited range.
+        void Luma(const uint8_t* __restrict pixels, uint8_t* __restrict luma, const size_t width)
+        {
+            for (size_t x = 0; x < width; ++x) {
+                const uint16_t r(pixels[(x * 4) + 0]);
+                const uint16_t g(pixels[(x * 4) + 1]);
+                const uint16_t b(pixels[(x * 4) + 2]);
+
+                luma[x] = static_cast<uint8_t>((static_cast<uint16_t>((66 * r) + (129 * g) + (25 * b) + 128) >> 8) + 16);
+            }
+        }
+
+        // One sample per 2x2 block, from the sum of its four pixels. The
+        // offset (128 << 10, plus rounding) keeps the sums positive.
+        void Chroma(const uint8_t* __restrict top, const uint8_t* __restrict bottom, uint8_t* __restrict u, uint8_t* __restrict v, const size_t pairs)
+        {
+            for (size_t x = 0; x < pairs; ++x) {
+                const int32_t r(top[(x * 8) + 0] + top[(x * 8) + 4] + bottom[(x * 8) + 0] + bottom[(x * 8) + 4]);
+                const int32_t g(top[(x * 8) + 1] + top[(x * 8) + 5] + bottom[(x * 8) + 1] + bottom[(x * 8) + 5]);
+                const int32_t b(top[(x * 8) + 2] + top[(x * 8) + 6] + bottom[(x * 8) + 2] + bottom[(x * 8) + 6]);
+
+                u[x] = static_cast<uint8_t>((131584 - (38 * r) - (74 * g) + (112 * b)) >> 10);
+                v[x] = static_cast<uint8_t>((131584 + (112 * r) - (94 * g) - (18 * b)) >> 10);
+            }
+        }
+    }
+
+    Recorder::Recorder()
+        : _lock()
+        , _queueLock()
+        , _file()
+        , _recording(false)
+        , _width(0)
+        , _height(0)
+        , _header(0)
+        , _buffers()
+        , _free()
+        , _queued()
+        , _scheduled(false)
+        , _flush(Core::ProxyType<Flush>::Create(*this))
+        , _frames(0)
+        , _dropped(0)
+    {
+        _free.reserve(Buffers);
+        _queued.reserve(Buffers);
+    }
+
+    Recorder::~Recorder()
+    {
+        Stop();
+    }
+
+    uint32_t Recorder::Start(const string& fileName, const format type, const uint16_t width, const uint16_t height, const uint16_t rate, const uint16_t interval)
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+
+        uint32_t result(Core::ERROR_INPROGRESS);
+
+        if (_recording == false) {
+            const uint16_t evenWidth(width & ~1);
+            const uint16_t evenHeight(height & ~1);
+
+            result = Core::ERROR_BAD_REQUEST;
+
+            if ((evenWidth != 0) && (evenHeight != 0) && (interval != 0)) {
+                const string directory(fileName.substr(0, fileName.rfind('/') + 1));
+
+                _file = Core::File(fileName);
+
+                result = Core::ERROR_OPENING_FAILED;
+
+                if (((directory.empty() == true) || (Core::Directory(directory.c_str()).CreatePath() == true)) && (_file.Create() == true)) {
+                    result = Core::ERROR_NONE;
+
+                    if (type == Y4M) {
+                        // C420jpeg: chroma sited in the centre of each 2x2 block, as averaged.
+                        const string header(_T("YUV4MPEG2 W") + std::to_string(evenWidth) + _T(" H") + std::to_string(evenHeight)
+                            + _T(" F") + std::to_string(rate) + ':' + std::to_string(interval) + _T(" Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n"));
+
+                        if (_file.Write(reinterpret_cast<const uint8_t*>(header.c_str()), static_cast<uint32_t>(header.size())) != header.size()) {
+                            result = Core::ERROR_WRITE_ERROR;
+                        }
+                    }
+                }
+
+                if (result == Core::ERROR_NONE) {
+                    const uint32_t pixels(static_cast<uint32_t>(evenWidth) * evenHeight);
+
+                    _width = evenWidth;
+                    _height = evenHeight;
+                    _header = ((type == Y4M) ? (sizeof(FrameHeader) - 1) : 0);
+
+                    _queueLock.Lock();
+
+                    _free.clear();
+                    _queued.clear();
+
+                    for (uint8_t index = 0; index < Buffers; ++index) {
+                        _buffers[index].resize(_header + pixels + (pixels / 2));
+                        memcpy(_buffers[index].data(), FrameHeader, _header);
+                        _free.push_back(index);
+                    }
+
+                    _queueLock.Unlock();
+
+                    _recording = true;
+
+                    TRACE(Trace::Information, ("Recording %dx%d %s to %s, every %d frames", _width, _height, (type == Y4M) ? "y4m" : "raw", fileName.c_str(), interval));
+                } else {
+                    TRACE(Trace::Error, ("Could not start recording to %s", fileName.c_str()));
+
+                    if (_file.IsOpen() == true) {
+                        _file.Close();
+                    }
+                }
+            }
+        }
+
+        return (result);
+    }
+
+    void Recorder::Stop()
+    {
+        _lock.Lock();
+        const bool recording(_recording);
+        _recording = false;
+        _lock.Unlock();
+
+        if (recording == true) {
+            // Waits for a dispatch in progress, what it left is written here.
+            Core::IWorkerPool::Instance().Revoke(Core::ProxyType<Core::IDispatch>(_flush), Core::infinite);
+
+            Write();
+
+            _lock.Lock();
+
+            _file.Close();
+
+            for (std::vector<uint8_t>& buffer : _buffers) {
+                buffer.clear();
+                buffer.shrink_to_fit();
+            }
+
+            _lock.Unlock();
+
+            TRACE(Trace::Information, ("Recording stopped, %d frames written, %d dropped in total", static_cast<uint32_t>(_frames), static_cast<uint32_t>(_dropped)));
+        }
+    }
+
+    void Recorder::Frame(const uint32_t frame VARIABLE_IS_NOT_USED, const uint16_t width, const uint16_t height, const uint8_t pixels[])
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+
+        if (_recording == true) {
+            uint8_t index(Buffers);
+
+            if (((width & ~1) == _width) && ((height & ~1) == _height)) {
+                _queueLock.Lock();
+
+                if (_free.empty() == false) {
+                    index = _free.back();
+                    _free.pop_back();
+                }
+
+                _queueLock.Unlock();
+            }
+
+            if (index == Buffers) {
+                // The file is behind, or the surface changed size.
+                ++_dropped;
+            } else {
+                uint8_t* y(_buffers[index].data() + _header);
+                uint8_t* u(y + (static_cast<uint32_t>(_width) * _height));
+                uint8_t* v(u + ((static_cast<uint32_t>(_width) * _height) / 4));
+
+                ConvertI420(width, height, pixels, y, u, v);
+
+                _queueLock.Lock();
+
+                _queued.push_back(index);
+
+                const bool schedule(_scheduled == false);
+                _scheduled = true;
+
+                _queueLock.Unlock();
+
+                if (schedule == true) {
+                    Core::IWorkerPool::Instance().Submit(Core::ProxyType<Core::IDispatch>(_flush));
+                }
+            }
+        }
+    }
+
+    // Worker pool, or Stop() once the dispatches are revoked. A failed write
+    // ends the recording: a partial frame shifts all frames after it.
+    void Recorder::Write()
+    {
+        std::vector<uint8_t> batch;
+        bool failed(false);
+
+        batch.reserve(Buffers);
+
+        _queueLock.Lock();
+
+        while (_queued.empty() == false) {
+            batch.swap(_queued);
+
+            _queueLock.Unlock();
+
+            for (const uint8_t index : batch) {
+                const std::vector<uint8_t>& buffer(_buffers[index]);
+
+                if ((failed == false) && (_file.Write(buffer.data(), static_cast<uint32_t>(buffer.size())) == buffer.size())) {
+                    ++_frames;
+                } else {
+                    ++_dropped;
+
+                    if (failed == false) {
+                        failed = true;
+
+                        _lock.Lock();
+
+                        // Stop() closes the file itself if it got here first.
+                        if (_recording == true) {
+                            _recording = false;
+                            _file.Close();
+
+                            TRACE(Trace::Error, ("Writing frame %d failed, recording stopped", static_cast<uint32_t>(_frames) + 1));
+                        }
+
+                        _lock.Unlock();
+                    }
+                }
+            }
+
+            _queueLock.Lock();
+
+            _free.insert(_free.end(), batch.begin(), batch.end());
+            batch.clear();
+        }
+
+        _scheduled = false;
+
+        _queueLock.Unlock();
+    }
+
+    /* static */ void Recorder::ConvertI420(const uint16_t width, const uint16_t height, const uint8_t pixels[], uint8_t y[], uint8_t u[], uint8_t v[])
+    {
+        const size_t stride(static_cast<size_t>(width) * 4);
+        const size_t columns(width & ~1);
+        const size_t pairs(columns / 2);
+        const uint16_t rows(height & ~1);
+
+        for (uint16_t row = 0; row < rows; row += 2) {
+            // Top-down, glReadPixels delivered the bottom row first.
+            const uint8_t* top(pixels + ((static_cast<size_t>(height) - 1 - row) * stride));
+            const uint8_t* bottom(top - stride);
+
+            Luma(top, y, columns);
+            Luma(bottom, y + columns, columns);
+            Chroma(top, bottom, u, v, pairs);
+
+            y += (columns * 2);
+            u += pairs;
+            v += pairs;
+        }
+    }
+
+} // namespace Graphics
+} // namespace Thunder
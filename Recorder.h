@@ -0,0 +1,125 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include "Readback.h"
+
+#include <atomic>
+#include <vector>
+
+namespace Thunder {
+namespace Graphics {
+    // Writes the frames it gets from the Readback thread to a file as I420
+    // (BT.601, limited range). The conversion runs on the readback thread,
+    // straight from the mapped buffer, into one of a few frame buffers; the
+    // file is written from the worker pool, every queued frame in one go. A
+    // frame that finds no free buffer is dropped, the render thread never
+    // waits for the disk.
+    class EXTERNAL Recorder : public Readback::IConsumer {
+    public:
+        enum format : uint8_t {
+            Y4M, // YUV4MPEG2, plays in ffplay/mpv as is
+            RAW // headerless I420 frames, rawvideo yuv420p
+        };
+
+        static constexpr uint8_t Buffers = 4; // converted frames waiting for the file
+
+    private:
+        class Flush : public Core::IDispatch {
+        public:
+            Flush(Recorder& parent)
+                : _parent(parent)
+            {
+            }
+
+            void Dispatch() override
+            {
+                _parent.Write();
+            }
+
+        private:
+            Recorder& _parent;
+        };
+
+    public:
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+
+        Recorder();
+        ~Recorder() override;
+
+    public:
+        // The size is rounded down to even, the rate is the one of the
+        // recorded frames (render rate / interval) for the Y4M header.
+        uint32_t Start(const string& fileName, const format type, const uint16_t width, const uint16_t height, const uint16_t rate, const uint16_t interval);
+        // Writes what is queued and closes the file.
+        void Stop();
+
+        // Also false once a write to the file failed, that closes it.
+        bool IsRecording() const
+        {
+            return (_recording);
+        }
+
+        // Since the construction, over all recordings.
+        uint32_t Frames() const
+        {
+            return (_frames);
+        }
+
+        uint32_t Dropped() const
+        {
+            return (_dropped);
+        }
+
+        // Readback::IConsumer
+        void Frame(const uint32_t frame, const uint16_t width, const uint16_t height, const uint8_t pixels[]) override;
+
+        // RGBA rows bottom-up, as read by glReadPixels, to top-down I420 planes
+        // of an even width and height; odd source sizes lose their last column
+        // and bottom row.
+        static void ConvertI420(const uint16_t width, const uint16_t height, const uint8_t pixels[], uint8_t y[], uint8_t u[], uint8_t v[]);
+
+    private:
+        void Write();
+
+    private:
+        Core::CriticalSection _lock; // the file and _recording, held during a conversion
+        Core::CriticalSection _queueLock; // _free, _queued and _scheduled
+        Core::File _file;
+        std::atomic<bool> _recording;
+        uint16_t _width; // even
+        uint16_t _height;
+        uint32_t _header; // bytes in front of the planes of a frame
+
+        std::vector<uint8_t> _buffers[Buffers];
+        std::vector<uint8_t> _free;
+        std::vector<uint8_t> _queued; // oldest first
+        bool _scheduled;
+        Core::ProxyType<Flush> _flush;
+
+        std::atomic<uint32_t> _frames;
+        std::atomic<uint32_t> _dropped;
+    }; // class Recorder
+
+} // namespace Graphics
+} // namespace Thunder
@@ -25,9 +25,15 @@ namespace Thunder {
 
 namespace Plugin {
     namespace {
+        namespace Version {
+            constexpr uint8_t Major = 1;
+            constexpr uint8_t Minor = 0;
+            constexpr uint8_t Patch = 0;
+        }
+
         static Metadata<Screensaver> metadata(
             // Version
-            1, 0, 0,
+            Version::Major, Version::Minor, Version::Patch,
             // Preconditions
             {},
             // Terminations
@@ -50,6 +56,30 @@ namespace Plugin {
         return rand() % max;
     }
 
+    static void WriteCounter(string& output, const char* name, const char* help, const uint64_t value)
+    {
+        char line[192];
+
+        Graphics::Histogram::Append(output, line, snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name, static_cast<unsigned long long>(value)));
+    }
+
+    static void WriteSeconds(string& output, const char* name, const char* help, const uint64_t value) // us
+    {
+        char line[192];
+
+        Graphics::Histogram::Append(output, line, snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n%s %.6f\n", name, help, name, name, value / 1000000.0));
+    }
+
+    static void WriteGauge(string& output, const char* name, const char* help, const double value)
+    {
+        char line[192];
+
+        Graphics::Histogram::Append(output, line, snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s gauge\n%s %g\n", name, help, name, name, value));
+    }
+
+    constexpr uint16_t MetricsBufferSize = 8 * 1024;
+    constexpr uint16_t ScreenshotTimeout = 2000; // ms, for the next frame and its encoding
+
     constexpr char connectorNameVirtualInput[] = "/tmp/keyhandler";
     constexpr char clientNameVirtualInput[] = "Screensaver";
 
@@ -83,14 +113,25 @@ namespace Plugin {
         : _skipURL(0)
         , _eglRender()
         , _service(nullptr)
+        , _adminLock()
+        , _triggered(false)
         , _previousFrames(0)
         , _previousTimeMS(0)
         , _interval(5000)
         , _timeOut(0)
         , _startTime(0)
+        , _warmup(0)
         , _reportFPS(false)
+        , _inputs(0)
+        , _textBodies(1)
+        , _captureLock()
+        , _screenshot()
+        , _recordLock()
+        , _recorder()
+        , _calibration()
         , _inputSink(*this)
         , _ticker(Core::ProxyType<Tick>::Create(*this))
+        , _countdown(Core::ProxyType<Countdown>::Create(*this))
         , _inputServer()
     {
     }
@@ -118,6 +159,8 @@ namespace Plugin {
 
         _interval = config.Interval.Value() * 1000;
 
+        _warmup = std::min(config.Warmup.Value(), _timeOut);
+
         _reportFPS = config.ReportFPS.Value();
 
         _inputServer.Callback(&_inputSink);
@@ -125,42 +168,40 @@ namespace Plugin {
 
         JSONRPCRegister();
 
-        if (config.Models.Length() > 0) {
-            if (_eglRender.Initialize(service->Callsign(), config.Width.Value(), config.Height.Value(), config.FPS.Value())) {
-                uint16_t index = getRandomValue(config.Models.Length()); // pick one
+        if (config.Render.ProgramCache.Value() == true) {
+            Graphics::ProgramCache::Instance().Configure(service->PersistentPath() + _T("programs/"));
+        }
 
-                TRACE(Trace::Information, ("Found %d model%s picking number %d", config.Models.Length(), (config.Models.Length() > 1) ? "s" : "", index));
+        Graphics::ShaderOptimizer::Instance().Configure(config.Render.Optimizer.Value(), (config.Render.ProgramCache.Value() == true) ? (service->PersistentPath() + _T("optimized/")) : string());
 
-                Graphics::ModelConfig current = config.Models[index];
+        if (config.Models.Length() > 0) {
+            if (_eglRender.Initialize(service->Callsign(), config.Width.Value(), config.Height.Value(), config.FPS.Value(), config.Render)) {
+                // Only measured for models not calibrated before on this renderer and plugin version.
+                _calibration.Open(service->PersistentPath() + _T("calibration.json"), _eglRender.Renderer(),
+                    std::to_string(Version::Major) + '.' + std::to_string(Version::Minor) + '.' + std::to_string(Version::Patch));
 
-                if ((config.Models[index].FragmentShaderFile.IsSet() == true) && (config.Models[index].FragmentShaderFile.Value()[0] != '/')) {
-                    current.FragmentShaderFile = service->DataPath() + "/shaders/" + config.Models[index].FragmentShaderFile.Value();
+                const bool calibrate(config.Render.Calibrate.Value());
 
-                    TRACE(Trace::Information, ("Fragment file %s", current.FragmentShaderFile.Value().c_str()));
-                }
+                if (config.Composite.Value() == true) {
+                    TRACE(Trace::Information, ("Compositing %d model%s", config.Models.Length(), (config.Models.Length() > 1) ? "s" : ""));
 
-                if ((config.Models[index].VertexShaderFile.IsSet() == true) && (config.Models[index].VertexShaderFile.Value()[0] != '/')) {
-                    current.VertexShaderFile = service->DataPath() + "/shaders/" + config.Models[index].VertexShaderFile.Value();
+                    for (uint16_t index = 0; index < config.Models.Length(); index++) {
+                        AddModel(config, config.Models[index], calibrate);
+                    }
+                } else {
+                    uint16_t index = getRandomValue(config.Models.Length()); // pick one
 
-                    TRACE(Trace::Information, ("Vertex file %s", current.VertexShaderFile.Value().c_str()));
-                }
+                    TRACE(Trace::Information, ("Found %d model%s picking number %d", config.Models.Length(), (config.Models.Length() > 1) ? "s" : "", index));
 
-                if (current.Width.Value() == 0) {
-                    current.Width = config.Width.Value();
+                    AddModel(config, config.Models[index], calibrate);
                 }
 
-                if (current.Height.Value() == 0) {
-                    current.Height = config.Height.Value();
-                }
-
-                uint32_t id = _eglRender.Add(current);
-
-                TRACE(Trace::Information, ("Added model id=%d", id));
-
                 if (config.Instant.Value() == true) {
                     _eglRender.Show();
                 }
 
+                _countdown->Start();
+
                 TRACE(Trace::Information, ("Screensaver::%s", __FUNCTION__));
             } else {
                 message = "Failed to initialize render surface.";
@@ -177,8 +218,74 @@ namespace Plugin {
         return message;
     }
 
+    uint32_t Screensaver::AddModel(const Config& config, const Graphics::ModelConfig& model, const bool calibrate)
+    {
+        ASSERT(_service != nullptr);
+
+        Graphics::ModelConfig current = model;
+
+        // A shader that is not linked in is read from the installed shaders.
+        if ((model.FragmentShader.Value().empty() == false) && (Graphics::ShaderLibrary::Find(model.FragmentShader.Value()) == nullptr)) {
+            current.FragmentShaderFile = model.FragmentShader.Value();
+        }
+
+        if ((model.VertexShader.Value().empty() == false) && (Graphics::ShaderLibrary::Find(model.VertexShader.Value()) == nullptr)) {
+            current.VertexShaderFile = model.VertexShader.Value();
+        }
+
+        if ((current.FragmentShaderFile.IsSet() == true) && (current.FragmentShaderFile.Value()[0] != '/')) {
+            current.FragmentShaderFile = _service->DataPath() + "/shaders/" + current.FragmentShaderFile.Value();
+
+            TRACE(Trace::Information, ("Fragment file %s", current.FragmentShaderFile.Value().c_str()));
+        }
+
+        if ((current.VertexShaderFile.IsSet() == true) && (current.VertexShaderFile.Value()[0] != '/')) {
+            current.VertexShaderFile = _service->DataPath() + "/shaders/" + current.VertexShaderFile.Value();
+
+            TRACE(Trace::Information, ("Vertex file %s", current.VertexShaderFile.Value().c_str()));
+        }
+
+        uint32_t id(0);
+
+        if ((current.X.Value() >= config.Width.Value()) || (current.Y.Value() >= config.Height.Value())) {
+            TRACE(Trace::Error, ("Model at %dx%d lies outside the %dwx%dh surface, not added", current.X.Value(), current.Y.Value(), config.Width.Value(), config.Height.Value()));
+        } else {
+            if (current.Width.Value() == 0) {
+                current.Width = config.Width.Value() - current.X.Value();
+            }
+
+            if (current.Height.Value() == 0) {
+                current.Height = config.Height.Value() - current.Y.Value();
+            }
+
+            // Composited models share the frame.
+            const uint32_t budget((calibrate == true) ? Graphics::Calibration::Budget(config.FPS.Value(), (config.Composite.Value() == true) ? config.Models.Length() : 1) : 0);
+            const bool measure((budget != 0) && (_calibration.Apply(current, budget) == false));
+            const Graphics::ModelConfig calibrated(current);
+
+            if (current.Quality.IsSet() == false) {
+                current.Quality = config.Render.Quality.Value();
+            }
+
+            id = _eglRender.Add(current);
+
+            TRACE(Trace::Information, ("Added model id=%d", id));
+
+            // In the background, until measured it renders at the configured quality.
+            if (measure == true) {
+                _eglRender.Calibrate(_calibration, id, calibrated, budget);
+            }
+        }
+
+        return (id);
+    }
+
     /* virtual */ void Screensaver::Deinitialize(PluginHost::IShell* service VARIABLE_IS_NOT_USED)
     {
+        _countdown->Stop();
+
+        StopRecording();
+
         _eglRender.Deinitialize();
 
         _inputServer.Disconnect();
@@ -233,6 +340,147 @@ namespace Plugin {
         return (result);
     }
 
+    Core::ProxyType<Web::Response> Screensaver::GetMethod(Core::TextSegmentIterator& index)
+    {
+        Core::ProxyType<Web::Response> result(PluginHost::IFactories::Instance().Response());
+
+        result->ErrorCode = Web::STATUS_NOT_FOUND;
+        result->Message = string(_T("Unknown request path specified."));
+
+        if ((index.IsValid() == true) && (index.Next() == true)) {
+            // GET .../Screensaver/Metrics : Prometheus text exposition format
+            if (index.Current() == _T("Metrics")) {
+                Core::ProxyType<Web::TextBody> body(_textBodies.Element());
+
+                body->clear();
+                body->reserve(MetricsBufferSize);
+
+                Exposition(*body);
+
+                result->ErrorCode = Web::STATUS_OK;
+                result->Message = string(_T("metrics"));
+                result->ContentType = Web::MIMETypes::MIME_TEXT;
+                result->Body(body);
+            } else if (index.Current() == _T("Screenshot")) {
+                // GET .../Screensaver/Screenshot : PNG of the next frame
+                Core::ProxyType<Web::TextBody> body(Core::ProxyType<Web::TextBody>::Create());
+                uint16_t width(0), height(0);
+
+                const uint32_t error(Capture(Graphics::Screenshot::PNG, *body, width, height));
+
+                if (error == Core::ERROR_NONE) {
+                    result->ErrorCode = Web::STATUS_OK;
+                    result->Message = string(_T("screenshot"));
+                    result->ContentType = Web::MIMETypes::MIME_IMAGE_PNG;
+                    result->Body(body);
+                } else if (error == Core::ERROR_ILLEGAL_STATE) {
+                    result->ErrorCode = Web::STATUS_SERVICE_UNAVAILABLE;
+                    result->Message = string(_T("Not rendering."));
+                } else {
+                    result->ErrorCode = Web::STATUS_INTERNAL_SERVER_ERROR;
+                    result->Message = string(_T("No frame captured."));
+                }
+            }
+        }
+
+        return (result);
+    }
+
+    uint32_t Screensaver::Capture(const Graphics::Screenshot::format type, string& image, uint16_t& width, uint16_t& height)
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_captureLock);
+
+        uint32_t result(Core::ERROR_ILLEGAL_STATE);
+
+        const uint32_t tag(_screenshot.Reset(type));
+
+        if (_eglRender.Capture(_screenshot, tag) == true) {
+            if (_screenshot.Wait(ScreenshotTimeout) == true) {
+                _screenshot.Image(image, width, height);
+                result = Core::ERROR_NONE;
+            } else {
+                TRACE(Trace::Error, ("No screenshot within %dms", ScreenshotTimeout));
+                _eglRender.CancelCapture();
+                result = Core::ERROR_TIMEDOUT;
+            }
+        }
+
+        return (result);
+    }
+
+    void Screensaver::Exposition(string& output) const
+    {
+        const Graphics::ProgramCache& cache(Graphics::ProgramCache::Instance());
+
+        WriteCounter(output, "screensaver_frames_rendered_total", "Frames swapped.", _eglRender.FramesRendered());
+        WriteCounter(output, "screensaver_frames_missed_total", "Frame deadlines missed by the frame clock.", _eglRender.FramesMissed());
+        WriteCounter(output, "screensaver_publish_missed_total", "Frames not published by the compositor within the timeout.", _eglRender.PublishMissed());
+        WriteCounter(output, "screensaver_publish_late_total", "Frames published after the timeout.", _eglRender.PublishLate());
+        WriteCounter(output, "screensaver_input_events_total", "Key, mouse and touch events received.", _inputs);
+        WriteGauge(output, "screensaver_active", "1 while the screensaver is shown.", (_eglRender.IsActive() == true) ? 1 : 0);
+        WriteGauge(output, "screensaver_render_scale", "Render resolution relative to the surface.", _eglRender.RenderScale());
+        WriteGauge(output, "screensaver_repaint_ratio", "Repainted share of the surface per drawn frame.", _eglRender.RepaintRatio());
+
+        const Graphics::FramebufferFormat& framebuffer(_eglRender.Framebuffer());
+
+        {
+            char line[256];
+
+            Graphics::Histogram::Append(output, line, snprintf(line, sizeof(line), "# HELP screensaver_framebuffer_info Colour format and EGL config of the surface.\n# TYPE screensaver_framebuffer_info gauge\n"));
+            Graphics::Histogram::Append(output, line, snprintf(line, sizeof(line), "screensaver_framebuffer_info{format=\"%s\",config=\"%d\",bits=\"%d\"} 1\n", Core::EnumerateType<Graphics::FramebufferFormat::format>(framebuffer.Chosen()).Data(), framebuffer.ConfigId(), framebuffer.BufferSize()));
+
+            bool header(true);
+
+            for (uint8_t index = 0; index < Graphics::FramebufferFormat::Formats; ++index) {
+                const Graphics::FramebufferFormat::format type(static_cast<Graphics::FramebufferFormat::format>(index));
+
+                if (framebuffer.FrameTime(type) != 0) {
+                    if (header == true) {
+                        Graphics::Histogram::Append(output, line, snprintf(line, sizeof(line), "# HELP screensaver_framebuffer_frame_seconds Frame time of blended full screen passes per format, measured offscreen at start.\n# TYPE screensaver_framebuffer_frame_seconds gauge\n"));
+                        header = false;
+                    }
+
+                    Graphics::Histogram::Append(output, line, snprintf(line, sizeof(line), "screensaver_framebuffer_frame_seconds{format=\"%s\"} %g\n", Core::EnumerateType<Graphics::FramebufferFormat::format>(type).Data(), framebuffer.FrameTime(type) / 1000000.0));
+                }
+            }
+        }
+
+        _eglRender.FrameTime().Write(output, "screensaver_frame_seconds", "Interval between rendered frames.");
+        _eglRender.PresentWait().Write(output, "screensaver_present_wait_seconds", "Wait for the compositor before recording a frame.");
+        _eglRender.GpuTime().Write(output, "screensaver_gpu_frame_seconds", "GPU time of a frame, with GL_EXT_disjoint_timer_query.");
+        _eglRender.ShowLatency().Write(output, "screensaver_show_seconds", "From Show until the first frame is swapped.");
+        _eglRender.HideLatency().Write(output, "screensaver_hide_seconds", "From Hide until the cleared frame is swapped.");
+
+        bool header(true);
+        char line[128];
+
+        // Straight into the output, a scrape does not allocate per model.
+        _eglRender.GpuTimes([&output, &header, &line](const uint32_t id, const uint32_t time) {
+            if (header == true) {
+                Graphics::Histogram::Append(output, line, snprintf(line, sizeof(line), "# HELP screensaver_model_gpu_seconds GPU time of a model, averaged over the last frames.\n# TYPE screensaver_model_gpu_seconds gauge\n"));
+                header = false;
+            }
+
+            Graphics::Histogram::Append(output, line, snprintf(line, sizeof(line), "screensaver_model_gpu_seconds{model=\"%u\"} %g\n", id, time / 1000000.0));
+        });
+
+        WriteCounter(output, "screensaver_program_cache_hits_total", "Programs loaded from a stored binary.", cache.Hits());
+        WriteCounter(output, "screensaver_program_cache_misses_total", "Programs compiled from source.", cache.Misses());
+        WriteCounter(output, "screensaver_program_cache_rejected_total", "Stored binaries the driver did not accept.", cache.Rejected());
+        WriteSeconds(output, "screensaver_shader_compile_seconds_total", "Time compiling shaders.", cache.CompileTime());
+        WriteSeconds(output, "screensaver_shader_link_seconds_total", "Time linking programs.", cache.LinkTime());
+        WriteSeconds(output, "screensaver_program_load_seconds_total", "Time loading program binaries.", cache.LoadTime());
+
+        const Graphics::ShaderOptimizer& optimizer(Graphics::ShaderOptimizer::Instance());
+
+        WriteCounter(output, "screensaver_shader_optimized_total", "Fragment shaders rewritten by the optimizer.", optimizer.Optimized());
+        WriteCounter(output, "screensaver_shader_optimizer_hits_total", "Optimizer results taken from its cache.", optimizer.Hits());
+        WriteCounter(output, "screensaver_shader_optimizer_rejected_total", "Optimized shaders the driver did not build, the original was used.", optimizer.Rejections());
+        WriteCounter(output, "screensaver_readback_dropped_total", "Frame reads dropped, all readback buffers in flight.", _eglRender.ReadbackDropped());
+        WriteCounter(output, "screensaver_recording_frames_total", "Recorded frames written to the file.", _recorder.Frames());
+        WriteCounter(output, "screensaver_recording_dropped_total", "Recorded frames dropped, readback buffers in flight or the file behind.", _eglRender.RecordDropped() + _recorder.Dropped());
+    }
+
     /* virtual */ void Screensaver::Inbound(Web::Request& /*request*/)
     {
     }
@@ -250,6 +498,8 @@ namespace Plugin {
         // If there is nothing or only a slashe, we will now jump over it, and otherwise, we have data.
         if (request.Verb == Web::Request::HTTP_PUT) {
             result = PutMethod(index, request);
+        } else if (request.Verb == Web::Request::HTTP_GET) {
+            result = GetMethod(index);
         } else {
             result = PluginHost::IFactories::Instance().Response();
             result->ErrorCode = Web::STATUS_NOT_IMPLEMENTED;
@@ -265,6 +515,11 @@ namespace Plugin {
         Register<void, void>(_T("resume"), &Screensaver::Resume, this);
         Register<void, void>(_T("hide"), &Screensaver::Hide, this);
         Register<void, void>(_T("show"), &Screensaver::Show, this);
+        Register<void, Metrics>(_T("metrics"), &Screensaver::JSONRPCMetrics, this);
+        Register<FrameTimesParams, FrameTimes>(_T("frametimes"), &Screensaver::JSONRPCFrameTimes, this);
+        Register<ScreenshotParams, ScreenshotData>(_T("screenshot"), &Screensaver::JSONRPCScreenshot, this);
+        Register<RecordingParams, void>(_T("startrecording"), &Screensaver::JSONRPCStartRecording, this);
+        Register<void, void>(_T("stoprecording"), &Screensaver::StopRecording, this);
     }
     void Screensaver::JSONRPCUnregister()
     {
@@ -272,6 +527,139 @@ namespace Plugin {
         Unregister(_T("resume"));
         Unregister(_T("hide"));
         Unregister(_T("show"));
+        Unregister(_T("metrics"));
+        Unregister(_T("frametimes"));
+        Unregister(_T("screenshot"));
+        Unregister(_T("startrecording"));
+        Unregister(_T("stoprecording"));
+    }
+
+    uint32_t Screensaver::JSONRPCMetrics(Metrics& response)
+    {
+        std::vector<Graphics::FrameHistory::Sample> samples;
+
+        _eglRender.History().Snapshot(samples);
+
+        std::vector<uint32_t> interval, cpu, swap, wait;
+
+        const uint16_t fps(_eglRender.FrameRate());
+        const uint32_t late((fps != 0) ? ((3 * 1000000) / (2 * fps)) : 0);
+
+        uint32_t dropped(0);
+
+        for (const Graphics::FrameHistory::Sample& sample : samples) {
+            // The first frame after a show or resume has no predecessor to time against.
+            if (sample.Interval != 0) {
+                interval.push_back(sample.Interval);
+
+                if ((late != 0) && (sample.Interval > late)) {
+                    ++dropped;
+                }
+            }
+
+            cpu.push_back(sample.Cpu);
+            swap.push_back(sample.Swap);
+            wait.push_back(sample.Wait);
+        }
+
+        const Graphics::FrameHistory::Distribution intervals(Graphics::FrameHistory::Summarize(interval));
+
+        response.Frames = static_cast<uint32_t>(samples.size());
+        response.FPS = (intervals.Avg != 0) ? (1000000.0f / intervals.Avg) : 0.0f;
+        response.Interval.Set(intervals);
+        response.Cpu.Set(Graphics::FrameHistory::Summarize(cpu));
+        response.Swap.Set(Graphics::FrameHistory::Summarize(swap));
+        response.Wait.Set(Graphics::FrameHistory::Summarize(wait));
+        response.Dropped = dropped;
+        response.Missed = _eglRender.FramesMissed();
+        response.PublishMissed = _eglRender.PublishMissed();
+        response.PublishLate = _eglRender.PublishLate();
+
+        _eglRender.GpuTimes([&response](const uint32_t id, const uint32_t time) {
+            ModelTime& entry(response.Models.Add());
+
+            entry.Id = id;
+            entry.Gpu = time / 1000.0f;
+        });
+
+        return (Core::ERROR_NONE);
+    }
+
+    uint32_t Screensaver::JSONRPCFrameTimes(const FrameTimesParams& params, FrameTimes& response)
+    {
+        std::vector<Graphics::FrameHistory::Sample> samples;
+
+        _eglRender.History().Snapshot(samples, (params.Count.Value() != 0) ? params.Count.Value() : static_cast<uint16_t>(Graphics::FrameHistory::Capacity));
+
+        for (const Graphics::FrameHistory::Sample& sample : samples) {
+            FrameSample& entry(response.Samples.Add());
+
+            entry.Frame = sample.Frame;
+            entry.Start = sample.Start;
+            entry.Interval = sample.Interval;
+            entry.Cpu = sample.Cpu;
+            entry.Swap = sample.Swap;
+            entry.Wait = sample.Wait;
+        }
+
+        return (Core::ERROR_NONE);
+    }
+
+    uint32_t Screensaver::JSONRPCScreenshot(const ScreenshotParams& params, ScreenshotData& response)
+    {
+        string image;
+        uint16_t width(0), height(0);
+
+        const uint32_t result(Capture(params.Format.Value(), image, width, height));
+
+        if (result == Core::ERROR_NONE) {
+            string encoded;
+
+            Core::ToString(reinterpret_cast<const uint8_t*>(image.data()), static_cast<uint32_t>(image.size()), true, encoded);
+
+            response.Format = params.Format.Value();
+            response.Width = width;
+            response.Height = height;
+            response.Data = encoded;
+        }
+
+        return (result);
+    }
+
+    uint32_t Screensaver::JSONRPCStartRecording(const RecordingParams& params)
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_recordLock);
+
+        uint32_t result(Core::ERROR_BAD_REQUEST);
+
+        if ((params.File.Value().empty() == false) && (params.Interval.Value() != 0)) {
+            const string fileName((params.File.Value()[0] == '/') ? params.File.Value() : (_service->VolatilePath() + params.File.Value()));
+
+            result = _recorder.Start(fileName, params.Format.Value(), static_cast<uint16_t>(_eglRender.Width()), static_cast<uint16_t>(_eglRender.Height()), _eglRender.FrameRate(), params.Interval.Value());
+
+            if (result == Core::ERROR_NONE) {
+                _eglRender.Record(&_recorder, params.Interval.Value());
+            }
+        }
+
+        return (result);
+    }
+
+    uint32_t Screensaver::StopRecording()
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_recordLock);
+
+        uint32_t result(Core::ERROR_ILLEGAL_STATE);
+
+        if (_recorder.IsRecording() == true) {
+            // No reads issued after this, the ones in flight are written or dropped by Stop().
+            _eglRender.Record(nullptr, 1);
+            _recorder.Stop();
+
+            result = Core::ERROR_NONE;
+        }
+
+        return (result);
     }
 
     void Screensaver::RenderUpdate()
@@ -284,10 +672,25 @@ namespace Plugin {
         std::stringstream stream;
         stream.precision(2);
 
-        fps = (currentFrames - _previousFrames) / ((currentTimeMS - _previousTimeMS) / Core::Time::MilliSecondsPerSecond);
+        if (currentTimeMS > _previousTimeMS) {
+            fps = (static_cast<float>(currentFrames - _previousFrames) * Core::Time::MilliSecondsPerSecond) / (currentTimeMS - _previousTimeMS);
+        }
 
         stream << fps;
 
+        // GPU time of every model in ms, when the driver has timestamp queries.
+        std::stringstream gpu;
+        gpu << std::fixed;
+        gpu.precision(2);
+
+        _eglRender.GpuTimes([&gpu](const uint32_t id, const uint32_t time) {
+            gpu << ((gpu.tellp() == 0) ? "" : ", ") << "\"" << id << "\": " << (time / 1000.0f);
+        });
+
+        if (gpu.tellp() != 0) {
+            stream << ", \"gpu\": { " << gpu.str() << " }";
+        }
+
         string message("{ \"fps\": " + stream.str() + " }");
 
         TRACE(Trace::Information, ("Screensaver::%s: [%.2f] %s", __FUNCTION__, fps, message.c_str()));
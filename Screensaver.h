@@ -23,6 +23,11 @@
 
 #include "EGLRender.h"
 #include "IModel.h"
+#include "ProgramCache.h"
+#include "Recorder.h"
+#include "Screenshot.h"
+#include "ShaderOptimizer.h"
+#include "ShaderLibrary.h"
 
 #include <simpleworker/SimpleWorker.h>
 #include <virtualinput/virtualinput.h>
@@ -99,6 +104,8 @@ namespace Plugin {
 
     private:
         Core::ProxyType<Web::Response> PutMethod(Core::TextSegmentIterator& index, const Web::Request& request);
+        Core::ProxyType<Web::Response> GetMethod(Core::TextSegmentIterator& index);
+        void Exposition(string& output) const;
 
         class InputSink : public InputServer::ICallback {
         public:
@@ -116,6 +123,7 @@ namespace Plugin {
             void Trigger()
             {
                 TRACE(Trace::Information, ("Input detected!"));
+                _parent._inputs++;
                 _parent.Trigger();
             }
 
@@ -155,6 +163,60 @@ namespace Plugin {
             uint16_t _interval;
         };
 
+        // Follows the timeout: warms up the render ahead of it and shows it
+        // when it expires. Reschedules itself until stopped, an input only
+        // moves _startTime and is picked up on the next dispatch.
+        class Countdown : public Core::IDispatch {
+        public:
+            Countdown(Screensaver& parent)
+                : _parent(parent)
+                , _adminLock()
+                , _running(false)
+            {
+            }
+
+            void Start()
+            {
+                _adminLock.Lock();
+                _running = true;
+                _adminLock.Unlock();
+
+                Dispatch();
+            }
+
+            void Stop()
+            {
+                _adminLock.Lock();
+                _running = false;
+                _adminLock.Unlock();
+
+                // A dispatch in progress either scheduled before the flag
+                // was cleared, so it is revoked here, or does not schedule.
+                Core::IWorkerPool::Instance().Revoke(
+                    Core::ProxyType<Core::IDispatch>(*this),
+                    Core::infinite);
+            }
+
+            void Dispatch() override
+            {
+                const uint64_t next(_parent.Count());
+
+                Core::SafeSyncType<Core::CriticalSection> scopedLock(_adminLock);
+
+                if (_running == true) {
+                    Core::IWorkerPool::Instance()
+                        .Schedule(
+                            Core::Time(next),
+                            Core::ProxyType<Core::IDispatch>(*this));
+                }
+            }
+
+        private:
+            Screensaver& _parent;
+            Core::CriticalSection _adminLock;
+            bool _running;
+        };
+
     public:
         class Config : public Core::JSON::Container {
         public:
@@ -167,20 +229,26 @@ namespace Plugin {
                 , Width(1280)
                 , FPS(25)
                 , TimeOut(15 * 60) /* 15 minutes in s */
+                , Warmup(5) /* seconds before the timeout */
                 , FadeIn(0) /* milliseconds*/
                 , Instant(false)
                 , Interval(5) /* seconds; 0 = no off*/
                 , ReportFPS(false)
+                , Composite(false)
+                , Render()
                 , Models()
             {
                 Add(_T("height"), &Height);
                 Add(_T("width"), &Width);
                 Add(_T("fps"), &FPS);
                 Add(_T("timeout"), &TimeOut);
+                Add(_T("warmup"), &Warmup);
                 Add(_T("fadein"), &FadeIn);
                 Add(_T("instant"), &Instant);
                 Add(_T("interval"), &Interval);
                 Add(_T("reportfps"), &ReportFPS);
+                Add(_T("composite"), &Composite);
+                Add(_T("render"), &Render);
                 Add(_T("models"), &Models);
             }
             ~Config()
@@ -192,13 +260,312 @@ namespace Plugin {
             Core::JSON::DecUInt16 Width;
             Core::JSON::DecUInt8 FPS;
             Core::JSON::DecUInt16 TimeOut;
+            Core::JSON::DecUInt16 Warmup;
             Core::JSON::DecUInt16 FadeIn;
             Core::JSON::Boolean Instant;
             Core::JSON::DecUInt8 Interval;
             Core::JSON::Boolean ReportFPS;
+            Core::JSON::Boolean Composite; // show all models as layers instead of picking one
+            Graphics::RenderConfig Render;
             Core::JSON::ArrayType<Graphics::ModelConfig> Models;
         };
 
+        // Frame timing statistics, all times in us.
+        class Distribution : public Core::JSON::Container {
+        public:
+            Distribution(const Distribution&) = delete;
+            Distribution& operator=(const Distribution&) = delete;
+
+            Distribution()
+                : Core::JSON::Container()
+                , Min(0)
+                , Avg(0)
+                , P95(0)
+                , P99(0)
+                , Max(0)
+            {
+                Add(_T("min"), &Min);
+                Add(_T("avg"), &Avg);
+                Add(_T("p95"), &P95);
+                Add(_T("p99"), &P99);
+                Add(_T("max"), &Max);
+            }
+            ~Distribution()
+            {
+            }
+
+            void Set(const Graphics::FrameHistory::Distribution& distribution)
+            {
+                Min = distribution.Min;
+                Avg = distribution.Avg;
+                P95 = distribution.P95;
+                P99 = distribution.P99;
+                Max = distribution.Max;
+            }
+
+        public:
+            Core::JSON::DecUInt32 Min;
+            Core::JSON::DecUInt32 Avg;
+            Core::JSON::DecUInt32 P95;
+            Core::JSON::DecUInt32 P99;
+            Core::JSON::DecUInt32 Max;
+        };
+
+        class ModelTime : public Core::JSON::Container {
+        public:
+            ModelTime(const ModelTime& copy)
+                : Core::JSON::Container()
+                , Id(copy.Id)
+                , Gpu(copy.Gpu)
+            {
+                Add(_T("id"), &Id);
+                Add(_T("gpu"), &Gpu);
+            }
+
+            ModelTime& operator=(const ModelTime& RHS)
+            {
+                Id = RHS.Id;
+                Gpu = RHS.Gpu;
+
+                return (*this);
+            }
+
+            ModelTime()
+                : Core::JSON::Container()
+                , Id(0)
+                , Gpu(0.0)
+            {
+                Add(_T("id"), &Id);
+                Add(_T("gpu"), &Gpu);
+            }
+            ~ModelTime()
+            {
+            }
+
+        public:
+            Core::JSON::DecUInt32 Id;
+            Core::JSON::Float Gpu; // ms
+        };
+
+        class Metrics : public Core::JSON::Container {
+        public:
+            Metrics(const Metrics&) = delete;
+            Metrics& operator=(const Metrics&) = delete;
+
+            Metrics()
+                : Core::JSON::Container()
+                , Frames(0)
+                , FPS(0.0)
+                , Interval()
+                , Cpu()
+                , Swap()
+                , Wait()
+                , Dropped(0)
+                , Missed(0)
+                , PublishMissed(0)
+                , PublishLate(0)
+                , Models()
+            {
+                Add(_T("frames"), &Frames);
+                Add(_T("fps"), &FPS);
+                Add(_T("interval"), &Interval);
+                Add(_T("cpu"), &Cpu);
+                Add(_T("swap"), &Swap);
+                Add(_T("wait"), &Wait);
+                Add(_T("dropped"), &Dropped);
+                Add(_T("missed"), &Missed);
+                Add(_T("publishmissed"), &PublishMissed);
+                Add(_T("publishlate"), &PublishLate);
+                Add(_T("models"), &Models);
+            }
+            ~Metrics()
+            {
+            }
+
+        public:
+            Core::JSON::DecUInt32 Frames; // in the window
+            Core::JSON::Float FPS;
+            Distribution Interval;
+            Distribution Cpu;
+            Distribution Swap;
+            Distribution Wait;
+            Core::JSON::DecUInt32 Dropped; // intervals over 1.5 frame period in the window
+            Core::JSON::DecUInt32 Missed; // totals since start
+            Core::JSON::DecUInt32 PublishMissed;
+            Core::JSON::DecUInt32 PublishLate;
+            Core::JSON::ArrayType<ModelTime> Models;
+        };
+
+        class FrameSample : public Core::JSON::Container {
+        public:
+            FrameSample(const FrameSample& copy)
+                : Core::JSON::Container()
+                , Frame(copy.Frame)
+                , Start(copy.Start)
+                , Interval(copy.Interval)
+                , Cpu(copy.Cpu)
+                , Swap(copy.Swap)
+                , Wait(copy.Wait)
+            {
+                Add(_T("frame"), &Frame);
+                Add(_T("start"), &Start);
+                Add(_T("interval"), &Interval);
+                Add(_T("cpu"), &Cpu);
+                Add(_T("swap"), &Swap);
+                Add(_T("wait"), &Wait);
+            }
+
+            FrameSample& operator=(const FrameSample& RHS)
+            {
+                Frame = RHS.Frame;
+                Start = RHS.Start;
+                Interval = RHS.Interval;
+                Cpu = RHS.Cpu;
+                Swap = RHS.Swap;
+                Wait = RHS.Wait;
+
+                return (*this);
+            }
+
+            FrameSample()
+                : Core::JSON::Container()
+                , Frame(0)
+                , Start(0)
+                , Interval(0)
+                , Cpu(0)
+                , Swap(0)
+                , Wait(0)
+            {
+                Add(_T("frame"), &Frame);
+                Add(_T("start"), &Start);
+                Add(_T("interval"), &Interval);
+                Add(_T("cpu"), &Cpu);
+                Add(_T("swap"), &Swap);
+                Add(_T("wait"), &Wait);
+            }
+            ~FrameSample()
+            {
+            }
+
+        public:
+            Core::JSON::DecUInt64 Frame;
+            Core::JSON::DecUInt64 Start;
+            Core::JSON::DecUInt32 Interval;
+            Core::JSON::DecUInt32 Cpu;
+            Core::JSON::DecUInt32 Swap;
+            Core::JSON::DecUInt32 Wait;
+        };
+
+        class FrameTimesParams : public Core::JSON::Container {
+        public:
+            FrameTimesParams(const FrameTimesParams&) = delete;
+            FrameTimesParams& operator=(const FrameTimesParams&) = delete;
+
+            FrameTimesParams()
+                : Core::JSON::Container()
+                , Count(0)
+            {
+                Add(_T("count"), &Count);
+            }
+            ~FrameTimesParams()
+            {
+            }
+
+        public:
+            Core::JSON::DecUInt16 Count; // 0 for all that are kept
+        };
+
+        class FrameTimes : public Core::JSON::Container {
+        public:
+            FrameTimes(const FrameTimes&) = delete;
+            FrameTimes& operator=(const FrameTimes&) = delete;
+
+            FrameTimes()
+                : Core::JSON::Container()
+                , Samples()
+            {
+                Add(_T("samples"), &Samples);
+            }
+            ~FrameTimes()
+            {
+            }
+
+        public:
+            Core::JSON::ArrayType<FrameSample> Samples;
+        };
+
+        class ScreenshotParams : public Core::JSON::Container {
+        public:
+            ScreenshotParams(const ScreenshotParams&) = delete;
+            ScreenshotParams& operator=(const ScreenshotParams&) = delete;
+
+            ScreenshotParams()
+                : Core::JSON::Container()
+                , Format(Graphics::Screenshot::PNG)
+            {
+                Add(_T("format"), &Format);
+            }
+            ~ScreenshotParams()
+            {
+            }
+
+        public:
+            Core::JSON::EnumType<Graphics::Screenshot::format> Format;
+        };
+
+        class ScreenshotData : public Core::JSON::Container {
+        public:
+            ScreenshotData(const ScreenshotData&) = delete;
+            ScreenshotData& operator=(const ScreenshotData&) = delete;
+
+            ScreenshotData()
+                : Core::JSON::Container()
+                , Format(Graphics::Screenshot::PNG)
+                , Width(0)
+                , Height(0)
+                , Data()
+            {
+                Add(_T("format"), &Format);
+                Add(_T("width"), &Width);
+                Add(_T("height"), &Height);
+                Add(_T("data"), &Data);
+            }
+            ~ScreenshotData()
+            {
+            }
+
+        public:
+            Core::JSON::EnumType<Graphics::Screenshot::format> Format;
+            Core::JSON::DecUInt16 Width;
+            Core::JSON::DecUInt16 Height;
+            Core::JSON::String Data; // base64
+        };
+
+        class RecordingParams : public Core::JSON::Container {
+        public:
+            RecordingParams(const RecordingParams&) = delete;
+            RecordingParams& operator=(const RecordingParams&) = delete;
+
+            RecordingParams()
+                : Core::JSON::Container()
+                , File()
+                , Format(Graphics::Recorder::Y4M)
+                , Interval(1)
+            {
+                Add(_T("file"), &File);
+                Add(_T("format"), &Format);
+                Add(_T("interval"), &Interval);
+            }
+            ~RecordingParams()
+            {
+            }
+
+        public:
+            Core::JSON::String File; // relative to the volatile path, unless absolute
+            Core::JSON::EnumType<Graphics::Recorder::format> Format;
+            Core::JSON::DecUInt16 Interval; // every n-th frame
+        };
+
     public:
         //   IPlugin methods
         // -------------------------------------------------------------------------------------------------------
@@ -217,9 +584,16 @@ namespace Plugin {
         void JSONRPCUnregister();
         uint32_t JSONRPCPause();
         uint32_t JSONRPCResumed();
+        uint32_t JSONRPCMetrics(Metrics& response);
+        uint32_t JSONRPCFrameTimes(const FrameTimesParams& params, FrameTimes& response);
+        uint32_t JSONRPCScreenshot(const ScreenshotParams& params, ScreenshotData& response);
+        uint32_t JSONRPCStartRecording(const RecordingParams& params);
+        uint32_t StopRecording();
 
     private:
         void RenderUpdate();
+        uint32_t AddModel(const Config& config, const Graphics::ModelConfig& model, const bool calibrate);
+        uint32_t Capture(const Graphics::Screenshot::format type, string& image, uint16_t& width, uint16_t& height);
 
         inline uint32_t Pause()
         {
@@ -249,6 +623,9 @@ namespace Plugin {
 
         void Trigger()
         {
+            // Hide and Show only queue a command, so they keep their order under the lock.
+            Core::SafeSyncType<Core::CriticalSection> scopedLock(_adminLock);
+
             if (Core::Time::Now().Add(_timeOut * 1000).Ticks() >= (_startTime + (Core::Time::TicksPerMillisecond * 1000 * 2))) {
                 TRACE(Trace::Information, ("Input detected!"));
                 _eglRender.Hide();
@@ -259,18 +636,39 @@ namespace Plugin {
             }
         }
 
-        bool Tack()
+        // Returns the ticks of the next moment the countdown needs attention.
+        // The only place the timeout shows the render.
+        uint64_t Count()
         {
-            if ((_startTime - Core::Time::Now().Ticks() <= 0) && (_triggered == false)) {
-                _eglRender.Show();
-                _triggered = true;
+            Core::SafeSyncType<Core::CriticalSection> scopedLock(_adminLock);
+
+            const uint64_t now(Core::Time::Now().Ticks());
+            const uint64_t warmup(static_cast<uint64_t>(_warmup) * Core::Time::TicksPerMillisecond * 1000);
+            const uint64_t prepare((_startTime > warmup) ? (_startTime - warmup) : 0);
+
+            // Hiding restarts the timeout, so while shown it can not expire before this.
+            uint64_t next(now + (static_cast<uint64_t>(std::max(_timeOut, static_cast<uint16_t>(1))) * Core::Time::TicksPerMillisecond * 1000));
+
+            if (_triggered == false) {
+                if (now >= _startTime) {
+                    _triggered = true;
+                    Show();
+                } else if ((warmup != 0) && (now >= prepare)) {
+                    _eglRender.Prepare();
+                    next = _startTime;
+                } else {
+                    next = (warmup != 0) ? prepare : _startTime;
+                }
             }
 
+            return (next);
+        }
+
+        void Tack()
+        {
             if (_reportFPS == true) {
                 RenderUpdate();
             }
-
-            return _triggered;
         }
 
         bool IsActive() const
@@ -283,6 +681,7 @@ namespace Plugin {
         Graphics::EGLRender _eglRender;
         PluginHost::IShell* _service;
 
+        Core::CriticalSection _adminLock; // _startTime and _triggered
         bool _triggered;
 
         uint32_t _previousFrames;
@@ -291,11 +690,26 @@ namespace Plugin {
         uint16_t _interval;
         uint16_t _timeOut;
         uint64_t _startTime;
+        uint16_t _warmup;
 
         bool _reportFPS;
+        std::atomic<uint32_t> _inputs;
+
+        // Bodies keep their capacity when returned to the pool, a scrape
+        // only allocates when the output outgrew every earlier one.
+        Core::ProxyPoolType<Web::TextBody> _textBodies;
+
+        Core::CriticalSection _captureLock; // one screenshot at a time
+        Graphics::Screenshot _screenshot;
+
+        Core::CriticalSection _recordLock; // start and stop of a recording
+        Graphics::Recorder _recorder;
+
+        Graphics::Calibration _calibration; // used by the render thread until it is deinitialized
 
         InputSink _inputSink;
         Core::ProxyType<Tick> _ticker;
+        Core::ProxyType<Countdown> _countdown;
 
         InputServer _inputServer;
     };
@@ -0,0 +1,237 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Screenshot.h"
+
+#include "Tracing.h"
+
+ENUM_CONVERSION_BEGIN(Thunder::Graphics::Screenshot::format)
+    { Thunder::Graphics::Screenshot::PNG, _TXT("png") },
+    { Thunder::Graphics::Screenshot::RAW, _TXT("raw") },
+ENUM_CONVERSION_END(Thunder::Graphics::Screenshot::format)
+
+namespace Thunder {
+namespace Graphics {
+    namespace {
+        constexpr uint16_t MaxStored = 65535; // bytes in a stored deflate block
+
+        class CRC32 {
+        public:
+            CRC32(const CRC32&) = delete;
+            CRC32& operator=(const CRC32&) = delete;
+
+            CRC32()
+            {
+                for (uint32_t index = 0; index < 256; ++index) {
+                    uint32_t value(index);
+
+                    for (uint8_t bit = 0; bit < 8; ++bit) {
+                        value = (value & 1) ? (0xEDB88320 ^ (value >> 1)) : (value >> 1);
+                    }
+
+                    _table[index] = value;
+                }
+            }
+
+            uint32_t Calculate(const uint8_t data[], const size_t length) const
+            {
+                uint32_t crc(0xFFFFFFFF);
+
+                for (size_t index = 0; index < length; ++index) {
+                    crc = _table[(crc ^ data[index]) & 0xFF] ^ (crc >> 8);
+                }
+
+                return (crc ^ 0xFFFFFFFF);
+            }
+
+        private:
+            uint32_t _table[256];
+        };
+
+        void BigEndian(string& output, const uint32_t value)
+        {
+            output += static_cast<char>(value >> 24);
+            output += static_cast<char>(value >> 16);
+            output += static_cast<char>(value >> 8);
+            output += static_cast<char>(value);
+        }
+
+        // Starts a chunk, returns where its type starts for the CRC.
+        size_t Open(string& output, const uint32_t length, const char type[4])
+        {
+            BigEndian(output, length);
+
+            const size_t start(output.size());
+
+            output.append(type, 4);
+
+            return (start);
+        }
+
+        void Close(string& output, const size_t start)
+        {
+            static const CRC32 crc;
+
+            BigEndian(output, crc.Calculate(reinterpret_cast<const uint8_t*>(output.data()) + start, output.size() - start));
+        }
+
+        // The zlib stream of stored blocks, fed byte by byte.
+        class Stored {
+        public:
+            Stored(const Stored&) = delete;
+            Stored& operator=(const Stored&) = delete;
+
+            Stored(string& output, const uint32_t length)
+                : _output(output)
+                , _remaining(length)
+                , _block(0)
+                , _a(1)
+                , _b(0)
+            {
+                _output += static_cast<char>(0x78); // deflate, 32K window
+                _output += static_cast<char>(0x01); // no compression, check bits
+            }
+
+            void Add(const uint8_t value)
+            {
+                if (_block == 0) {
+                    _block = static_cast<uint16_t>((_remaining > MaxStored) ? MaxStored : _remaining);
+
+                    _output += static_cast<char>((_block == _remaining) ? 1 : 0); // last block, stored
+                    _output += static_cast<char>(_block & 0xFF);
+                    _output += static_cast<char>(_block >> 8);
+                    _output += static_cast<char>(~_block & 0xFF);
+                    _output += static_cast<char>((~_block >> 8) & 0xFF);
+                }
+
+                _output += static_cast<char>(value);
+
+                --_block;
+                --_remaining;
+
+                // Adler-32, the modulo is due every 5552 bytes at the latest.
+                _a += value;
+                _b += _a;
+
+                if ((_remaining % 4096) == 0) {
+                    _a %= 65521;
+                    _b %= 65521;
+                }
+            }
+
+            void End()
+            {
+                BigEndian(_output, ((_b % 65521) << 16) | (_a % 65521));
+            }
+
+        private:
+            string& _output;
+            uint32_t _remaining;
+            uint16_t _block;
+            uint32_t _a;
+            uint32_t _b;
+        };
+    }
+
+    void Screenshot::Frame(const uint32_t tag, const uint16_t width, const uint16_t height, const uint8_t pixels[])
+    {
+        Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+
+        // Read with the tag of Reset(), an earlier capture that timed out may still deliver.
+        if (tag == _sequence) {
+            const uint64_t start(Core::Time::Now().Ticks());
+
+            if (_format == PNG) {
+                EncodePNG(width, height, pixels, _image);
+            } else {
+                EncodeRaw(width, height, pixels, _image);
+            }
+
+            _width = width;
+            _height = height;
+
+            TRACE(Trace::Information, ("Screenshot %d, %dx%d %s %d bytes in %dms", tag, width, height, (_format == PNG) ? "png" : "raw", static_cast<uint32_t>(_image.size()), static_cast<uint32_t>((Core::Time::Now().Ticks() - start) / 1000)));
+
+            _done.SetEvent();
+        } else {
+            TRACE(Trace::Information, ("Screenshot %d arrived after its capture gave up, ignored", tag));
+        }
+    }
+
+    /* static */ void Screenshot::EncodePNG(const uint16_t width, const uint16_t height, const uint8_t pixels[], string& output)
+    {
+        static constexpr uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+        const uint32_t row(1 + (static_cast<uint32_t>(width) * 3)); // filter type and RGB
+        const uint32_t length(row * height);
+        const uint32_t blocks((length + MaxStored - 1) / MaxStored);
+        const uint32_t stream(2 + length + (blocks * 5) + 4);
+
+        output.clear();
+        output.reserve(sizeof(signature) + (12 + 13) + (12 + stream) + 12);
+
+        output.append(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+        size_t chunk(Open(output, 13, "IHDR"));
+        BigEndian(output, width);
+        BigEndian(output, height);
+        output += static_cast<char>(8); // bits per channel
+        output += static_cast<char>(2); // truecolor
+        output += static_cast<char>(0); // deflate
+        output += static_cast<char>(0); // adaptive filtering
+        output += static_cast<char>(0); // not interlaced
+        Close(output, chunk);
+
+        chunk = Open(output, stream, "IDAT");
+
+        Stored data(output, length);
+
+        for (uint16_t y = height; y > 0; --y) {
+            const uint8_t* line(pixels + ((static_cast<uint32_t>(y) - 1) * width * 4));
+
+            data.Add(0); // no filter
+
+            for (uint16_t x = 0; x < width; ++x, line += 4) {
+                data.Add(line[0]);
+                data.Add(line[1]);
+                data.Add(line[2]);
+            }
+        }
+
+        data.End();
+        Close(output, chunk);
+
+        chunk = Open(output, 0, "IEND");
+        Close(output, chunk);
+    }
+
+    /* static */ void Screenshot::EncodeRaw(const uint16_t width, const uint16_t height, const uint8_t pixels[], string& output)
+    {
+        const uint32_t stride(static_cast<uint32_t>(width) * 4);
+
+        output.clear();
+        output.reserve(stride * height);
+
+        for (uint16_t y = height; y > 0; --y) {
+            output.append(reinterpret_cast<const char*>(pixels + ((static_cast<uint32_t>(y) - 1) * stride)), stride);
+        }
+    }
+
+} // namespace Graphics
+} // namespace Thunder
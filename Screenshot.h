@@ -0,0 +1,104 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include "Readback.h"
+
+namespace Thunder {
+namespace Graphics {
+    // Takes one frame from the Readback thread and encodes it there, the
+    // requester waits for it. PNG is written without compression (stored
+    // deflate blocks), which keeps the encoding cheap and free of dependencies.
+    class EXTERNAL Screenshot : public Readback::IConsumer {
+    public:
+        enum format : uint8_t {
+            PNG, // RGB, top-down
+            RAW // RGBA, top-down
+        };
+
+    public:
+        Screenshot(const Screenshot&) = delete;
+        Screenshot& operator=(const Screenshot&) = delete;
+
+        Screenshot()
+            : _lock()
+            , _done(false, true)
+            , _format(PNG)
+            , _sequence(0)
+            , _image()
+            , _width(0)
+            , _height(0)
+        {
+        }
+        ~Screenshot() override = default;
+
+    public:
+        // Before every capture, drops an earlier image. Returns the tag to
+        // read the frame with, a frame of an earlier capture is ignored.
+        uint32_t Reset(const format type)
+        {
+            Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+
+            _done.ResetEvent();
+            _format = type;
+            _image.clear();
+            _width = 0;
+            _height = 0;
+
+            return (++_sequence);
+        }
+
+        bool Wait(const uint32_t waitTime)
+        {
+            return (_done.Lock(waitTime) == Core::ERROR_NONE);
+        }
+
+        // Moves the image out, valid after Wait() succeeded.
+        void Image(string& image, uint16_t& width, uint16_t& height)
+        {
+            Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+
+            image.swap(_image);
+            _image.clear();
+            width = _width;
+            height = _height;
+        }
+
+        // Readback::IConsumer
+        void Frame(const uint32_t frame, const uint16_t width, const uint16_t height, const uint8_t pixels[]) override;
+
+        // RGBA rows bottom-up, as read by glReadPixels.
+        static void EncodePNG(const uint16_t width, const uint16_t height, const uint8_t pixels[], string& output);
+        static void EncodeRaw(const uint16_t width, const uint16_t height, const uint8_t pixels[], string& output);
+
+    private:
+        Core::CriticalSection _lock;
+        Core::Event _done;
+        format _format;
+        uint32_t _sequence;
+        string _image;
+        uint16_t _width;
+        uint16_t _height;
+    }; // class Screenshot
+
+} // namespace Graphics
+} // namespace Thunder
@@ -0,0 +1,69 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include <string.h>
+
+namespace Thunder {
+namespace Graphics {
+    // The shaders/ sources linked into the plugin, see cmake/EmbedShaders.cmake.
+    // Files with the same content share one blob. Without the
+    // PLUGIN_SCREENSAVER_EMBED_SHADERS build option nothing is found.
+    class ShaderLibrary {
+    public:
+        struct Entry {
+            const char* Name; // file name in shaders/
+            const char* Source; // zero terminated
+            uint32_t Length;
+            uint64_t Hash; // of the content, taken at build time
+        };
+
+    public:
+        ShaderLibrary() = delete;
+        ShaderLibrary(const ShaderLibrary&) = delete;
+        ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+        static const Entry* Find(const string& name VARIABLE_IS_NOT_USED)
+        {
+            const Entry* result(nullptr);
+
+#ifdef SCREENSAVER_EMBEDDED_SHADERS
+            for (uint16_t index = 0; (index < _count) && (result == nullptr); ++index) {
+                if (strcmp(_entries[index].Name, name.c_str()) == 0) {
+                    result = &_entries[index];
+                }
+            }
+#endif
+
+            return (result);
+        }
+
+#ifdef SCREENSAVER_EMBEDDED_SHADERS
+    private:
+        // Generated, EmbeddedShaders.cpp in the build directory.
+        static const Entry _entries[];
+        static const uint16_t _count;
+#endif
+    }; // class ShaderLibrary
+
+} // namespace Graphics
+} // namespace Thunder
@@ -0,0 +1,1017 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ShaderOptimizer.h"
+
+#include "AtomicFile.h"
+#include "ProgramCache.h"
+#include "Tracing.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmath>
+#include <vector>
+
+namespace Thunder {
+namespace Graphics {
+    namespace {
+        // Part of the cache key, to be raised whenever a pass changes its output.
+        constexpr uint32_t Revision = 1;
+
+        // Trip count up to which Estimate() still follows a loop.
+        constexpr uint16_t EstimateTrips = 1024;
+
+        // Whole shader, unrolling stops beyond it.
+        constexpr size_t MaxTokens = 65536;
+
+        typedef std::vector<string> Tokens;
+
+        struct Literal {
+            bool Float;
+            double Value;
+        };
+
+        struct Loop {
+            string Type;
+            string Name;
+            std::vector<double> Values; // of the loop variable, per iteration
+            size_t Body; // opening brace
+            size_t End; // past the closing brace
+        };
+
+        const char* const Types[] = { "float", "int", "bool", "vec2", "vec3", "vec4", "ivec2", "ivec3", "ivec4", "bvec2", "bvec3", "bvec4", "mat2", "mat3", "mat4" };
+        const char* const Pairs[] = { "++", "--", "+=", "-=", "*=", "/=", "==", "!=", "<=", ">=", "&&", "||", "^^", "<<", ">>" };
+        const char* const Comparisons[] = { "<", "<=", ">", ">=" };
+        const char* const Assignments[] = { "=", "+=", "-=", "*=", "/=", "++", "--" };
+        const char* const Operations[] = { "+", "-", "*", "/", "+=", "-=", "*=", "/=", "++", "--", "<", ">", "<=", ">=", "==", "!=", "&&", "||", "^^", "!", "?" };
+        const char* const Statements[] = { "for", "while", "do", "else", "return" };
+        const char* const Constructors[] = { "float", "vec2", "vec3", "vec4" };
+        const char* const Expression[] = { "(", ")", ",", "+", "-", "*", "." };
+
+        // After one of these "a op b" is evaluated as a whole, whatever op is.
+        const char* const Boundaries[] = { "(", "[", ",", "=", "+=", "-=", "*=", "/=", "?", ":", ";", "{", "}", "return", "==", "!=", "<", ">", "<=", ">=", "&&", "||", "^^" };
+
+        template <size_t N>
+        bool IsOneOf(const string& token, const char* const (&list)[N])
+        {
+            bool result(false);
+
+            for (uint16_t index = 0; (index < N) && (result == false); ++index) {
+                result = (token == list[index]);
+            }
+
+            return (result);
+        }
+
+        bool IsIdentifier(const string& token)
+        {
+            return ((token.empty() == false) && ((isalpha(static_cast<unsigned char>(token[0])) != 0) || (token[0] == '_')));
+        }
+
+        bool IsNumber(const string& token)
+        {
+            return ((token.empty() == false) && ((isdigit(static_cast<unsigned char>(token[0])) != 0) || ((token[0] == '.') && (token.size() > 1) && (isdigit(static_cast<unsigned char>(token[1])) != 0))));
+        }
+
+        bool IsDirective(const string& token)
+        {
+            return ((token.empty() == false) && (token[0] == '#'));
+        }
+
+        std::vector<string> Words(const string& line)
+        {
+            std::vector<string> words;
+            size_t start(line.find_first_not_of(" \t#"));
+
+            while (start != string::npos) {
+                const size_t end(line.find_first_of(" \t", start));
+
+                words.push_back(line.substr(start, (end == string::npos) ? string::npos : (end - start)));
+                start = (end == string::npos) ? end : line.find_first_not_of(" \t", end);
+            }
+
+            return (words);
+        }
+
+        size_t NumberEnd(const string& source, size_t index)
+        {
+            const size_t length(source.size());
+
+            if ((source[index] == '0') && ((index + 1) < length) && ((source[index + 1] == 'x') || (source[index + 1] == 'X'))) {
+                index += 2;
+
+                while ((index < length) && (isxdigit(static_cast<unsigned char>(source[index])) != 0)) {
+                    ++index;
+                }
+            } else {
+                while ((index < length) && (isdigit(static_cast<unsigned char>(source[index])) != 0)) {
+                    ++index;
+                }
+
+                if ((index < length) && (source[index] == '.')) {
+                    ++index;
+
+                    while ((index < length) && (isdigit(static_cast<unsigned char>(source[index])) != 0)) {
+                        ++index;
+                    }
+                }
+
+                if ((index < length) && ((source[index] == 'e') || (source[index] == 'E'))) {
+                    size_t exponent(index + 1);
+
+                    if ((exponent < length) && ((source[exponent] == '+') || (source[exponent] == '-'))) {
+                        ++exponent;
+                    }
+
+                    if ((exponent < length) && (isdigit(static_cast<unsigned char>(source[exponent])) != 0)) {
+                        index = exponent;
+
+                        while ((index < length) && (isdigit(static_cast<unsigned char>(source[index])) != 0)) {
+                            ++index;
+                        }
+                    }
+                }
+            }
+
+            while ((index < length) && (strchr("fFuU", source[index]) != nullptr) && (source[index] != '\0')) {
+                ++index;
+            }
+
+            return (index);
+        }
+
+        // Comments are dropped, a directive is a single token of its whole line.
+        void Tokenize(const string& source, Tokens& tokens)
+        {
+            const size_t length(source.size());
+            size_t index(0);
+            bool start(true); // of a line, where a directive may begin
+
+            while (index < length) {
+                const char c(source[index]);
+                const char next(((index + 1) < length) ? source[index + 1] : '\0');
+
+                if (c == '\n') {
+                    start = true;
+                    ++index;
+                } else if (isspace(static_cast<unsigned char>(c)) != 0) {
+                    ++index;
+                } else if ((c == '/') && (next == '/')) {
+                    index = source.find('\n', index);
+                    index = (index == string::npos) ? length : index;
+                } else if ((c == '/') && (next == '*')) {
+                    const size_t end(source.find("*/", index + 2));
+                    index = (end == string::npos) ? length : (end + 2);
+                } else if ((c == '#') && (start == true)) {
+                    string directive;
+
+                    while ((index < length) && (source[index] != '\n')) {
+                        if ((source[index] == '\\') && ((index + 1) < length) && (source[index + 1] == '\n')) {
+                            directive += ' ';
+                            index += 2;
+                        } else {
+                            directive += source[index++];
+                        }
+                    }
+
+                    const size_t comment(directive.find("//"));
+
+                    if (comment != string::npos) {
+                        directive.erase(comment);
+                    }
+
+                    while ((directive.empty() == false) && (isspace(static_cast<unsigned char>(directive.back())) != 0)) {
+                        directive.pop_back();
+                    }
+
+                    tokens.push_back(directive);
+                } else {
+                    size_t end(index + 1);
+
+                    if ((isalpha(static_cast<unsigned char>(c)) != 0) || (c == '_')) {
+                        while ((end < length) && ((isalnum(static_cast<unsigned char>(source[end])) != 0) || (source[end] == '_'))) {
+                            ++end;
+                        }
+                    } else if ((isdigit(static_cast<unsigned char>(c)) != 0) || ((c == '.') && (isdigit(static_cast<unsigned char>(next)) != 0))) {
+                        end = NumberEnd(source, index);
+                    } else if ((next != '\0') && (IsOneOf(source.substr(index, 2), Pairs) == true)) {
+                        end = index + 2;
+                    }
+
+                    tokens.push_back(source.substr(index, end - index));
+                    index = end;
+                    start = false;
+                }
+            }
+        }
+
+        string Serialize(const Tokens& tokens)
+        {
+            string result;
+            const string* previous(nullptr);
+
+            for (const string& token : tokens) {
+                if (IsDirective(token) == true) {
+                    if ((result.empty() == false) && (result.back() != '\n')) {
+                        result += '\n';
+                    }
+
+                    result += token;
+                    result += '\n';
+                    previous = nullptr;
+                } else {
+                    if (previous != nullptr) {
+                        const bool words(((IsIdentifier(*previous) == true) || (IsNumber(*previous) == true)) && ((IsIdentifier(token) == true) || (IsNumber(token) == true)));
+                        const string joint(string(1, previous->back()) + token[0]);
+
+                        // Keep "a - -b" and "/ *" apart.
+                        if ((words == true) || (IsOneOf(joint, Pairs) == true) || (joint == "//") || (joint == "/*")) {
+                            result += ' ';
+                        }
+                    }
+
+                    result += token;
+
+                    if ((token == ";") || (token == "{") || (token == "}")) {
+                        result += '\n';
+                        previous = nullptr;
+                    } else {
+                        previous = &token;
+                    }
+                }
+            }
+
+            return (result);
+        }
+
+        // Unsigned literals are left as written.
+        bool Parse(const string& token, Literal& literal)
+        {
+            bool result(false);
+
+            if ((IsNumber(token) == true) && (token.back() != 'u') && (token.back() != 'U')) {
+                const bool hex((token.size() > 1) && ((token[1] == 'x') || (token[1] == 'X')));
+
+                literal.Float = ((hex == false) && (token.find_first_of(".eEfF") != string::npos));
+                literal.Value = (literal.Float == true) ? strtod(token.c_str(), nullptr) : static_cast<double>(strtoll(token.c_str(), nullptr, 0));
+                result = true;
+            }
+
+            return (result);
+        }
+
+        // Positive values only, a sign would be a token of its own.
+        bool Format(const Literal& literal, string& token)
+        {
+            bool result(false);
+            char text[32];
+
+            if ((std::isfinite(literal.Value) == true) && (literal.Value >= 0)) {
+                if (literal.Float == true) {
+                    snprintf(text, sizeof(text), "%.9g", literal.Value);
+                    token = text;
+
+                    if (token.find_first_of(".e") == string::npos) {
+                        token += ".0";
+                    }
+
+                    result = true;
+                } else if (literal.Value <= 2147483647.0) {
+                    snprintf(text, sizeof(text), "%lld", static_cast<long long>(literal.Value));
+                    token = text;
+                    result = true;
+                }
+            }
+
+            return (result);
+        }
+
+        void Emit(const double value, const bool floating, Tokens& tokens)
+        {
+            const Literal literal = { floating, std::fabs(value) };
+            string token;
+
+            Format(literal, token);
+
+            if (value < 0) {
+                tokens.push_back("(");
+                tokens.push_back("-");
+                tokens.push_back(token);
+                tokens.push_back(")");
+            } else {
+                tokens.push_back(token);
+            }
+        }
+
+        // "n", "-n" or "(-n)", returns the index past it or 0.
+        size_t Signed(const Tokens& tokens, const size_t index, Literal& literal)
+        {
+            size_t result(0);
+            size_t position(index);
+            const bool parenthesized((position < tokens.size()) && (tokens[position] == "("));
+
+            position += (parenthesized == true) ? 1 : 0;
+
+            const bool negative((position < tokens.size()) && (tokens[position] == "-"));
+
+            position += (negative == true) ? 1 : 0;
+
+            if ((position < tokens.size()) && (Parse(tokens[position], literal) == true)) {
+                literal.Value = (negative == true) ? -literal.Value : literal.Value;
+                ++position;
+
+                if (parenthesized == false) {
+                    result = position;
+                } else if ((position < tokens.size()) && (tokens[position] == ")")) {
+                    result = position + 1;
+                }
+            }
+
+            return (result);
+        }
+
+        // Past the brace closing the one at index, 0 if it is not closed.
+        size_t Close(const Tokens& tokens, const size_t index)
+        {
+            size_t result(0);
+            uint32_t depth(0);
+
+            for (size_t position = index; (position < tokens.size()) && (result == 0); ++position) {
+                if (tokens[position] == "{") {
+                    ++depth;
+                } else if ((tokens[position] == "}") && (--depth == 0)) {
+                    result = position + 1;
+                }
+            }
+
+            return (result);
+        }
+
+        // Substitutes object-like #defines of a number that are defined once
+        // and never undefined. The directive itself stays for #if.
+        void Substitute(Tokens& tokens)
+        {
+            std::map<string, std::pair<size_t, Tokens>> macros;
+            std::map<string, bool> usable;
+
+            for (size_t index = 0; index < tokens.size(); ++index) {
+                if (IsDirective(tokens[index]) == true) {
+                    const std::vector<string> words(Words(tokens[index]));
+
+                    if ((words.size() >= 2) && ((words[0] == "define") || (words[0] == "undef"))) {
+                        const string name(words[1].substr(0, words[1].find('(')));
+                        Literal literal;
+                        Tokens value;
+
+                        if ((words[0] == "define") && (words.size() == 3) && (name == words[1])) {
+                            const bool negative(words[2][0] == '-');
+
+                            if (Parse(words[2].substr((negative == true) ? 1 : 0), literal) == true) {
+                                Emit((negative == true) ? -literal.Value : literal.Value, literal.Float, value);
+                            }
+                        }
+
+                        std::map<string, bool>::iterator entry(usable.find(name));
+
+                        if (entry != usable.end()) {
+                            entry->second = false;
+                        } else {
+                            usable.emplace(name, (value.empty() == false));
+                            macros.emplace(name, std::make_pair(index, value));
+                        }
+                    }
+                }
+            }
+
+            for (size_t index = 0; index < tokens.size(); ++index) {
+                std::map<string, bool>::const_iterator entry;
+
+                if ((IsIdentifier(tokens[index]) == true) && ((entry = usable.find(tokens[index])) != usable.end()) && (entry->second == true) && ((index == 0) || (tokens[index - 1] != "."))) {
+                    const std::pair<size_t, Tokens>& macro(macros[tokens[index]]);
+
+                    if (index > macro.first) {
+                        tokens.erase(tokens.begin() + index);
+                        tokens.insert(tokens.begin() + index, macro.second.begin(), macro.second.end());
+                        index += macro.second.size() - 1;
+                    }
+                }
+            }
+        }
+
+        // Folds "a op b" of two literals of the same type where that is how
+        // it is evaluated, and drops parentheses around a single literal.
+        uint16_t Fold(Tokens& tokens)
+        {
+            uint16_t folded(0);
+            size_t index(1);
+
+            while ((index + 1) < tokens.size()) {
+                const string& operation(tokens[index]);
+                bool changed(false);
+                Literal left, right;
+
+                if (((operation == "+") || (operation == "-") || (operation == "*") || (operation == "/"))
+                    && (Parse(tokens[index - 1], left) == true) && (Parse(tokens[index + 1], right) == true) && (left.Float == right.Float)) {
+
+                    const bool additive((operation == "+") || (operation == "-"));
+                    const string* before((index >= 2) ? &tokens[index - 2] : nullptr);
+                    const string* after(((index + 2) < tokens.size()) ? &tokens[index + 2] : nullptr);
+
+                    const bool opened((before == nullptr) || (IsOneOf(*before, Boundaries) == true) || ((additive == false) && ((*before == "+") || (*before == "-"))));
+                    const bool closed((after == nullptr) || ((*after != ".") && (*after != "[") && ((additive == false) || ((*after != "*") && (*after != "/")))));
+
+                    if ((opened == true) && (closed == true) && ((operation != "/") || (right.Value != 0))) {
+                        Literal value = { left.Float, 0 };
+                        string token;
+
+                        switch (operation[0]) {
+                        case '+':
+                            value.Value = left.Value + right.Value;
+                            break;
+                        case '-':
+                            value.Value = left.Value - right.Value;
+                            break;
+                        case '*':
+                            value.Value = left.Value * right.Value;
+                            break;
+                        default:
+                            value.Value = (left.Float == true) ? (left.Value / right.Value) : std::trunc(left.Value / right.Value);
+                            break;
+                        }
+
+                        if (Format(value, token) == true) {
+                            tokens[index - 1] = token;
+                            tokens.erase(tokens.begin() + index, tokens.begin() + index + 2);
+                            changed = true;
+                        }
+                    }
+                } else if ((tokens[index - 1] == "(") && (tokens[index + 1] == ")") && (IsNumber(tokens[index]) == true)) {
+                    // Not the parentheses of a call or a constructor.
+                    const bool call((index >= 2) && (((IsIdentifier(tokens[index - 2]) == true) && (tokens[index - 2] != "return")) || (tokens[index - 2] == ")") || (tokens[index - 2] == "]")));
+
+                    if (call == false) {
+                        tokens.erase(tokens.begin() + index + 1);
+                        tokens.erase(tokens.begin() + index - 1);
+                        changed = true;
+                    }
+                }
+
+                if (changed == true) {
+                    ++folded;
+                    index = (index > 2) ? (index - 2) : 1;
+                } else {
+                    ++index;
+                }
+            }
+
+            return (folded);
+        }
+
+        // "i++", "++i", "i--", "--i", "i += n" or "i -= n", returns the index past it or 0.
+        size_t Step(const Tokens& tokens, const size_t index, const string& name, const bool floating, Literal& step)
+        {
+            size_t result(0);
+
+            if ((index + 1) < tokens.size()) {
+                step.Float = floating;
+
+                if (((tokens[index] == "++") || (tokens[index] == "--")) && (tokens[index + 1] == name)) {
+                    step.Value = (tokens[index] == "++") ? 1 : -1;
+                    result = index + 2;
+                } else if ((tokens[index] == name) && ((tokens[index + 1] == "++") || (tokens[index + 1] == "--"))) {
+                    step.Value = (tokens[index + 1] == "++") ? 1 : -1;
+                    result = index + 2;
+                } else if ((tokens[index] == name) && ((tokens[index + 1] == "+=") || (tokens[index + 1] == "-="))) {
+                    result = Signed(tokens, index + 2, step);
+                    step.Value = (tokens[index + 1] == "-=") ? -step.Value : step.Value;
+                }
+            }
+
+            return (result);
+        }
+
+        bool Compare(const double value, const string& comparison, const double bound)
+        {
+            return ((comparison == "<") ? (value < bound) : (comparison == "<=") ? (value <= bound) : (comparison == ">") ? (value > bound) : (value >= bound));
+        }
+
+        // "for (int|float i = a; i <|<=|>|>= b; step) { ... }" with literals a,
+        // b and step, and at most limit iterations.
+        bool Match(const Tokens& tokens, const size_t index, const uint16_t limit, Loop& loop)
+        {
+            bool result(false);
+            size_t position(index + 1);
+
+            if (((position + 4) < tokens.size()) && (tokens[position] == "(") && ((tokens[position + 1] == "int") || (tokens[position + 1] == "float")) && (IsIdentifier(tokens[position + 2]) == true) && (tokens[position + 3] == "=")) {
+                const bool floating(tokens[position + 1] == "float");
+                Literal first, bound, step;
+
+                loop.Type = tokens[position + 1];
+                loop.Name = tokens[position + 2];
+
+                position = Signed(tokens, position + 4, first);
+
+                if ((position != 0) && ((position + 3) < tokens.size()) && (tokens[position] == ";") && (tokens[position + 1] == loop.Name) && (IsOneOf(tokens[position + 2], Comparisons) == true)) {
+                    const string comparison(tokens[position + 2]);
+
+                    position = Signed(tokens, position + 3, bound);
+
+                    if ((position != 0) && ((position + 1) < tokens.size()) && (tokens[position] == ";")) {
+                        position = Step(tokens, position + 1, loop.Name, floating, step);
+
+                        if ((position != 0) && ((position + 1) < tokens.size()) && (tokens[position] == ")") && (tokens[position + 1] == "{")
+                            && (first.Float == floating) && (bound.Float == floating) && (step.Float == floating)) {
+
+                            loop.Body = position + 1;
+                            loop.End = Close(tokens, loop.Body);
+                            result = (loop.End != 0);
+
+                            double value(first.Value);
+
+                            while ((result == true) && (Compare(value, comparison, bound.Value) == true)) {
+                                if (loop.Values.size() >= limit) {
+                                    result = false;
+                                } else {
+                                    loop.Values.push_back(value);
+
+                                    // Stepped the way the shader does it.
+                                    value = (floating == true) ? static_cast<double>(static_cast<float>(value) + static_cast<float>(step.Value)) : (value + step.Value);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            return (result);
+        }
+
+        // No break or continue and the loop variable not written. A body that
+        // declares a variable of the same name keeps the loop variable as a
+        // constant instead of having it substituted.
+        bool Unrollable(const Tokens& tokens, const Loop& loop, bool& shadowed)
+        {
+            bool result(true);
+
+            shadowed = false;
+
+            for (size_t index = loop.Body + 1; (index < (loop.End - 1)) && (result == true); ++index) {
+                const string& token(tokens[index]);
+
+                if ((token == "break") || (token == "continue")) {
+                    result = false;
+                } else if ((token == loop.Name) && (tokens[index - 1] != ".")) {
+                    if (IsOneOf(tokens[index - 1], Types) == true) {
+                        shadowed = true;
+                    } else if ((IsOneOf(tokens[index + 1], Assignments) == true) || (tokens[index - 1] == "++") || (tokens[index - 1] == "--")) {
+                        result = false;
+                    }
+                }
+            }
+
+            return (result);
+        }
+
+        // Nested loops are unrolled in the copies of the outer body.
+        uint16_t Unroll(Tokens& tokens)
+        {
+            uint16_t unrolled(0);
+
+            for (size_t index = 0; (index < tokens.size()) && (tokens.size() < MaxTokens); ++index) {
+                Loop loop;
+                bool shadowed(false);
+
+                if ((tokens[index] == "for")
+                    && (Match(tokens, index, ShaderOptimizer::MaxTrips, loop) == true)
+                    && (Unrollable(tokens, loop, shadowed) == true)
+                    && (((loop.End - loop.Body) * loop.Values.size()) <= ShaderOptimizer::MaxUnrolled)) {
+
+                    const bool floating(loop.Type == "float");
+                    Tokens expansion;
+
+                    for (const double value : loop.Values) {
+                        Tokens literal;
+
+                        Emit(value, floating, literal);
+
+                        if (shadowed == true) {
+                            expansion.push_back("{");
+                            expansion.push_back("const");
+                            expansion.push_back(loop.Type);
+                            expansion.push_back(loop.Name);
+                            expansion.push_back("=");
+                            expansion.insert(expansion.end(), literal.begin(), literal.end());
+                            expansion.push_back(";");
+                            expansion.insert(expansion.end(), tokens.begin() + loop.Body, tokens.begin() + loop.End);
+                            expansion.push_back("}");
+                        } else {
+                            for (size_t position = loop.Body; position < loop.End; ++position) {
+                                if ((tokens[position] == loop.Name) && (tokens[position - 1] != ".")) {
+                                    expansion.insert(expansion.end(), literal.begin(), literal.end());
+                                } else {
+                                    expansion.push_back(tokens[position]);
+                                }
+                            }
+                        }
+                    }
+
+                    tokens.erase(tokens.begin() + index, tokens.begin() + loop.End);
+                    tokens.insert(tokens.begin() + index, expansion.begin(), expansion.end());
+
+                    ++unrolled;
+                    --index;
+                }
+            }
+
+            return (unrolled);
+        }
+
+        // Type of every name declared with only one type.
+        void Declarations(const Tokens& tokens, std::map<string, string>& types)
+        {
+            for (size_t index = 1; (index + 1) < tokens.size(); ++index) {
+                if ((IsOneOf(tokens[index - 1], Types) == true) && (IsIdentifier(tokens[index]) == true) && (tokens[index + 1] != "(")) {
+                    std::pair<std::map<string, string>::iterator, bool> entry(types.emplace(tokens[index], tokens[index - 1]));
+
+                    if ((entry.second == false) && (entry.first->second != tokens[index - 1])) {
+                        entry.first->second.clear();
+                    }
+                }
+            }
+        }
+
+        // A float literal, a float variable or one component of a vector,
+        // returns the index past it or 0.
+        size_t Operand(const Tokens& tokens, const size_t index, const std::map<string, string>& types, Tokens& operand)
+        {
+            Literal literal;
+            size_t end(Signed(tokens, index, literal));
+
+            if (end != 0) {
+                end = (literal.Float == true) ? end : 0;
+            } else if ((index < tokens.size()) && (IsIdentifier(tokens[index]) == true)) {
+                std::map<string, string>::const_iterator entry(types.find(tokens[index]));
+
+                if (entry != types.end()) {
+                    if (entry->second == "float") {
+                        end = index + 1;
+                    } else if ((entry->second.compare(0, 3, "vec") == 0) && ((index + 2) < tokens.size()) && (tokens[index + 1] == ".") && (tokens[index + 2].size() == 1) && (strchr("xyzwrgbastpq", tokens[index + 2][0]) != nullptr)) {
+                        end = index + 3;
+                    }
+                }
+
+                if ((end != 0) && ((end >= tokens.size()) || (tokens[end] == ".") || (tokens[end] == "[") || (tokens[end] == "("))) {
+                    end = 0;
+                }
+            }
+
+            if (end != 0) {
+                operand.assign(tokens.begin() + index, tokens.begin() + end);
+            }
+
+            return (end);
+        }
+
+        // "if (a < b && c >= d) { x = e; }" without else, on floats, becomes
+        // "x = mix(x, (e), (1.0 - step(b, a)) * step(d, c));". The expression
+        // may only use constructors and + - *, it is now always evaluated.
+        uint16_t Branches(Tokens& tokens)
+        {
+            uint16_t converted(0);
+            std::map<string, string> types;
+
+            Declarations(tokens, types);
+
+            for (size_t index = 0; (index + 1) < tokens.size(); ++index) {
+                if ((tokens[index] != "if") || (tokens[index + 1] != "(")) {
+                    continue;
+                }
+
+                Tokens weight;
+                size_t position(index + 2);
+                bool valid(true);
+                bool more(true);
+
+                while ((valid == true) && (more == true)) {
+                    Tokens left, right;
+
+                    position = Operand(tokens, position, types, left);
+
+                    if ((position != 0) && (position < tokens.size()) && (IsOneOf(tokens[position], Comparisons) == true)) {
+                        const string comparison(tokens[position]);
+
+                        position = Operand(tokens, position + 1, types, right);
+
+                        if (position != 0) {
+                            // a >= b is step(b, a), a <= b is step(a, b), < and > are their complement.
+                            const bool swapped((comparison == ">=") || (comparison == "<"));
+                            const bool inverted((comparison == "<") || (comparison == ">"));
+                            const Tokens& edge((swapped == true) ? right : left);
+                            const Tokens& value((swapped == true) ? left : right);
+
+                            if (weight.empty() == false) {
+                                weight.push_back("*");
+                            }
+
+                            if (inverted == true) {
+                                weight.push_back("(");
+                                weight.push_back("1.0");
+                                weight.push_back("-");
+                            }
+
+                            weight.push_back("step");
+                            weight.push_back("(");
+                            weight.insert(weight.end(), edge.begin(), edge.end());
+                            weight.push_back(",");
+                            weight.insert(weight.end(), value.begin(), value.end());
+                            weight.push_back(")");
+
+                            if (inverted == true) {
+                                weight.push_back(")");
+                            }
+
+                            if ((position < tokens.size()) && (tokens[position] == "&&")) {
+                                ++position;
+                            } else {
+                                more = false;
+                            }
+                        }
+                    } else {
+                        position = 0;
+                    }
+
+                    valid = (position != 0);
+                }
+
+                if ((valid == true) && ((position + 4) < tokens.size()) && (tokens[position] == ")") && (tokens[position + 1] == "{") && (tokens[position + 3] == "=")) {
+                    const string& target(tokens[position + 2]);
+                    std::map<string, string>::const_iterator entry(types.find(target));
+
+                    valid = (entry != types.end()) && ((entry->second == "float") || (entry->second.compare(0, 3, "vec") == 0));
+
+                    size_t end(position + 4);
+                    int32_t depth(0);
+
+                    while ((valid == true) && (end < tokens.size()) && ((tokens[end] != ";") || (depth != 0))) {
+                        const string& token(tokens[end]);
+
+                        if ((IsIdentifier(token) == true) && ((end + 1) < tokens.size()) && (tokens[end + 1] == "(")) {
+                            valid = IsOneOf(token, Constructors);
+                        } else {
+                            valid = (IsIdentifier(token) == true) || (IsNumber(token) == true) || (IsOneOf(token, Expression) == true);
+                        }
+
+                        depth += (token == "(") ? 1 : ((token == ")") ? -1 : 0);
+                        ++end;
+                    }
+
+                    valid = (valid == true) && ((end + 1) < tokens.size()) && (end > (position + 4)) && (tokens[end + 1] == "}") && (((end + 2) >= tokens.size()) || (tokens[end + 2] != "else"));
+
+                    if (valid == true) {
+                        Tokens replacement = { target, "=", "mix", "(", target, ",", "(" };
+
+                        replacement.insert(replacement.end(), tokens.begin() + position + 4, tokens.begin() + end);
+                        replacement.push_back(")");
+                        replacement.push_back(",");
+                        replacement.insert(replacement.end(), weight.begin(), weight.end());
+                        replacement.push_back(")");
+                        replacement.push_back(";");
+
+                        tokens.erase(tokens.begin() + index, tokens.begin() + end + 2);
+                        tokens.insert(tokens.begin() + index, replacement.begin(), replacement.end());
+
+                        ++converted;
+                    }
+                }
+            }
+
+            return (converted);
+        }
+
+        int8_t Rank(const string& precision)
+        {
+            return ((precision == "lowp") ? 0 : (precision == "mediump") ? 1 : (precision == "highp") ? 2 : -1);
+        }
+
+        // Applies "#pragma screensaver precision lowp|mediump" to the default
+        // float precision, never raising it.
+        bool Precision(Tokens& tokens)
+        {
+            string target;
+            bool lowered(false);
+
+            for (size_t index = 0; index < tokens.size(); ++index) {
+                if (IsDirective(tokens[index]) == true) {
+                    const std::vector<string> words(Words(tokens[index]));
+
+                    if ((words.size() == 4) && (words[0] == "pragma") && (words[1] == "screensaver") && (words[2] == "precision") && (Rank(words[3]) >= 0) && (Rank(words[3]) < 2)) {
+                        target = words[3];
+                        tokens.erase(tokens.begin() + index);
+                        --index;
+                    }
+                }
+            }
+
+            if (target.empty() == false) {
+                for (size_t index = 0; (index + 3) < tokens.size(); ++index) {
+                    if ((tokens[index] == "precision") && (tokens[index + 2] == "float") && (tokens[index + 3] == ";") && (Rank(tokens[index + 1]) > Rank(target))) {
+                        tokens[index + 1] = target;
+                        lowered = true;
+                    }
+                }
+            }
+
+            return (lowered);
+        }
+
+        uint32_t Cost(const Tokens& tokens, const size_t begin, const size_t end)
+        {
+            uint32_t cost(0);
+
+            for (size_t index = begin; index < end; ++index) {
+                const string& token(tokens[index]);
+                Loop loop;
+
+                if ((token == "for") && (Match(tokens, index, EstimateTrips, loop) == true) && (loop.End <= end)) {
+                    // The compare and the step of each iteration included.
+                    cost += static_cast<uint32_t>(loop.Values.size()) * (Cost(tokens, loop.Body + 1, loop.End - 1) + 2);
+                    index = loop.End - 1;
+                } else if (IsOneOf(token, Operations) == true) {
+                    ++cost;
+                } else if ((IsIdentifier(token) == true) && ((index + 1) < end) && (tokens[index + 1] == "(") && (IsOneOf(token, Statements) == false) && (IsOneOf(token, Types) == false)) {
+                    ++cost;
+                }
+            }
+
+            return (cost);
+        }
+
+        uint64_t Ticks() // in us
+        {
+            return (Core::Time::Now().Ticks());
+        }
+    }
+
+    ShaderOptimizer::ShaderOptimizer()
+        : _lock()
+        , _enabled(false)
+        , _path()
+        , _results()
+        , _optimized(0)
+        , _hits(0)
+        , _rejected(0)
+    {
+    }
+
+    void ShaderOptimizer::Configure(const bool enabled, const string& path)
+    {
+        _enabled = enabled;
+        _path = path;
+
+        if ((_enabled == true) && (_path.empty() == false) && (Core::Directory(_path.c_str()).CreatePath() == false)) {
+            TRACE(Trace::Error, ("Could not create optimizer cache %s", _path.c_str()));
+            _path.clear();
+        }
+    }
+
+    /* static */ uint32_t ShaderOptimizer::Estimate(const string& source)
+    {
+        Tokens tokens;
+
+        // Constants as any compiler would see them.
+        Tokenize(source, tokens);
+        Substitute(tokens);
+        Fold(tokens);
+
+        return (Cost(tokens, 0, tokens.size()));
+    }
+
+    string ShaderOptimizer::Optimize(const string& source)
+    {
+        string result(source);
+
+        if (_enabled == true) {
+            const uint64_t key(ProgramCache::Hash(source, ProgramCache::Hash(std::to_string(Revision))));
+
+            _lock.Lock();
+
+            std::map<uint64_t, string>::const_iterator entry(_results.find(key));
+            const bool resident(entry != _results.end());
+
+            if (resident == true) {
+                result = entry->second;
+            }
+
+            _lock.Unlock();
+
+            if ((resident == true) || (Load(key, result) == true)) {
+                ++_hits;
+            } else {
+                const uint64_t start(Ticks());
+                Tokens tokens;
+
+                Tokenize(source, tokens);
+
+                const bool lowered(Precision(tokens));
+
+                Substitute(tokens);
+
+                uint16_t folded(Fold(tokens));
+                uint16_t unrolled(0);
+                uint16_t pass(0);
+
+                do {
+                    pass = Unroll(tokens);
+                    folded += Fold(tokens);
+                    unrolled += pass;
+                } while (pass != 0);
+
+                const uint16_t branches(Branches(tokens));
+
+                if ((lowered == true) || (folded > 0) || (unrolled > 0) || (branches > 0)) {
+                    result = Serialize(tokens);
+
+                    const uint32_t duration(static_cast<uint32_t>(Ticks() - start));
+
+                    ++_optimized;
+
+                    TRACE(Trace::Information, ("Shader %016llx optimized in %d.%03dms: %d loops unrolled, %d constants folded, %d branches removed%s, estimate %d -> %d operations", static_cast<unsigned long long>(key), duration / 1000, duration % 1000, unrolled, folded, branches, (lowered == true) ? ", precision lowered" : "", Estimate(source), Estimate(result)));
+                } else {
+                    TRACE(Trace::Information, ("Shader %016llx left as is, estimate %d operations", static_cast<unsigned long long>(key), Estimate(source)));
+                }
+
+                Store(key, result);
+            }
+
+            if (resident == false) {
+                Core::SafeSyncType<Core::CriticalSection> scopedLock(_lock);
+                _results.emplace(key, result);
+            }
+        }
+
+        return (result);
+    }
+
+    string ShaderOptimizer::FileName(const uint64_t key) const
+    {
+        char name[24];
+
+        snprintf(name, sizeof(name), "%016llx.frag", static_cast<unsigned long long>(key));
+
+        return (_path + name);
+    }
+
+    bool ShaderOptimizer::Load(const uint64_t key, string& source) const
+    {
+        bool result(false);
+
+        if (_path.empty() == false) {
+            Core::File file(FileName(key));
+
+            if ((file.Exists() == true) && (file.Open(true) == true)) {
+                string content(static_cast<size_t>(file.Size()), '\0');
+
+                if ((content.empty() == false) && (file.Read(reinterpret_cast<uint8_t*>(&content[0]), static_cast<uint32_t>(content.size())) == content.size())) {
+                    source.swap(content);
+                    result = true;
+                }
+
+                file.Close();
+            }
+        }
+
+        return (result);
+    }
+
+    void ShaderOptimizer::Store(const uint64_t key, const string& source) const
+    {
+        if (_path.empty() == false) {
+            const string name(FileName(key));
+
+            if (WriteAtomic(name, reinterpret_cast<const uint8_t*>(source.c_str()), static_cast<uint32_t>(source.size())) == false) {
+                TRACE(Trace::Error, ("Could not store optimized shader %s", name.c_str()));
+            }
+        }
+    }
+
+} // namespace Graphics
+} // namespace Thunder
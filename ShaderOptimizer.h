@@ -0,0 +1,112 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include <atomic>
+#include <map>
+
+namespace Thunder {
+namespace Graphics {
+    // Source to source pass over fragment shaders, for drivers that leave the
+    // ShaderToy ports mostly as written:
+    // - object-like #defines of a number are substituted, constant arithmetic is folded,
+    // - for loops with literal bounds and at most MaxTrips iterations are unrolled,
+    // - "if (a < b && ...) { x = e; }" on floats becomes "x = mix(x, e, step(...));",
+    // - "#pragma screensaver precision lowp" (or mediump) lowers the default float
+    //   precision, for shaders that are known to look the same with it.
+    // The result is a candidate only, a program that fails to build from it is
+    // built from the original source. Results are kept by source hash, in memory
+    // and under the configured path.
+    class EXTERNAL ShaderOptimizer {
+    public:
+        static constexpr uint8_t MaxTrips = 16;
+        static constexpr uint16_t MaxUnrolled = 4096; // tokens a single loop may expand to
+
+    private:
+        friend Core::SingletonType<ShaderOptimizer>;
+        ShaderOptimizer();
+
+    public:
+        ShaderOptimizer(const ShaderOptimizer&) = delete;
+        ShaderOptimizer& operator=(const ShaderOptimizer&) = delete;
+        ~ShaderOptimizer() = default;
+
+        static ShaderOptimizer& Instance()
+        {
+            return (Core::SingletonType<ShaderOptimizer>::Instance());
+        }
+
+    public:
+        // Disabled until configured. An empty path keeps the results in memory only.
+        void Configure(const bool enabled, const string& path);
+
+        bool IsEnabled() const
+        {
+            return (_enabled);
+        }
+
+        // The source unchanged if disabled or none of the passes applied.
+        string Optimize(const string& source);
+
+        // Counted by the models that had to fall back to the original source.
+        void Rejected()
+        {
+            ++_rejected;
+        }
+
+        // Rough number of operations: arithmetic, comparisons and calls as
+        // written, the body of a loop with literal bounds once per iteration.
+        static uint32_t Estimate(const string& source);
+
+        uint32_t Optimized() const
+        {
+            return (_optimized);
+        }
+        uint32_t Hits() const
+        {
+            return (_hits);
+        }
+        uint32_t Rejections() const
+        {
+            return (_rejected);
+        }
+
+    private:
+        string FileName(const uint64_t key) const;
+        bool Load(const uint64_t key, string& source) const;
+        void Store(const uint64_t key, const string& source) const;
+
+    private:
+        Core::CriticalSection _lock;
+
+        bool _enabled;
+        string _path;
+
+        std::map<uint64_t, string> _results;
+
+        std::atomic<uint32_t> _optimized;
+        std::atomic<uint32_t> _hits;
+        std::atomic<uint32_t> _rejected;
+    }; // class ShaderOptimizer
+
+} // namespace Graphics
+} // namespace Thunder
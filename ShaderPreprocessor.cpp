@@ -0,0 +1,516 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ShaderPreprocessor.h"
+
+#include "ShaderLibrary.h"
+#include "Tracing.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+
+namespace Thunder {
+namespace Graphics {
+    namespace {
+        constexpr char Blanks[] = " \t\r";
+
+        string Trim(const string& text)
+        {
+            const size_t first(text.find_first_not_of(Blanks));
+            const size_t last(text.find_last_not_of(Blanks));
+
+            return ((first == string::npos) ? string() : text.substr(first, last - first + 1));
+        }
+
+        // Names the driver may define, never decided here.
+        bool IsReserved(const string& name)
+        {
+            return ((name.compare(0, 3, "GL_") == 0) || (name.compare(0, 2, "__") == 0));
+        }
+
+        void Split(const string& expression, std::vector<string>& tokens)
+        {
+            static const char* const pairs[] = { "&&", "||", "==", "!=", "<=", ">=" };
+            size_t index(0);
+
+            while (index < expression.size()) {
+                const char c(expression[index]);
+                size_t end(index + 1);
+
+                if (isspace(static_cast<unsigned char>(c)) != 0) {
+                    ++index;
+                    continue;
+                } else if ((isalpha(static_cast<unsigned char>(c)) != 0) || (c == '_')) {
+                    while ((end < expression.size()) && ((isalnum(static_cast<unsigned char>(expression[end])) != 0) || (expression[end] == '_'))) {
+                        ++end;
+                    }
+                } else if (isdigit(static_cast<unsigned char>(c)) != 0) {
+                    while ((end < expression.size()) && (isalnum(static_cast<unsigned char>(expression[end])) != 0)) {
+                        ++end;
+                    }
+                } else {
+                    for (const char* pair : pairs) {
+                        if (expression.compare(index, 2, pair) == 0) {
+                            end = index + 2;
+                        }
+                    }
+                }
+
+                tokens.push_back(expression.substr(index, end - index));
+                index = end;
+            }
+        }
+
+        // Integer expression of #if, C precedence. Fails on anything it can
+        // not decide, the directive is then left to the compiler.
+        class Expression {
+        public:
+            Expression() = delete;
+            Expression(const Expression&) = delete;
+            Expression& operator=(const Expression&) = delete;
+
+            Expression(const std::map<string, string>& macros, const std::set<string>& unknown, const uint8_t depth)
+                : _macros(macros)
+                , _unknown(unknown)
+                , _depth(depth)
+                , _tokens()
+                , _index(0)
+                , _valid(true)
+            {
+            }
+            ~Expression() = default;
+
+        public:
+            bool Evaluate(const string& expression, int64_t& value)
+            {
+                Split(expression, _tokens);
+
+                value = Binary(0);
+
+                return ((_valid == true) && (_index == _tokens.size()));
+            }
+
+        private:
+            const string& Peek() const
+            {
+                static const string end;
+
+                return ((_index < _tokens.size()) ? _tokens[_index] : end);
+            }
+
+            // Levels from || (0) down to * / % (5).
+            static int8_t Level(const string& operation)
+            {
+                static const char* const levels[][4] = {
+                    { "||", nullptr, nullptr, nullptr },
+                    { "&&", nullptr, nullptr, nullptr },
+                    { "==", "!=", nullptr, nullptr },
+                    { "<", ">", "<=", ">=" },
+                    { "+", "-", nullptr, nullptr },
+                    { "*", "/", "%", nullptr }
+                };
+
+                int8_t result(-1);
+
+                for (uint8_t level = 0; (level < 6) && (result < 0); ++level) {
+                    for (uint8_t index = 0; (index < 4) && (levels[level][index] != nullptr); ++index) {
+                        if (operation == levels[level][index]) {
+                            result = level;
+                        }
+                    }
+                }
+
+                return (result);
+            }
+
+            int64_t Binary(const int8_t level)
+            {
+                int64_t left((level < 6) ? Binary(level + 1) : Unary());
+
+                while ((_valid == true) && (level < 6) && (Level(Peek()) == level)) {
+                    const string operation(_tokens[_index++]);
+                    const int64_t right(Binary(level + 1));
+
+                    if (operation == "||") {
+                        left = ((left != 0) || (right != 0));
+                    } else if (operation == "&&") {
+                        left = ((left != 0) && (right != 0));
+                    } else if (operation == "==") {
+                        left = (left == right);
+                    } else if (operation == "!=") {
+                        left = (left != right);
+                    } else if (operation == "<") {
+                        left = (left < right);
+                    } else if (operation == ">") {
+                        left = (left > right);
+                    } else if (operation == "<=") {
+                        left = (left <= right);
+                    } else if (operation == ">=") {
+                        left = (left >= right);
+                    } else if (operation == "+") {
+                        left = left + right;
+                    } else if (operation == "-") {
+                        left = left - right;
+                    } else if (operation == "*") {
+                        left = left * right;
+                    } else if (right == 0) {
+                        _valid = false;
+                    } else {
+                        left = (operation == "/") ? (left / right) : (left % right);
+                    }
+                }
+
+                return (left);
+            }
+
+            int64_t Unary()
+            {
+                int64_t result(0);
+                const string token(Peek());
+
+                ++_index;
+
+                if (token == "!") {
+                    result = (Unary() == 0);
+                } else if (token == "-") {
+                    result = -Unary();
+                } else if (token == "+") {
+                    result = Unary();
+                } else if (token == "(") {
+                    result = Binary(0);
+                    _valid = _valid && (Peek() == ")");
+                    ++_index;
+                } else if (token == "defined") {
+                    const bool parenthesized(Peek() == "(");
+
+                    _index += (parenthesized == true) ? 1 : 0;
+
+                    const string name(Peek());
+
+                    ++_index;
+
+                    if ((parenthesized == true) && (Peek() != ")")) {
+                        _valid = false;
+                    }
+
+                    _index += (parenthesized == true) ? 1 : 0;
+
+                    if (_macros.find(name) != _macros.end()) {
+                        result = 1;
+                    } else if ((_unknown.find(name) != _unknown.end()) || (IsReserved(name) == true) || (name.empty() == true)) {
+                        _valid = false;
+                    }
+                } else if ((token.empty() == false) && (isdigit(static_cast<unsigned char>(token[0])) != 0)) {
+                    char* end(nullptr);
+
+                    result = strtoll(token.c_str(), &end, 0);
+                    _valid = _valid && (*end == '\0');
+                } else {
+                    // A macro by its value, anything else is an error for a GLSL
+                    // compiler, let it report that.
+                    std::map<string, string>::const_iterator macro(_macros.find(token));
+
+                    if ((macro != _macros.end()) && (macro->second.empty() == false) && (_depth < ShaderPreprocessor::MaxDepth)) {
+                        Expression nested(_macros, _unknown, _depth + 1);
+
+                        _valid = _valid && nested.Evaluate(macro->second, result);
+                    } else {
+                        _valid = false;
+                    }
+                }
+
+                return (result);
+            }
+
+        private:
+            const std::map<string, string>& _macros;
+            const std::set<string>& _unknown;
+            const uint8_t _depth;
+            std::vector<string> _tokens;
+            size_t _index;
+            bool _valid;
+        };
+    }
+
+    bool ShaderPreprocessor::Process(const string& source, const Defines& defines, string& output)
+    {
+        _macros.clear();
+        _unknown.clear();
+        _included.clear();
+        _conditionals.clear();
+
+        output.clear();
+        output.reserve(source.size());
+
+        // #version has to stay the first line.
+        size_t body(0);
+        const size_t start(source.find_first_not_of(" \t\r\n"));
+
+        if ((start != string::npos) && (source.compare(start, 8, "#version") == 0)) {
+            body = source.find('\n', start);
+            body = (body == string::npos) ? source.size() : (body + 1);
+
+            output.append(source, start, body - start);
+
+            if (output.back() != '\n') {
+                output += '\n';
+            }
+        }
+
+        for (const std::pair<string, string>& define : defines) {
+            output += "#define " + define.first;
+
+            if (define.second.empty() == false) {
+                output += ' ' + define.second;
+            }
+
+            output += '\n';
+
+            _macros[define.first] = define.second;
+        }
+
+        bool result(Include(source.substr(body), 0, output));
+
+        if ((result == true) && (_conditionals.empty() == false)) {
+            TRACE(Trace::Error, ("Shader preprocessor: #if without #endif"));
+            result = false;
+        }
+
+        return (result);
+    }
+
+    bool ShaderPreprocessor::Include(const string& text, const uint8_t depth, string& output)
+    {
+        bool result(true);
+        size_t position(0);
+
+        while ((result == true) && (position < text.size())) {
+            size_t end(text.find('\n', position));
+            end = (end == string::npos) ? text.size() : end;
+
+            string line(text, position, end - position);
+            position = end + 1;
+
+            // Continued directive lines are joined.
+            while ((line.empty() == false) && (line.back() == '\\') && (position < text.size())) {
+                end = text.find('\n', position);
+                end = (end == string::npos) ? text.size() : end;
+
+                line.back() = ' ';
+                line.append(text, position, end - position);
+                position = end + 1;
+            }
+
+            const size_t first(line.find_first_not_of(Blanks));
+
+            if ((first != string::npos) && (line[first] == '#')) {
+                result = Directive(line, first, depth, output);
+            } else if (Live() == true) {
+                output += line;
+                output += '\n';
+            }
+        }
+
+        return (result);
+    }
+
+    bool ShaderPreprocessor::Directive(const string& line, const size_t start, const uint8_t depth, string& output)
+    {
+        bool result(true);
+
+        string content(line.substr(start + 1));
+        const size_t comment(content.find("//"));
+
+        if (comment != string::npos) {
+            content.erase(comment);
+        }
+
+        content = Trim(content);
+
+        size_t split(0);
+
+        while ((split < content.size()) && (isalpha(static_cast<unsigned char>(content[split])) != 0)) {
+            ++split;
+        }
+
+        const string name(content.substr(0, split));
+        const string rest(Trim(content.substr(split)));
+
+        if ((name == "if") || (name == "ifdef") || (name == "ifndef")) {
+            Conditional conditional = { true, false, true };
+
+            if (Live() == true) {
+                const string expression((name == "if") ? rest : (((name == "ifdef") ? "defined " : "!defined ") + rest));
+                int64_t value(0);
+
+                if (Evaluate(expression, value) == true) {
+                    conditional.Active = (value != 0);
+                    conditional.Taken = conditional.Active;
+                } else {
+                    conditional = { false, true, false };
+                    output += line + '\n';
+                }
+            }
+
+            _conditionals.push_back(conditional);
+        } else if ((name == "elif") || (name == "else") || (name == "endif")) {
+            if (_conditionals.empty() == true) {
+                TRACE(Trace::Error, ("Shader preprocessor: #%s without #if", name.c_str()));
+                result = false;
+            } else {
+                Conditional& conditional(_conditionals.back());
+                const bool live(Live(_conditionals.size() - 1));
+
+                if (conditional.Resolved == false) {
+                    output += line + '\n';
+                } else if (name == "else") {
+                    conditional.Active = (live == true) && (conditional.Taken == false);
+                    conditional.Taken = true;
+                } else if (name == "elif") {
+                    int64_t value(0);
+
+                    if ((live == false) || (conditional.Taken == true)) {
+                        conditional.Active = false;
+                    } else if (Evaluate(rest, value) == true) {
+                        conditional.Active = (value != 0);
+                        conditional.Taken = conditional.Active;
+                    } else {
+                        // All branches before were dropped, the compiler takes it from here.
+                        conditional = { false, true, false };
+                        output += "#if " + rest + '\n';
+                    }
+                }
+
+                if (name == "endif") {
+                    _conditionals.pop_back();
+                }
+            }
+        } else if (Live() == true) {
+            if (name == "include") {
+                const size_t open(rest.find_first_of("\"<"));
+                const size_t close((open == string::npos) ? string::npos : rest.find_first_of("\">", open + 1));
+                const string file(((open != string::npos) && (close != string::npos)) ? rest.substr(open + 1, close - open - 1) : string());
+                string source;
+
+                if (depth >= MaxDepth) {
+                    TRACE(Trace::Error, ("Shader preprocessor: includes nested too deep at %s", file.c_str()));
+                    result = false;
+                } else if (_included.find(file) != _included.end()) {
+                    // Only once.
+                } else if ((file.empty() == false) && (Load(file, source) == true)) {
+                    _included.insert(file);
+                    result = Include(source, depth + 1, output);
+                } else {
+                    TRACE(Trace::Error, ("Shader preprocessor: can not include %s", rest.c_str()));
+                    result = false;
+                }
+            } else {
+                if (name == "define") {
+                    Define(rest);
+                } else if (name == "undef") {
+                    _macros.erase(rest);
+
+                    if (Unresolved() == true) {
+                        _unknown.insert(rest);
+                    } else {
+                        _unknown.erase(rest);
+                    }
+                }
+
+                output += line + '\n';
+            }
+        }
+
+        return (result);
+    }
+
+    bool ShaderPreprocessor::Load(const string& name, string& source) const
+    {
+        bool result(false);
+        const ShaderLibrary::Entry* entry(ShaderLibrary::Find(name));
+
+        if (entry != nullptr) {
+            source.assign(entry->Source, entry->Length);
+            result = true;
+        } else if ((_directory.empty() == false) && (name.find("..") == string::npos)) {
+            Core::File file(_directory + name);
+
+            if ((file.Exists() == true) && (file.Open(true) == true)) {
+                source.resize(static_cast<size_t>(file.Size()));
+
+                result = (source.empty() == false) && (file.Read(reinterpret_cast<uint8_t*>(&source[0]), static_cast<uint32_t>(source.size())) == source.size());
+
+                file.Close();
+            }
+        }
+
+        return (result);
+    }
+
+    void ShaderPreprocessor::Define(const string& definition)
+    {
+        size_t split(0);
+
+        while ((split < definition.size()) && ((isalnum(static_cast<unsigned char>(definition[split])) != 0) || (definition[split] == '_'))) {
+            ++split;
+        }
+
+        const string name(definition.substr(0, split));
+
+        // Function-like macros are not expanded here, conditions on them are left alone.
+        if ((Unresolved() == true) || ((split < definition.size()) && (definition[split] == '('))) {
+            _macros.erase(name);
+            _unknown.insert(name);
+        } else {
+            _macros[name] = Trim(definition.substr(split));
+            _unknown.erase(name);
+        }
+    }
+
+    bool ShaderPreprocessor::Evaluate(const string& expression, int64_t& value) const
+    {
+        Expression evaluation(_macros, _unknown, 0);
+
+        return (evaluation.Evaluate(expression, value));
+    }
+
+    bool ShaderPreprocessor::Live(const size_t levels) const
+    {
+        bool live(true);
+
+        for (size_t index = 0; (index < levels) && (live == true); ++index) {
+            live = _conditionals[index].Active;
+        }
+
+        return (live);
+    }
+
+    bool ShaderPreprocessor::Unresolved() const
+    {
+        bool unresolved(false);
+
+        for (const Conditional& conditional : _conditionals) {
+            unresolved = unresolved || (conditional.Resolved == false);
+        }
+
+        return (unresolved);
+    }
+
+} // namespace Graphics
+} // namespace Thunder
@@ -0,0 +1,106 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+namespace Thunder {
+namespace Graphics {
+    // Runs ahead of the GLSL compiler:
+    // - #include "name" inserts a shared snippet, linked in (ShaderLibrary) or
+    //   read from the directory, each name only once,
+    // - the given defines are put in front, after a #version line,
+    // - #if/#ifdef/#ifndef/#elif/#else that only depend on these and on the
+    //   #defines of the shader are decided here and the dropped branches left
+    //   out, so the compiler (and the ShaderOptimizer) only sees the selected
+    //   variant. Conditions on names of the driver (GL_ES, extensions) are
+    //   passed on as they are.
+    class EXTERNAL ShaderPreprocessor {
+    public:
+        static constexpr uint8_t MaxDepth = 8; // nested includes
+        static constexpr uint8_t MaxQuality = 3;
+
+        typedef std::vector<std::pair<string, string>> Defines;
+
+    private:
+        struct Conditional {
+            bool Resolved; // decided here, its directives are dropped
+            bool Active; // the lines of the current branch are kept
+            bool Taken; // one of its branches was selected
+        };
+
+    public:
+        ShaderPreprocessor() = delete;
+        ShaderPreprocessor(const ShaderPreprocessor&) = delete;
+        ShaderPreprocessor& operator=(const ShaderPreprocessor&) = delete;
+
+        // Includes that are not linked in are read from directory.
+        ShaderPreprocessor(const string& directory)
+            : _directory(directory)
+            , _macros()
+            , _unknown()
+            , _included()
+            , _conditionals()
+        {
+            if ((_directory.empty() == false) && (_directory.back() != '/')) {
+                _directory += '/';
+            }
+        }
+        ~ShaderPreprocessor() = default;
+
+    public:
+        // "NAME" or "NAME=VALUE".
+        static void Add(Defines& defines, const string& definition)
+        {
+            const size_t separator(definition.find('='));
+
+            defines.emplace_back(definition.substr(0, separator), (separator == string::npos) ? string() : definition.substr(separator + 1));
+        }
+
+        bool Process(const string& source, const Defines& defines, string& output);
+
+    private:
+        bool Include(const string& text, const uint8_t depth, string& output);
+        bool Directive(const string& line, const size_t start, const uint8_t depth, string& output);
+        bool Load(const string& name, string& source) const;
+        void Define(const string& definition);
+        bool Evaluate(const string& expression, int64_t& value) const;
+
+        bool Live(const size_t levels) const;
+        bool Live() const
+        {
+            return (Live(_conditionals.size()));
+        }
+        bool Unresolved() const;
+
+    private:
+        string _directory;
+        std::map<string, string> _macros;
+        std::set<string> _unknown; // (un)defined in a branch left to the compiler
+        std::set<string> _included;
+        std::vector<Conditional> _conditionals;
+    }; // class ShaderPreprocessor
+
+} // namespace Graphics
+} // namespace Thunder
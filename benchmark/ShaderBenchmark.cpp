@@ -0,0 +1,689 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2022 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Renders every fragment shader of a directory through the plugin's model
+// code on an offscreen EGL context, and reports the compile/link time and
+// frame time percentiles as JSON. With a baseline the p50/p95 frame times
+// are compared and a regression is reported with a non-zero exit code.
+
+#include "Module.h"
+
+#include "EGLToolbox.h"
+#include "GpuTimer.h"
+#include "Headless.h"
+#include "IModel.h"
+#include "ProgramCache.h"
+#include "ShaderOptimizer.h"
+
+#ifndef GL_ES_VERSION_2_0
+#include <GLES2/gl2.h>
+#endif
+#include <EGL/egl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <iostream>
+#include <vector>
+
+namespace Thunder {
+namespace Benchmark {
+    constexpr EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_NONE
+    };
+
+    constexpr EGLint contextAttribs[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+
+    constexpr uint16_t WarmupFrames = 10; // not measured, lets the driver settle
+
+    static uint64_t Monotonic() // in us
+    {
+        return (std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    class Statistics : public Core::JSON::Container {
+    public:
+        Statistics& operator=(const Statistics& RHS)
+        {
+            Mean = RHS.Mean;
+            P50 = RHS.P50;
+            P95 = RHS.P95;
+            P99 = RHS.P99;
+
+            return (*this);
+        }
+
+        Statistics(const Statistics& copy)
+            : Core::JSON::Container()
+            , Mean(copy.Mean)
+            , P50(copy.P50)
+            , P95(copy.P95)
+            , P99(copy.P99)
+        {
+            Add(_T("mean"), &Mean);
+            Add(_T("p50"), &P50);
+            Add(_T("p95"), &P95);
+            Add(_T("p99"), &P99);
+        }
+
+        Statistics()
+            : Core::JSON::Container()
+            , Mean(0)
+            , P50(0)
+            , P95(0)
+            , P99(0)
+        {
+            Add(_T("mean"), &Mean);
+            Add(_T("p50"), &P50);
+            Add(_T("p95"), &P95);
+            Add(_T("p99"), &P99);
+        }
+
+        ~Statistics() override = default;
+
+    public:
+        // Samples in us, reported in ms.
+        void Set(std::vector<uint32_t>& samples)
+        {
+            if (samples.empty() == false) {
+                std::sort(samples.begin(), samples.end());
+
+                uint64_t total(0);
+
+                for (const uint32_t sample : samples) {
+                    total += sample;
+                }
+
+                Mean = static_cast<float>(total) / samples.size() / 1000.0f;
+                P50 = Percentile(samples, 50);
+                P95 = Percentile(samples, 95);
+                P99 = Percentile(samples, 99);
+            }
+        }
+
+    private:
+        static float Percentile(const std::vector<uint32_t>& sorted, const uint8_t percentile)
+        {
+            // Nearest rank.
+            const size_t rank((sorted.size() * percentile + 99) / 100);
+
+            return (sorted[(rank > 0) ? (rank - 1) : 0] / 1000.0f);
+        }
+
+    public:
+        Core::JSON::Float Mean; // ms
+        Core::JSON::Float P50; // ms
+        Core::JSON::Float P95; // ms
+        Core::JSON::Float P99; // ms
+    };
+
+    class Result : public Core::JSON::Container {
+    public:
+        Result& operator=(const Result& RHS)
+        {
+            Vertex = RHS.Vertex;
+            Fragment = RHS.Fragment;
+            Width = RHS.Width;
+            Height = RHS.Height;
+            Frames = RHS.Frames;
+            Compile = RHS.Compile;
+            Link = RHS.Link;
+            Construct = RHS.Construct;
+            Frame = RHS.Frame;
+            Gpu = RHS.Gpu;
+
+            return (*this);
+        }
+
+        Result(const Result& copy)
+            : Core::JSON::Container()
+            , Vertex(copy.Vertex)
+            , Fragment(copy.Fragment)
+            , Width(copy.Width)
+            , Height(copy.Height)
+            , Frames(copy.Frames)
+            , Compile(copy.Compile)
+            , Link(copy.Link)
+            , Construct(copy.Construct)
+            , Frame(copy.Frame)
+            , Gpu(copy.Gpu)
+        {
+            Init();
+        }
+
+        Result()
+            : Core::JSON::Container()
+            , Vertex()
+            , Fragment()
+            , Width(0)
+            , Height(0)
+            , Frames(0)
+            , Compile(0)
+            , Link(0)
+            , Construct(0)
+            , Frame()
+            , Gpu()
+        {
+            Init();
+        }
+
+        ~Result() override = default;
+
+    private:
+        void Init()
+        {
+            Add(_T("vertex"), &Vertex);
+            Add(_T("fragment"), &Fragment);
+            Add(_T("width"), &Width);
+            Add(_T("height"), &Height);
+            Add(_T("frames"), &Frames);
+            Add(_T("compile"), &Compile);
+            Add(_T("link"), &Link);
+            Add(_T("construct"), &Construct);
+            Add(_T("frame"), &Frame);
+            Add(_T("gpu"), &Gpu);
+        }
+
+    public:
+        Core::JSON::String Vertex;
+        Core::JSON::String Fragment;
+        Core::JSON::DecUInt16 Width;
+        Core::JSON::DecUInt16 Height;
+        Core::JSON::DecUInt32 Frames;
+        Core::JSON::Float Compile; // ms
+        Core::JSON::Float Link; // ms
+        Core::JSON::Float Construct; // ms, program, buffers and first state
+        Statistics Frame; // CPU time including glFinish
+        Statistics Gpu; // GL_EXT_disjoint_timer_query, when available
+    };
+
+    class Report : public Core::JSON::Container {
+    public:
+        Report(const Report&) = delete;
+        Report& operator=(const Report&) = delete;
+
+        Report()
+            : Core::JSON::Container()
+            , Renderer()
+            , Version()
+            , Results()
+        {
+            Add(_T("renderer"), &Renderer);
+            Add(_T("version"), &Version);
+            Add(_T("results"), &Results);
+        }
+
+        ~Report() override = default;
+
+    public:
+        Core::JSON::String Renderer;
+        Core::JSON::String Version;
+        Core::JSON::ArrayType<Result> Results;
+    };
+
+    class Options {
+    public:
+        Options(const Options&) = delete;
+        Options& operator=(const Options&) = delete;
+
+        Options()
+            : Shaders(_T("shaders"))
+            , Frames(300)
+            , Resolutions()
+            , Baseline()
+            , Output()
+            , Tolerance(10)
+            , Optimize(false)
+        {
+        }
+        ~Options() = default;
+
+    public:
+        bool Parse(int argc, char* argv[])
+        {
+            static const struct option options[] = {
+                { "shaders", required_argument, nullptr, 's' },
+                { "frames", required_argument, nullptr, 'n' },
+                { "resolution", required_argument, nullptr, 'r' },
+                { "baseline", required_argument, nullptr, 'b' },
+                { "output", required_argument, nullptr, 'o' },
+                { "tolerance", required_argument, nullptr, 't' },
+                { "optimize", no_argument, nullptr, 'O' },
+                { "help", no_argument, nullptr, 'h' },
+                { nullptr, 0, nullptr, 0 }
+            };
+
+            bool result(true);
+            int option;
+
+            while ((result == true) && ((option = getopt_long(argc, argv, "s:n:r:b:o:t:Oh", options, nullptr)) != -1)) {
+                switch (option) {
+                case 's':
+                    Shaders = optarg;
+                    break;
+                case 'n':
+                    Frames = static_cast<uint32_t>(std::max(1, atoi(optarg)));
+                    break;
+                case 'r': {
+                    unsigned int width(0), height(0);
+
+                    if ((sscanf(optarg, "%ux%u", &width, &height) == 2) && (width > 0) && (height > 0)) {
+                        Resolutions.emplace_back(static_cast<uint16_t>(width), static_cast<uint16_t>(height));
+                    } else {
+                        std::cerr << "Invalid resolution " << optarg << ", expected <width>x<height>" << std::endl;
+                        result = false;
+                    }
+                    break;
+                }
+                case 'b':
+                    Baseline = optarg;
+                    break;
+                case 'o':
+                    Output = optarg;
+                    break;
+                case 't':
+                    Tolerance = static_cast<float>(atof(optarg));
+                    break;
+                case 'O':
+                    Optimize = true;
+                    break;
+                default:
+                    result = false;
+                    break;
+                }
+            }
+
+            if (Resolutions.empty() == true) {
+                Resolutions.emplace_back(1280, 720);
+                Resolutions.emplace_back(1920, 1080);
+            }
+
+            if (result == false) {
+                std::cerr << "Usage: " << argv[0] << " [options]" << std::endl
+                          << "  -s, --shaders <dir>        directory with the .frag/.vert files (default: shaders)" << std::endl
+                          << "  -n, --frames <count>       measured frames per shader and resolution (default: 300)" << std::endl
+                          << "  -r, --resolution <WxH>     repeatable (default: 1280x720 and 1920x1080)" << std::endl
+                          << "  -b, --baseline <file>      compare with a previous report" << std::endl
+                          << "  -t, --tolerance <percent>  allowed p50/p95 increase over the baseline (default: 10)" << std::endl
+                          << "  -o, --output <file>        write the report to a file instead of stdout" << std::endl
+                          << "  -O, --optimize             run the fragment shaders through the shader optimizer" << std::endl;
+            }
+
+            return (result);
+        }
+
+    public:
+        string Shaders;
+        uint32_t Frames;
+        std::vector<Graphics::SizeType> Resolutions;
+        string Baseline;
+        string Output;
+        float Tolerance;
+        bool Optimize;
+    };
+
+    class Bench {
+    public:
+        Bench(const Bench&) = delete;
+        Bench& operator=(const Bench&) = delete;
+
+        Bench()
+            : _display(EGL_NO_DISPLAY)
+            , _config(nullptr)
+            , _context(EGL_NO_CONTEXT)
+            , _surface(EGL_NO_SURFACE)
+            , _width(0)
+            , _height(0)
+            , _timer()
+        {
+        }
+        ~Bench()
+        {
+            Deinitialize();
+        }
+
+    public:
+        bool Initialize()
+        {
+            EGLint count(0);
+
+            _display = Graphics::Headless::Platform();
+
+            if ((_display != EGL_NO_DISPLAY)
+                && (eglInitialize(_display, nullptr, nullptr) == EGL_TRUE)
+                && (eglBindAPI(EGL_OPENGL_ES_API) == EGL_TRUE)
+                && (eglChooseConfig(_display, configAttribs, &_config, 1, &count) == EGL_TRUE)
+                && (count > 0)) {
+                _context = eglCreateContext(_display, _config, EGL_NO_CONTEXT, contextAttribs);
+            }
+
+            if (_context == EGL_NO_CONTEXT) {
+                std::cerr << "No offscreen EGL context: " << EGL::ErrorString(eglGetError()) << std::endl;
+            }
+
+            return (_context != EGL_NO_CONTEXT);
+        }
+
+        void Deinitialize()
+        {
+            if (_display != EGL_NO_DISPLAY) {
+                if (_context != EGL_NO_CONTEXT) {
+                    eglMakeCurrent(_display, _surface, _surface, _context);
+                    _timer.Deinitialize();
+                }
+
+                eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+                if (_surface != EGL_NO_SURFACE) {
+                    eglDestroySurface(_display, _surface);
+                    _surface = EGL_NO_SURFACE;
+                }
+
+                if (_context != EGL_NO_CONTEXT) {
+                    eglDestroyContext(_display, _context);
+                    _context = EGL_NO_CONTEXT;
+                }
+
+                eglTerminate(_display);
+                _display = EGL_NO_DISPLAY;
+            }
+        }
+
+        bool Resize(const uint16_t width, const uint16_t height)
+        {
+            if ((_surface == EGL_NO_SURFACE) || (width != _width) || (height != _height)) {
+                const EGLint surfaceAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+
+                eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+                if (_surface != EGL_NO_SURFACE) {
+                    eglDestroySurface(_display, _surface);
+                }
+
+                _surface = eglCreatePbufferSurface(_display, _config, surfaceAttribs);
+
+                if ((_surface != EGL_NO_SURFACE) && (eglMakeCurrent(_display, _surface, _surface, _context) == EGL_TRUE)) {
+                    _width = width;
+                    _height = height;
+                    _timer.Initialize();
+                } else {
+                    std::cerr << "No " << width << "x" << height << " pbuffer: " << EGL::ErrorString(eglGetError()) << std::endl;
+                    _surface = EGL_NO_SURFACE;
+                }
+            }
+
+            return (_surface != EGL_NO_SURFACE);
+        }
+
+        string GLString(const GLenum name) const
+        {
+            const char* value(reinterpret_cast<const char*>(glGetString(name)));
+
+            return ((value != nullptr) ? string(value) : string());
+        }
+
+        bool Run(const string& vertex, const string& fragment, const uint32_t frames, Result& result)
+        {
+            Graphics::ModelConfig config;
+
+            config.VertexShaderFile = vertex;
+            config.FragmentShaderFile = fragment;
+            config.Width = _width;
+            config.Height = _height;
+
+            Core::ProxyType<Graphics::IModel> model(Graphics::IModel::Create(config));
+
+            model->Position(Graphics::DimensionType(0, 0));
+
+            Graphics::ProgramCache& cache(Graphics::ProgramCache::Instance());
+
+            const uint64_t compile(cache.CompileTime());
+            const uint64_t link(cache.LinkTime());
+            const uint64_t start(Monotonic());
+
+            const bool constructed(model->Construct());
+
+            glFinish();
+
+            result.Construct = static_cast<float>(Monotonic() - start) / 1000.0f;
+            result.Compile = static_cast<float>(cache.CompileTime() - compile) / 1000.0f;
+            result.Link = static_cast<float>(cache.LinkTime() - link) / 1000.0f;
+
+            if (constructed == true) {
+                std::vector<uint32_t> cpu;
+                std::vector<uint32_t> gpu;
+
+                cpu.reserve(frames);
+                gpu.reserve(frames);
+
+                for (uint32_t frame = 0; frame < (WarmupFrames + frames); frame++) {
+                    const uint64_t begin(Monotonic());
+
+                    _timer.Begin();
+
+                    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+                    glClear(GL_COLOR_BUFFER_BIT);
+
+                    model->Process(0, nullptr);
+
+                    _timer.End();
+
+                    eglSwapBuffers(_display, _surface);
+
+                    // Wait for the GPU, so the frame time is the complete cost.
+                    glFinish();
+
+                    const uint32_t duration(static_cast<uint32_t>(Monotonic() - begin));
+                    uint64_t elapsed(0);
+
+                    while (_timer.Result(elapsed) == true) {
+                        if (frame >= WarmupFrames) {
+                            gpu.push_back(static_cast<uint32_t>(elapsed / 1000));
+                        }
+                    }
+
+                    if (frame >= WarmupFrames) {
+                        cpu.push_back(duration);
+                    }
+                }
+
+                result.Frames = static_cast<uint32_t>(cpu.size());
+                result.Frame.Set(cpu);
+                result.Gpu.Set(gpu);
+            }
+
+            model->Destroy();
+            model.Release();
+
+            return (constructed);
+        }
+
+    private:
+        EGLDisplay _display;
+        EGLConfig _config;
+        EGLContext _context;
+        EGLSurface _surface;
+        uint16_t _width;
+        uint16_t _height;
+        Graphics::GpuTimer _timer;
+    };
+
+    static string Name(const string& path)
+    {
+        const size_t slash(path.find_last_of('/'));
+
+        return ((slash != string::npos) ? path.substr(slash + 1) : path);
+    }
+
+    static string Source(const string& path)
+    {
+        string result;
+        Core::File file(path);
+
+        if ((file.Exists() == true) && (file.Open(true) == true)) {
+            result.resize(static_cast<size_t>(file.Size()));
+            file.Read(reinterpret_cast<uint8_t*>(&result[0]), static_cast<uint32_t>(result.size()));
+            file.Close();
+        }
+
+        return (result);
+    }
+
+    // The ES 3.0 fragment shaders need the ES 3.0 vertex shader.
+    static string VertexFor(const string& directory, const string& fragment)
+    {
+        return (directory + ((Source(fragment).find("#version 300 es") != string::npos) ? _T("/Common-Version-300-ES.vert") : _T("/Common-Version-100-ES.vert")));
+    }
+
+    // Returns the number of regressions.
+    static uint32_t Compare(const Report& report, const Report& baseline, const float tolerance)
+    {
+        uint32_t regressions(0);
+        const float limit(1.0f + (tolerance / 100.0f));
+
+        Core::JSON::ArrayType<Result>::ConstIterator current(report.Results.Elements());
+
+        while (current.Next() == true) {
+            const Result& now(current.Current());
+
+            Core::JSON::ArrayType<Result>::ConstIterator previous(baseline.Results.Elements());
+
+            while (previous.Next() == true) {
+                const Result& then(previous.Current());
+
+                if ((then.Fragment.Value() == now.Fragment.Value()) && (then.Width.Value() == now.Width.Value()) && (then.Height.Value() == now.Height.Value())) {
+                    const bool p50(now.Frame.P50.Value() > (then.Frame.P50.Value() * limit));
+                    const bool p95(now.Frame.P95.Value() > (then.Frame.P95.Value() * limit));
+
+                    std::cerr << (((p50 == true) || (p95 == true)) ? "REGRESSION " : "ok         ")
+                              << now.Fragment.Value() << " " << now.Width.Value() << "x" << now.Height.Value()
+                              << " p50 " << then.Frame.P50.Value() << " -> " << now.Frame.P50.Value() << "ms"
+                              << " p95 " << then.Frame.P95.Value() << " -> " << now.Frame.P95.Value() << "ms" << std::endl;
+
+                    if ((p50 == true) || (p95 == true)) {
+                        ++regressions;
+                    }
+                    break;
+                }
+            }
+        }
+
+        return (regressions);
+    }
+
+} // namespace Benchmark
+} // namespace Thunder
+
+using namespace Thunder;
+
+int main(int argc, char* argv[])
+{
+    int result(0);
+
+    {
+        Benchmark::Options options;
+        Benchmark::Bench bench;
+        Benchmark::Report report;
+
+        if (options.Parse(argc, argv) == false) {
+            result = 1;
+        } else if ((bench.Initialize() == false) || (bench.Resize(options.Resolutions.front().Width, options.Resolutions.front().Height) == false)) {
+            result = 2;
+        } else {
+            std::vector<string> fragments;
+            Core::Directory directory(options.Shaders.c_str(), _T("*.frag"));
+
+            while (directory.Next() == true) {
+                fragments.push_back(directory.Current());
+            }
+
+            std::sort(fragments.begin(), fragments.end());
+
+            report.Renderer = bench.GLString(GL_RENDERER);
+            report.Version = bench.GLString(GL_VERSION);
+
+            // Results kept in memory only, a benchmark run starts from the sources.
+            Graphics::ShaderOptimizer::Instance().Configure(options.Optimize, string());
+
+            for (const Graphics::SizeType& resolution : options.Resolutions) {
+                if (bench.Resize(resolution.Width, resolution.Height) == true) {
+                    for (const string& fragment : fragments) {
+                        Benchmark::Result& entry(report.Results.Add());
+
+                        entry.Vertex = Benchmark::Name(Benchmark::VertexFor(options.Shaders, fragment));
+                        entry.Fragment = Benchmark::Name(fragment);
+                        entry.Width = resolution.Width;
+                        entry.Height = resolution.Height;
+
+                        std::cerr << entry.Fragment.Value() << " " << resolution.Width << "x" << resolution.Height << std::endl;
+
+                        if (bench.Run(Benchmark::VertexFor(options.Shaders, fragment), fragment, options.Frames, entry) == false) {
+                            std::cerr << "  failed to construct" << std::endl;
+                            result = 3;
+                        }
+                    }
+                }
+            }
+
+            string json;
+            report.ToString(json);
+
+            if (options.Output.empty() == true) {
+                std::cout << json << std::endl;
+            } else {
+                Core::File file(options.Output);
+
+                if (file.Create() == true) {
+                    file.Write(reinterpret_cast<const uint8_t*>(json.c_str()), static_cast<uint32_t>(json.size()));
+                    file.Close();
+                } else {
+                    std::cerr << "Could not write " << options.Output << std::endl;
+                    result = 4;
+                }
+            }
+
+            if (options.Baseline.empty() == false) {
+                Benchmark::Report baseline;
+                Core::File file(options.Baseline);
+
+                if ((file.Open(true) == false) || (baseline.FromFile(file) == false)) {
+                    std::cerr << "Could not read baseline " << options.Baseline << std::endl;
+                    result = 4;
+                } else if (Benchmark::Compare(report, baseline, options.Tolerance) > 0) {
+                    result = 5;
+                }
+            }
+        }
+    }
+
+    Core::Singleton::Dispose();
+
+    return (result);
+}
@@ -0,0 +1,94 @@
+# If not stated otherwise in this file or this component's LICENSE file the
+# following copyright and licenses apply:
+#
+# Copyright 2022 Metrological
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Writes the ShaderLibrary table for all *.vert, *.frag and *.glsl (included
+# snippets) files in DIRECTORY to OUTPUT. Every distinct content becomes one
+# string literal of hex escapes, so any byte survives, keyed by the first 64
+# bits of its SHA-256.
+#
+#   cmake -DDIRECTORY=<shaders> -DOUTPUT=<EmbeddedShaders.cpp> -P EmbedShaders.cmake
+
+if(NOT DIRECTORY OR NOT OUTPUT)
+    message(FATAL_ERROR "EmbedShaders needs DIRECTORY and OUTPUT")
+endif()
+
+file(GLOB sources "${DIRECTORY}/*.vert" "${DIRECTORY}/*.frag" "${DIRECTORY}/*.glsl")
+list(SORT sources)
+
+# CMake regular expressions have no {n}, spell out 16 bytes for the line breaks.
+set(line "")
+foreach(byte RANGE 15)
+    set(line "${line}\\\\x[0-9a-f][0-9a-f]")
+endforeach()
+
+set(blobs "")
+set(entries "")
+set(hashes "")
+set(count 0)
+
+foreach(source ${sources})
+    get_filename_component(name "${source}" NAME)
+
+    file(SHA256 "${source}" digest)
+    string(SUBSTRING "${digest}" 0 16 hash)
+
+    list(FIND hashes "${hash}" index)
+
+    if(index EQUAL -1)
+        list(APPEND hashes "${hash}")
+
+        file(READ "${source}" content HEX)
+        string(REGEX REPLACE "([0-9a-f][0-9a-f])" "\\\\x\\1" bytes "${content}")
+        string(REGEX REPLACE "(${line})" "\\1\"\n            \"" bytes "${bytes}")
+
+        set(blobs "${blobs}        constexpr char blob_${hash}[] =\n            \"${bytes}\";\n\n")
+    else()
+        message(STATUS "Shader ${name} has the same content as an earlier one, sharing it")
+    endif()
+
+    set(entries "${entries}        { \"${name}\", blob_${hash}, sizeof(blob_${hash}) - 1, 0x${hash}ULL },\n")
+    math(EXPR count "${count} + 1")
+endforeach()
+
+if(count EQUAL 0)
+    message(FATAL_ERROR "No shaders found in ${DIRECTORY}")
+endif()
+
+file(WRITE "${OUTPUT}.tmp"
+"// Generated by cmake/EmbedShaders.cmake from ${DIRECTORY}, do not edit.
+
+#include \"Module.h\"
+
+#include \"ShaderLibrary.h\"
+
+namespace Thunder {
+namespace Graphics {
+    namespace {
+${blobs}    }
+
+    /* static */ const ShaderLibrary::Entry ShaderLibrary::_entries[] = {
+${entries}    };
+
+    /* static */ const uint16_t ShaderLibrary::_count = ${count};
+
+} // namespace Graphics
+} // namespace Thunder
+")
+
+# Leave the output untouched when nothing changed, so it is not rebuilt.
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different "${OUTPUT}.tmp" "${OUTPUT}")
+file(REMOVE "${OUTPUT}.tmp")
@@ -6,6 +6,7 @@ precision mediump float;
 uniform vec3      u_resolution;           // viewport resolution (in pixels                     
 uniform float     u_opacity;                                                                    
 uniform float     u_time;    
+uniform vec2      u_offset;               // viewport origin in the window (in pixels)
 
 // output
 out vec4 outColor; 
@@ -217,5 +218,5 @@ void mainImage( out vec4 fragColor, in vec2 fragCoord )
 
 void main()                                                                                     
 {                                                                                               
-    mainImage(outColor, gl_FragCoord.xy);                                                   
+    mainImage(outColor, gl_FragCoord.xy - u_offset);                                                   
 }   
@@ -1,8 +1,4 @@
-precision mediump float;                                                                        
-                                                                                                
-uniform vec3      u_resolution;           // viewport resolution (in pixels                     
-uniform float     u_opacity;                                                                    
-uniform float     u_time;                                                                       
+#include "ShaderToy.glsl"
                                                                                                 
 vec2 rotate(vec2 uv, float th) {                                                                
   return mat2(cos(th), sin(th), -sin(th), cos(th)) * uv;                                        
@@ -30,8 +26,3 @@ void mainImage( out vec4 fragColor, in vec2 fragCoord )
   // Output to screen                                                                           
   fragColor = vec4(col,1.0);                                                                    
 }                                                                                               
-                                                                                                
-void main()                                                                                     
-{                                                                                               
-    mainImage(gl_FragColor, gl_FragCoord.xy);                                                   
-}   
\ No newline at end of file
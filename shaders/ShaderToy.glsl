@@ -0,0 +1,24 @@
+// Shared by the ShaderToy ports: the uniforms set by the plugin and a main()
+// that calls mainImage() with ShaderToy's pixel coordinates. A port includes
+// it and only has to define mainImage().
+//
+// QUALITY is the tier of the device, from 0 (entry level) to 3 (high end).
+// The plugin defines it per model, use it for loop and layer counts.
+
+#ifndef QUALITY
+#define QUALITY 2
+#endif
+
+precision mediump float;
+
+uniform vec3      u_resolution;           // viewport resolution (in pixels)
+uniform float     u_opacity;
+uniform float     u_time;                 // running time (in seconds)
+uniform vec2      u_offset;               // viewport origin in the window (in pixels)
+
+void mainImage(out vec4 fragColor, in vec2 fragCoord);
+
+void main()
+{
+    mainImage(gl_FragColor, gl_FragCoord.xy - u_offset);
+}
@@ -1,8 +1,4 @@
-precision mediump float; 
-
-uniform vec3      u_resolution;           // viewport resolution (in pixels
-uniform float     u_opacity; 
-uniform float     u_time;  
+#include "ShaderToy.glsl"
 
 // Start of ShaderToy image shader
 // Source: https://www.shadertoy.com/view/sdBcWc
@@ -55,8 +51,3 @@ void mainImage( out vec4 fragColor, in vec2 fragCoord )
     fragColor = vec4(color*adjusted,1.0);
 }
 // End of ShaderToy image shader 
-
-void main()                                                                          
-{                                                                                    
-    mainImage(gl_FragColor, gl_FragCoord.xy);                                        
-}                                                                                    
@@ -0,0 +1,46 @@
+#include "ShaderToy.glsl"
+
+uniform sampler2D u_noise0;               // 256x256 white noise
+uniform sampler2D u_hue;                  // hue ramp, wraps
+
+// Start of ShaderToy image shader//Source: https://www.shadertoy.com/view/WsyfRh
+// Tentacles-of-Light.frag with the hash and hue2rgb() replaced by texture fetches.
+
+#if QUALITY >= 2
+#define TENTACLES 8.0
+#elif QUALITY == 1
+#define TENTACLES 6.0
+#else
+#define TENTACLES 4.0
+#endif
+
+float line(in vec2 p, in vec2 a, in vec2 b) {
+    vec2 pa = p - a, ba = b - a;
+    return length(pa - ba * clamp(dot(pa, ba) / dot(ba, ba), 0.0, 1.0));
+}
+
+void mainImage(out vec4 fragColor, in vec2 fragCoord) {
+    vec2 uv = (fragCoord - 0.5 * u_resolution.xy) / u_resolution.y;
+    vec3 color = vec3(0.0);
+
+    float t = u_time * 0.25;
+    float c = cos(t), s = sin(t);
+    uv -= vec2(cos(t), sin(t)) * 0.15;
+
+    for (float tentacleID=0.0; tentacleID < TENTACLES; tentacleID++) {
+        float distFromOrigin = length(uv);
+        float tentacleHash = texture2D(u_noise0, vec2((tentacleID + 1.5) / 256.0, 0.5 / 256.0)).r;
+        float angle = tentacleID / 4.0 * 3.14 + u_time * (tentacleHash - 0.5);
+
+        vec3 tentacleColor = texture2D(u_hue, vec2(0.5 * (distFromOrigin - 0.1 * u_time), 0.5)).rgb;
+        float fadeOut = 1.0 - pow(distFromOrigin, sin(tentacleHash * u_time) + 1.5);
+
+        vec2 offsetVector = uv.yx * vec2(-1.0, 1.0);
+        vec2 offset = offsetVector * sin(tentacleHash * (distFromOrigin + tentacleHash * u_time)) * (1.0 - distFromOrigin);
+
+        color += smoothstep(0.03, 0.0, line(uv + offset, vec2(0.0, 0.0), vec2(cos(angle), sin(angle)) * 1000.0)) * fadeOut * tentacleColor;
+    }
+
+    fragColor = vec4(color, 1.0);
+}
+// End of ShaderToy image shader 
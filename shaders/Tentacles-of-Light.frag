@@ -1,11 +1,15 @@
-precision mediump float; 
-
-uniform vec3      u_resolution;           // viewport resolution (in pixels
-uniform float     u_opacity; 
-uniform float     u_time;  
+#include "ShaderToy.glsl"
 
 // Start of ShaderToy image shader//Source: https://www.shadertoy.com/view/WsyfRh
 
+#if QUALITY >= 2
+#define TENTACLES 8.0
+#elif QUALITY == 1
+#define TENTACLES 6.0
+#else
+#define TENTACLES 4.0
+#endif
+
 float Hash11(in float x) {
     return fract(sin(x * 1254.5763) * 57465.57);
 }
@@ -51,7 +55,7 @@ void mainImage(out vec4 fragColor, in vec2 fragCoord) {
     float c = cos(t), s = sin(t);
     uv -= vec2(cos(t), sin(t)) * 0.15;
 
-    for (float tentacleID=0.0; tentacleID < 8.0; tentacleID++) {
+    for (float tentacleID=0.0; tentacleID < TENTACLES; tentacleID++) {
         float distFromOrigin = length(uv);
         float tentacleHash = Hash11(tentacleID + 1.0);
         float angle = tentacleID / 4.0 * 3.14 + u_time * (tentacleHash - 0.5);
@@ -68,8 +72,3 @@ void mainImage(out vec4 fragColor, in vec2 fragCoord) {
     fragColor = vec4(color, 1.0);
 }
 // End of ShaderToy image shader 
-
-void main()                                                                          
-{                                                                                    
-    mainImage(gl_FragColor, gl_FragCoord.xy);                                        
-}                                                                                    
@@ -1,8 +1,4 @@
-precision mediump float; 
-
-uniform vec3      u_resolution;           // viewport resolution (in pixels
-uniform float     u_opacity; 
-uniform float     u_time;  
+#include "ShaderToy.glsl"
 
 // Start of ShaderToy image shader
 // Source: https://www.shadertoy.com/view/Wdcyz7
@@ -10,7 +6,13 @@ uniform float     u_time;
 //full credits to BigWings:
 //https://www.youtube.com/watch?v=rvDo9LvfoVE
 
-#define NUM_LAYERS 2. //3.
+#if QUALITY >= 3
+#define NUM_LAYERS 3.
+#elif QUALITY >= 1
+#define NUM_LAYERS 2.
+#else
+#define NUM_LAYERS 1.
+#endif
 
 
 float Hash21(vec2 p){
@@ -81,8 +83,3 @@ void mainImage( out vec4 fragColor, in vec2 fragCoord )
     fragColor = vec4(col,1.0);
 }
 // End of ShaderToy image shader 
-
-void main()                                                                          
-{                                                                                    
-    mainImage(gl_FragColor, gl_FragCoord.xy);                                        
-}                                                                                    